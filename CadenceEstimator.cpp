@@ -0,0 +1,157 @@
+#include "CadenceEstimator.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// An estimate this far from the current interval is a different frame rate, if it persists.
+	/// </summary>
+	static const double kChangeFraction = 0.15;
+	/// <summary>
+	/// Fraction of a frame's timestamp error taken into its presentation time.  Small, to filter out noise, but large enough to follow clock drift.
+	/// </summary>
+	static const double kPresentationGain = 1.0 / 8;
+	/// <summary>
+	/// A timestamp this much older than the one before is not a reordered frame but a new stream: a camera that restarted, or a clock that wrapped.
+	/// </summary>
+	static const int64_t kDiscontinuityMs = 2000;
+
+	CadenceEstimator::CadenceEstimator() : changes_(0)
+	{
+		Reset();
+	}
+
+	void CadenceEstimator::Reset()
+	{
+		timestamps_.Clear();
+		arrivals_.Clear();
+		haveLast_ = false;
+		lastArrival_ = 0;
+		lastTimestamp_ = 0;
+		presentation_ = 0;
+		repeatedTimestamps_ = 0;
+		interval_ = 0;
+		pendingChange_ = 0;
+	}
+
+	int64_t CadenceEstimator::AddFrame(int64_t arrivalMs, int64_t timestamp)
+	{
+		if (haveLast_ && timestamp < lastTimestamp_ - kDiscontinuityMs)
+			Reset(); // A new stream that came without a reset.  Start over from this frame.
+		if (!haveLast_)
+		{
+			haveLast_ = true;
+			lastArrival_ = arrivalMs;
+			lastTimestamp_ = timestamp;
+			presentation_ = (double)timestamp;
+			timestamps_.Add((double)timestamp);
+			arrivals_.Add((double)arrivalMs);
+			return timestamp;
+		}
+
+		if (arrivalMs > lastArrival_)
+		{
+			arrivals_.Add((double)arrivalMs);
+			lastArrival_ = arrivalMs;
+		}
+
+		int64_t delta = timestamp - lastTimestamp_;
+		if (delta < 0)
+		{
+			// Reordered.  Leave the cadence alone, but shift the frame by the smoothing applied to its
+			// neighbours, so it is not presented out of step with them; the scheduler sorts out the order.
+			return timestamp + (int64_t)floor(presentation_ - lastTimestamp_ + 0.5);
+		}
+		if (delta == 0)
+			repeatedTimestamps_++;
+		else
+		{
+			repeatedTimestamps_ = 0;
+			timestamps_.Add((double)timestamp);
+		}
+		lastTimestamp_ = timestamp;
+		UpdateInterval();
+
+		if (interval_ <= 0)
+			presentation_ = (double)timestamp;
+		else if (delta == 0)
+			presentation_ += interval_; // No timestamp to go by.
+		else
+		{
+			double predicted = presentation_ + interval_;
+			double error = timestamp - predicted;
+			if (fabs(error) < interval_ / 2)
+				presentation_ = predicted + error * kPresentationGain;
+			else
+				presentation_ = (double)timestamp; // A gap or a jump: follow the timestamps.
+		}
+		return (int64_t)floor(presentation_ + 0.5);
+	}
+
+	void CadenceEstimator::UpdateInterval()
+	{
+		double estimate = timestampsMissing() ? arrivals_.Interval() : timestamps_.Interval();
+		if (estimate <= 0)
+			return;
+		if (interval_ <= 0 || fabs(estimate - interval_) <= interval_ * kChangeFraction)
+		{
+			interval_ = estimate;
+			pendingChange_ = 0;
+			return;
+		}
+		if (++pendingChange_ < kWindow / 2)
+			return; // Not yet: a burst of odd frames does not change the frame rate.
+		interval_ = estimate;
+		pendingChange_ = 0;
+		changes_++;
+	}
+
+	void CadenceEstimator::TimeWindow::Add(double time)
+	{
+		times[next] = time;
+		next = (next + 1) % kWindow;
+		if (count < kWindow)
+			count++;
+	}
+
+	double CadenceEstimator::TimeWindow::Interval() const
+	{
+		if (count < kMinTimes)
+			return 0;
+		int first = (next - count + kWindow) % kWindow;
+		double intervals[kWindow];
+		int n = 0;
+		for (int i = 1; i < count; i++)
+		{
+			double interval = times[(first + i) % kWindow] - times[(first + i - 1) % kWindow];
+			if (interval > 0)
+				intervals[n++] = interval;
+		}
+		if (n == 0)
+			return 0;
+		std::nth_element(intervals, intervals + n / 2, intervals + n);
+		double median = intervals[n / 2];
+
+		// Number each time by how many median intervals it is from the first, and fit time = start + number * interval.
+		double origin = times[first];
+		double sumK = 0;
+		double sumT = 0;
+		double sumKK = 0;
+		double sumKT = 0;
+		for (int i = 0; i < count; i++)
+		{
+			double t = times[(first + i) % kWindow] - origin;
+			double k = floor(t / median + 0.5);
+			sumK += k;
+			sumT += t;
+			sumKK += k * k;
+			sumKT += k * t;
+		}
+		double variance = count * sumKK - sumK * sumK;
+		if (variance <= 0)
+			return median;
+		return (count * sumKT - sumK * sumT) / variance;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include <stdint.h>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Estimates a stream's frame interval from its recent timestamps, and gives every frame a presentation time on that cadence.
+	/// The median interval numbers the frames in the window (so a dropped frame leaves a gap in the numbering rather than doubling
+	/// an interval), and a least-squares line through the numbered timestamps gives the interval, which averages out timestamp noise.
+	/// Duplicated and reordered timestamps are left out.  A frame rate change is accepted once the estimate has stayed away from the
+	/// current interval for half a window.  When timestamps stop advancing (a page that sends none), arrival times are used instead.
+	/// </summary>
+	class CadenceEstimator
+	{
+	public:
+		CadenceEstimator();
+		~CadenceEstimator() {}
+
+		/// <summary>
+		/// Forgets the stream's history, for a new stream.  The count of frame rate changes is kept.
+		/// </summary>
+		void Reset();
+
+		/// <summary>
+		/// Records a frame that reached the scheduler at the given time with the given timestamp, both in milliseconds, and returns
+		/// the time on the timestamp clock at which it should be presented.  Timestamp noise of less than half an interval is smoothed
+		/// out; a frame with the same timestamp as the one before is placed one interval after it; a larger jump forward (a gap,
+		/// a new stream) is followed as it is; a frame slightly older than the one before (reordered) is shifted by the same
+		/// smoothing offset as the frames around it, without affecting the cadence; and a jump back of more than a couple of
+		/// seconds (a camera restart or a timestamp wrap) resets the estimator, starting over from that frame.
+		/// </summary>
+		int64_t AddFrame(int64_t arrivalMs, int64_t timestamp);
+
+		/// <summary>The frame interval in milliseconds, or 0 until there is enough history to tell.</summary>
+		double intervalMs() const { return interval_; }
+		/// <summary>Number of frame rate changes since the estimator was created.</summary>
+		int64_t changes() const { return changes_; }
+		/// <summary>True while recent frames have not had advancing timestamps, so the interval comes from arrival times.</summary>
+		bool timestampsMissing() const { return repeatedTimestamps_ >= kMissingAfter; }
+
+	private:
+		/// <summary>Number of recent times kept.</summary>
+		static const int kWindow = 32;
+		/// <summary>Times needed before there is an estimate.</summary>
+		static const int kMinTimes = 4;
+		/// <summary>Consecutive repeated timestamps after which timestamps are considered missing.</summary>
+		static const int kMissingAfter = 3;
+
+		/// <summary>
+		/// A ring of the last kWindow times, in increasing order.
+		/// </summary>
+		struct TimeWindow
+		{
+			double times[kWindow];
+			int count;
+			int next;
+			void Clear() { count = 0; next = 0; }
+			void Add(double time);
+			/// <summary>The interval between the times, fitted as described above, or 0 if there are fewer than kMinTimes.</summary>
+			double Interval() const;
+		};
+
+		void UpdateInterval();
+
+		TimeWindow timestamps_;
+		TimeWindow arrivals_;
+		bool haveLast_;
+		int64_t lastArrival_;
+		int64_t lastTimestamp_;
+		// Presentation time of the newest frame, kept fractional so a non-integer interval does not accumulate rounding error.
+		double presentation_;
+		int32_t repeatedTimestamps_;
+		double interval_;
+		// Consecutive estimates too far from interval_ to be the same frame rate.
+		int32_t pendingChange_;
+		int64_t changes_;
+	};
+}
\ No newline at end of file
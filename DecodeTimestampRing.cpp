@@ -0,0 +1,56 @@
+#include "DecodeTimestampRing.h"
+
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	DecodeTimestampRing::DecodeTimestampRing(size_t capacity) : slots_(capacity), mask_(capacity - 1)
+	{
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+		Clear();
+	}
+
+	DecodeTimestampRing::~DecodeTimestampRing()
+	{
+	}
+
+	void DecodeTimestampRing::Add(uint32_t decodeId, int64_t timestamp, const FrameStageTimes& stages)
+	{
+		Slot& slot = slots_[decodeId & mask_];
+		if (slot.used)
+			stats_.overwritten++;
+		slot.decodeId = decodeId;
+		slot.used = true;
+		slot.timestamp = timestamp;
+		slot.stages = stages;
+	}
+
+	bool DecodeTimestampRing::Take(uint32_t decodeId, int64_t& timestamp, FrameStageTimes& stages)
+	{
+		Slot& slot = slots_[decodeId & mask_];
+		if (!slot.used)
+		{
+			stats_.missing++;
+			return false;
+		}
+		if (slot.decodeId != decodeId)
+		{
+			// A later frame took the slot.  If the later frame is the one that comes back first, its lookup still works.
+			if ((int32_t)(slot.decodeId - decodeId) > 0)
+				stats_.stale++;
+			else
+				stats_.missing++;
+			return false;
+		}
+		slot.used = false;
+		timestamp = slot.timestamp;
+		stages = slot.stages;
+		return true;
+	}
+
+	void DecodeTimestampRing::Clear()
+	{
+		for (size_t i = 0; i < slots_.size(); i++)
+			slots_[i].used = false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include "Platform.h"
+#include "FrameLatencyStats.h"
+#include <vector>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Counters for DecodeTimestampRing lookups that did not find their frame.  All of them should stay 0 with a well-behaved decoder.
+	/// </summary>
+	struct DecodeTimestampStats
+	{
+		DecodeTimestampStats() : stale(0), missing(0), overwritten(0) {}
+		/// <summary>Lookups whose slot had been reused by a later decode id, so the frame's timestamp was lost.</summary>
+		int64_t stale;
+		/// <summary>Lookups for a decode id that was never added, or was already taken.</summary>
+		int64_t missing;
+		/// <summary>Adds that replaced a frame still waiting for its picture.  Means more frames were in the decoder than the ring holds.</summary>
+		int64_t overwritten;
+	};
+
+	/// <summary>
+	/// Maps the decode ids of frames inside the video decoder to their timestamps (and stage times, for the latency stats).  A fixed ring of slots indexed by decode id
+	/// modulo the capacity, so neither adding nor taking allocates and the memory used does not grow however long the stream runs.
+	/// Decode ids are assigned sequentially, so the ring only has to hold as many entries as there are frames in the decoder at once.
+	/// </summary>
+	class DecodeTimestampRing
+	{
+	public:
+		/// <summary>
+		/// The capacity must be a power of two.
+		/// </summary>
+		DecodeTimestampRing(size_t capacity);
+		~DecodeTimestampRing();
+
+		/// <summary>
+		/// Records the timestamp and stage times of a frame being passed to the decoder.
+		/// </summary>
+		void Add(uint32_t decodeId, int64_t timestamp, const FrameStageTimes& stages);
+		/// <summary>
+		/// Looks up and forgets the timestamp and stage times of a decoded picture.  Returns false, and counts the failure, if it is not in the ring.
+		/// </summary>
+		bool Take(uint32_t decodeId, int64_t& timestamp, FrameStageTimes& stages);
+		/// <summary>
+		/// Forgets every entry, for a decoder reset.  The counters are kept.
+		/// </summary>
+		void Clear();
+
+		size_t capacity() const { return slots_.size(); }
+		const DecodeTimestampStats& stats() const { return stats_; }
+
+	private:
+		struct Slot
+		{
+			uint32_t decodeId;
+			bool used;
+			int64_t timestamp;
+			FrameStageTimes stages;
+		};
+
+		std::vector<Slot> slots_;
+		size_t mask_;
+		DecodeTimestampStats stats_;
+	};
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "DecodedFrame.h"
+#include "DecodedFramePool.h"
 #include "Decoder.h"
 
 namespace PnaclPlayer
@@ -8,7 +9,20 @@ namespace PnaclPlayer
 		if (recycled || rendering)
 			return;
 		recycled = true;
-		const PP_VideoPicture& pRef = picture;
-		decoder->RecyclePicture(pRef);
+		if (!decoder)
+			return;
+		const VideoPicture& pRef = picture;
+		decoder->RecyclePicture(pRef, backendGeneration);
+	}
+
+	void DecodedFrameDeleter::operator()(DecodedFrame* frame) const
+	{
+		if (frame->pool)
+			frame->pool->Release(frame);
+		else
+		{
+			frame->RecyclePicture();
+			delete frame;
+		}
 	}
 }
\ No newline at end of file
@@ -1,18 +1,37 @@
 #pragma once
-#include "ppapi/cpp/video_decoder.h"
+#include "Platform.h"
+#include "FrameLatencyStats.h"
+#include <memory>
 namespace PnaclPlayer
 {
 	class Decoder;
+	class DecodedFramePool;
 	struct DecodedFrame
 	{
-		DecodedFrame() : decoder(NULL), streamNum(0), timestamp(0) {}
-		DecodedFrame(Decoder* decoder, const PP_VideoPicture& picture, int32_t streamNum, int64_t timestamp) : decoder(decoder), picture(picture), streamNum(streamNum), timestamp(timestamp), expectedInterframe(0), recycled(false), rendering(false) {}
+		DecodedFrame() : decoder(NULL), pool(NULL), picture(), streamNum(0), backendGeneration(0), timestamp(0), presentationTime(0), expectedInterframe(0), recycled(false), rendering(false) {}
+		DecodedFrame(Decoder* decoder, const VideoPicture& picture, int32_t streamNum, int64_t timestamp) : decoder(decoder), pool(NULL), picture(picture), streamNum(streamNum), backendGeneration(0), timestamp(timestamp), presentationTime(timestamp), expectedInterframe(0), recycled(false), rendering(false) {}
 		~DecodedFrame() {}
 		Decoder* decoder;
-		PP_VideoPicture picture;
+		/// <summary>
+		/// The pool this frame is returned to when its handle is destroyed, or NULL if it was allocated with new.
+		/// </summary>
+		DecodedFramePool* pool;
+		VideoPicture picture;
 		int32_t streamNum;
+		/// <summary>
+		/// Which of the decoder's video decoder backends lent the picture.  Pictures of a backend that was replaced after an error are not recycled.
+		/// </summary>
+		int32_t backendGeneration;
 		int64_t timestamp;
+		/// <summary>
+		/// When the frame should be shown, on the timestamp clock.  The timestamp evened out onto the stream's cadence by the RenderScheduler.
+		/// </summary>
+		int64_t presentationTime;
 		int32_t expectedInterframe;
+		/// <summary>
+		/// When the frame reached each stage, carried over from its EncodedFrame.
+		/// </summary>
+		FrameStageTimes stages;
 
 		bool recycled;
 		void RecyclePicture();
@@ -21,4 +40,17 @@ namespace PnaclPlayer
 
 		bool operator<(DecodedFrame const &other) { return timestamp < other.timestamp; }
 	};
+
+	/// <summary>
+	/// Recycles the frame's picture and returns the frame to its pool, or deletes it if it has no pool.
+	/// </summary>
+	struct DecodedFrameDeleter
+	{
+		void operator()(DecodedFrame* frame) const;
+	};
+
+	/// <summary>
+	/// Owning handle to a DecodedFrame.  Whoever holds the handle owns the frame; letting the handle go out of scope hands the picture back to the decoder.
+	/// </summary>
+	typedef std::unique_ptr<DecodedFrame, DecodedFrameDeleter> DecodedFramePtr;
 }
\ No newline at end of file
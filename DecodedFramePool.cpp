@@ -0,0 +1,58 @@
+#include "DecodedFramePool.h"
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	DecodedFramePool::DecodedFramePool(Decoder* decoder, size_t initialCapacity) : decoder_(decoder)
+	{
+		Grow(initialCapacity);
+	}
+
+	DecodedFramePool::~DecodedFramePool()
+	{
+		for (size_t i = 0; i < slabs_.size(); i++)
+			delete[] slabs_[i];
+	}
+
+	DecodedFramePtr DecodedFramePool::Acquire(const VideoPicture& picture, int32_t streamNum, int64_t timestamp)
+	{
+		if (free_.empty())
+			Grow(kSlabSize);
+		DecodedFrame* frame = free_.back();
+		free_.pop_back();
+		*frame = DecodedFrame(decoder_, picture, streamNum, timestamp);
+		frame->pool = this;
+		stats_.acquired++;
+		stats_.inUse++;
+		if (stats_.inUse > stats_.peakInUse)
+			stats_.peakInUse = stats_.inUse;
+		return DecodedFramePtr(frame);
+	}
+
+	void DecodedFramePool::Release(DecodedFrame* frame)
+	{
+		assert(frame->pool == this);
+		frame->RecyclePicture();
+		free_.push_back(frame); // Never reallocates: Grow reserves room for every frame the pool owns.
+		stats_.inUse--;
+	}
+
+	void DecodedFramePool::Grow(size_t count)
+	{
+		if (count == 0)
+			return;
+		DecodedFrame* slab = new DecodedFrame[count];
+		stats_.heapAllocations++;
+		if (slabs_.size() == slabs_.capacity())
+			stats_.heapAllocations++;
+		slabs_.push_back(slab);
+		stats_.capacity += count;
+		if (free_.capacity() < (size_t)stats_.capacity)
+		{
+			free_.reserve((size_t)stats_.capacity);
+			stats_.heapAllocations++;
+		}
+		for (size_t i = 0; i < count; i++)
+			free_.push_back(&slab[i]);
+	}
+}
\ No newline at end of file
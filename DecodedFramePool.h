@@ -0,0 +1,54 @@
+#pragma once
+#include "DecodedFrame.h"
+#include <vector>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Counters describing a DecodedFramePool.  Once the pool has grown to the number of pictures the decoder keeps in flight, heapAllocations stops increasing.
+	/// </summary>
+	struct DecodedFramePoolStats
+	{
+		DecodedFramePoolStats() : capacity(0), inUse(0), peakInUse(0), acquired(0), heapAllocations(0) {}
+		int64_t capacity;
+		int64_t inUse;
+		int64_t peakInUse;
+		int64_t acquired;
+		/// <summary>Number of heap allocations the pool has made (slabs and free list growth).</summary>
+		int64_t heapAllocations;
+	};
+
+	/// <summary>
+	/// Per-decoder slab of DecodedFrame objects.  A frame can only exist while the decoder has lent out its picture, so the pool
+	/// never needs more frames than the decoder has picture buffers; it grows a slab at a time until it reaches that number and
+	/// then stops allocating.  The pool must outlive every handle it has given out.
+	/// </summary>
+	class DecodedFramePool
+	{
+	public:
+		DecodedFramePool(Decoder* decoder, size_t initialCapacity);
+		~DecodedFramePool();
+
+		/// <summary>
+		/// Returns a handle to a frame wrapping the picture.  Destroying the handle recycles the picture and returns the frame to this pool.
+		/// </summary>
+		DecodedFramePtr Acquire(const VideoPicture& picture, int32_t streamNum, int64_t timestamp);
+		/// <summary>
+		/// Called by DecodedFrameDeleter.
+		/// </summary>
+		void Release(DecodedFrame* frame);
+
+		const DecodedFramePoolStats& stats() const { return stats_; }
+
+	private:
+		/// <summary>
+		/// Number of frames added each time the pool runs dry.
+		/// </summary>
+		static const size_t kSlabSize = 4;
+		void Grow(size_t count);
+
+		Decoder* decoder_;
+		std::vector<DecodedFrame*> slabs_;
+		std::vector<DecodedFrame*> free_;
+		DecodedFramePoolStats stats_;
+	};
+}
\ No newline at end of file
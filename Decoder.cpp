@@ -1,30 +1,29 @@
 #include "Decoder.h"
 #include "pnacl_player.h"
 
+using namespace std::placeholders;
+
 namespace PnaclPlayer
 {
-	Decoder::Decoder(pnacl_player* instance, int id, const pp::Graphics3D& graphics_3d, int hwaccel) : currentStreamNum(0), instance_(instance), id_(id), ppDecoder(new pp::VideoDecoder(instance)), callback_factory_(this), next_picture_id_(0), flushing_(false), resetting_(false), initializing_(true), decode_looping_(false)
+	Decoder::Decoder(pnacl_player* instance, int id, GraphicsContext* context, int hwaccel) : framePool(this, kInitialFramePoolSize), currentStreamNum(0), instance_(instance), id_(id), context_(context), hwaccel_(HWACCEL_NONE), ppDecoder(instance->platform()->CreateVideoDecoder(context)), backendGeneration_(0), decodingId_(0), next_picture_id_(0), flushing_(false), resetting_(false), initializing_(true), decode_looping_(false), queuedBytes_(0), maxBacklogMs_(0), maxBacklogBytes_(0), decodeTimestamps_(kDecodeTimestampRingSize), haveSps_(false), skipToKeyframe_(false), getPicturePending_(false), idleFlushMs_(0), lastReceivedMs_(0), idleCheckPending_(false), unflushed_(false), flushPending_(false), endOfStream_(false), recovering_(false), errorMs_(0), reinitializePending_(false), alive_(new bool(true))
 	{
-		const PP_VideoProfile kBitstreamProfile = PP_VIDEOPROFILE_H264HIGH;
-
-		assert(!ppDecoder->is_null());
-		PP_HardwareAcceleration hwva = PP_HARDWAREACCELERATION_NONE;
+		assert(ppDecoder);
 		if (hwaccel == 0)
 		{
-			hwva = PP_HARDWAREACCELERATION_NONE;
+			hwaccel_ = HWACCEL_NONE;
 			instance->PostString("PP_HARDWAREACCELERATION_NONE");
 		}
 		else if (hwaccel == 1)
 		{
-			hwva = PP_HARDWAREACCELERATION_WITHFALLBACK;
+			hwaccel_ = HWACCEL_WITHFALLBACK;
 			instance->PostString("PP_HARDWAREACCELERATION_WITHFALLBACK");
 		}
 		else if (hwaccel == 2)
 		{
-			hwva = PP_HARDWAREACCELERATION_ONLY;
+			hwaccel_ = HWACCEL_ONLY;
 			instance->PostString("PP_HARDWAREACCELERATION_ONLY");
 		}
-		ppDecoder->Initialize(graphics_3d, kBitstreamProfile, hwva, 0, callback_factory_.NewCallback(&Decoder::InitializeDone));
+		ppDecoder->Initialize(hwaccel_, std::bind(&Decoder::InitializeDone, this, _1));
 	}
 
 	Decoder::~Decoder()
@@ -34,7 +33,12 @@ namespace PnaclPlayer
 	void Decoder::InitializeDone(int32_t result)
 	{
 		assert(ppDecoder);
-		assert(result == PP_OK);
+		if (result != PLATFORM_OK)
+		{
+			errorStats_.initializeErrors++;
+			HandleError("initialize", result, true);
+			return;
+		}
 		Start();
 	}
 
@@ -42,11 +46,13 @@ namespace PnaclPlayer
 	{
 		assert(ppDecoder);
 
-		next_picture_id_ = 0;
+		// Frames queued while initializing already have their ids.
+		if (encodedFrameQueue.empty())
+			next_picture_id_ = 0;
 
 		// Register callback to get the first picture. We call GetPicture again in
 		// PictureReady to continuously receive pictures as they're decoded.
-		ppDecoder->GetPicture(callback_factory_.NewCallbackWithOutput(&Decoder::PictureReady));
+		GetPicture();
 
 		// Start the decode loop.
 		if (initializing_)
@@ -58,64 +64,205 @@ namespace PnaclPlayer
 	void Decoder::Reset()
 	{
 		assert(ppDecoder);
-		if (resetting_ || initializing_)
-			return;
-		resetting_ = true;
+		skipToKeyframe_ = false;
+		flushPending_ = false;
+		endOfStream_ = false;
+		unflushed_ = false;
 		currentStreamNum++;
-		while (!encodedFrameQueue.empty())
-			encodedFrameQueue.pop();
+		encodedFrameQueue.clear();
+		queuedBytes_ = 0;
+		QueueChanged();
 		next_picture_id_ = 0;
-		timestampMap.clear();
-		ppDecoder->Reset(callback_factory_.NewCallback(&Decoder::ResetDone));
+		decodeTimestamps_.Clear();
+		if (resetting_ || initializing_)
+			return; // The backend has nothing of the old stream to reset yet, or is resetting already; decoding starts afresh when it is ready.
+		resetting_ = true;
+		ppDecoder->Reset(std::bind(&Decoder::ResetDone, this, _1));
 	}
 
 	void Decoder::ResetDone(int32_t result)
 	{
 		assert(ppDecoder);
-		assert(result == PP_OK);
 		assert(resetting_);
 		resetting_ = false;
+		if (result != PLATFORM_OK)
+		{
+			errorStats_.resetErrors++;
+			HandleError("reset", result, true);
+			return;
+		}
 
 		Start();
 	}
 
-	void Decoder::RecyclePicture(const PP_VideoPicture& picture)
+	void Decoder::RecyclePicture(const VideoPicture& picture, int32_t backendGeneration)
 	{
 		assert(ppDecoder);
+		if (backendGeneration != backendGeneration_)
+			return; // The backend that lent it has been deleted, and its textures with it.
 		ppDecoder->RecyclePicture(picture);
 	}
 
 	void Decoder::ReceiveFrame(EncodedFrame frame)
 	{
+		if (idleFlushMs_ > 0)
+		{
+			lastReceivedMs_ = FrameLatencyStats::Now(instance_->platform()) / 1000;
+			ScheduleIdleCheck(idleFlushMs_);
+		}
+		if (!ClassifyFrame(frame))
+			skipToKeyframe_ = false; // No telling where the keyframes are, so decode everything.
+		if (skipToKeyframe_)
+		{
+			if (frame.keyframe())
+				skipToKeyframe_ = false;
+			else if (!frame.parameterSets()) // The keyframe will need them.
+			{
+				if (recovering_)
+					errorStats_.skippedFrames++;
+				return;
+			}
+		}
+		size_t runStart = initializing_ && frame.keyframe() ? KeyframeRunStart(encodedFrameQueue.size()) : 0;
+		if (runStart > 0)
+		{
+			// Nothing has been decoded yet, so start from this keyframe (and its parameter sets) rather than an older one.
+			if (recovering_)
+				errorStats_.skippedFrames += runStart;
+			else
+				backlogStats_.startupSkippedFrames += runStart;
+			for (size_t i = 0; i < runStart; i++)
+				PopEncodedFrame();
+		}
 		frame.id = next_picture_id_++;
-		encodedFrameQueue.push(frame);
-		timestampMap[frame.id] = frame.timestamp;
+		frame.stages.queued = FrameLatencyStats::Now(instance_->platform());
+		encodedFrameQueue.push_back(frame);
+		queuedBytes_ += frame.size;
+		ShedBacklog();
+		QueueChanged();
 		if (!resetting_ && !flushing_ && !initializing_ && !decode_looping_)
 			DecodeNextFrame();
 	}
 
+	bool Decoder::ClassifyFrame(EncodedFrame& frame)
+	{
+		if (frame.classified() && !frame.parameterSets())
+			return true; // Parsed by the StartupFrameBuffer, and holds no SPS to report.
+		H264FrameInfo info;
+		if (!frame.Classify(info))
+			return frame.keyframe();
+		if (info.hasSps && (!haveSps_ || info.sps.width != sps_.width || info.sps.height != sps_.height || info.sps.profile != sps_.profile || info.sps.level != sps_.level))
+		{
+			sps_ = info.sps;
+			haveSps_ = true;
+			std::stringstream sstm;
+			sstm << "sps {" // Sequence parameter set
+				<< "\"w\":" << sps_.width
+				<< ",\"h\":" << sps_.height
+				<< ",\"profile\":" << sps_.profile
+				<< ",\"level\":" << sps_.level
+				<< " }";
+			instance_->PostString(sstm.str());
+		}
+		return true;
+	}
+
+	void Decoder::SetBacklogLimits(int64_t maxMs, int64_t maxBytes)
+	{
+		maxBacklogMs_ = maxMs;
+		maxBacklogBytes_ = maxBytes;
+		ShedBacklog();
+	}
+
+	void Decoder::ShedBacklog()
+	{
+		if (encodedFrameQueue.size() < 2)
+			return;
+		bool overDuration = maxBacklogMs_ > 0 && encodedFrameQueue.back().timestamp - encodedFrameQueue.front().timestamp > maxBacklogMs_;
+		bool overBytes = maxBacklogBytes_ > 0 && queuedBytes_ > maxBacklogBytes_;
+		if (!overDuration && !overBytes)
+			return;
+
+		// Frames before a keyframe are only needed to decode other frames before it, so they can all go, except the parameter
+		// sets it needs.  Without a keyframe in the queue nothing can be skipped; the backlog is cut as soon as one arrives.
+		size_t keyframe = encodedFrameQueue.size();
+		while (keyframe > 0 && !encodedFrameQueue[keyframe - 1].keyframe())
+			keyframe--;
+		if (keyframe == 0)
+			return;
+		size_t cut = KeyframeRunStart(keyframe - 1);
+		if (cut == 0)
+			return;
+
+		int64_t firstTimestamp = encodedFrameQueue.front().timestamp;
+		int64_t skippedBytes = 0;
+		for (size_t i = 0; i < cut; i++)
+		{
+			skippedBytes += encodedFrameQueue.front().size;
+			PopEncodedFrame();
+		}
+		backlogStats_.sheds++;
+		backlogStats_.skippedFrames += cut;
+		backlogStats_.skippedBytes += skippedBytes;
+
+		std::stringstream sstm;
+		sstm << "sk {" // Skipped frames
+			<< "\"frames\":" << cut
+			<< ",\"bytes\":" << skippedBytes
+			<< ",\"from\":" << firstTimestamp
+			<< ",\"to\":" << encodedFrameQueue.front().timestamp
+			<< " }";
+		instance_->PostString(sstm.str());
+	}
+
+	size_t Decoder::KeyframeRunStart(size_t keyframe) const
+	{
+		size_t start = keyframe;
+		while (start > 0 && encodedFrameQueue[start - 1].parameterSets() && !encodedFrameQueue[start - 1].keyframe())
+			start--;
+		return start;
+	}
+
+	void Decoder::PopEncodedFrame()
+	{
+		queuedBytes_ -= encodedFrameQueue.front().size;
+		encodedFrameQueue.pop_front();
+		QueueChanged();
+	}
+
+	void Decoder::QueueChanged()
+	{
+		if (queueChangedFunc_)
+			queueChangedFunc_();
+	}
+
 	void Decoder::DecodeNextFrame()
 	{
 		assert(ppDecoder);
-		// TODO: 
-		// If we've just reached the end of the bitstream, flush and wait.
-		//if (!flushing_ && encoded_data_next_pos_to_decode_ == kDataLen)
-		//{
-		//	flushing_ = true;
-		//	ppDecoder->Flush(callback_factory_.NewCallback(&Decoder::FlushDone));
-		//	return;
-		//}
 		if (encodedFrameQueue.empty())
 		{
 			decode_looping_ = false;
+			if (flushPending_)
+			{
+				// Everything received has been decoded, so flush and wait.  Frames that arrive meanwhile are queued until FlushDone.
+				flushPending_ = false;
+				flushing_ = true;
+				unflushed_ = false;
+				ppDecoder->Flush(std::bind(&Decoder::FlushDone, this, _1));
+			}
 			return; // No frame is currently available.  Exit the frame queue
 		}
 		decode_looping_ = true;
+		unflushed_ = true;
 
 		// Decode the frame. On completion, DecodeDone will call DecodeNextFrame to implement a decode loop.
 		EncodedFrame frame = encodedFrameQueue.front();
-		encodedFrameQueue.pop();
-		ppDecoder->Decode(frame.id, frame.buffer.ByteLength(), frame.buffer.Map(), callback_factory_.NewCallback(&Decoder::DecodeDone));
+		PopEncodedFrame();
+		frame.stages.submitted = FrameLatencyStats::Now(instance_->platform());
+		if (!frame.parameterSets() || frame.keyframe())
+			decodeTimestamps_.Add(frame.id, frame.timestamp, frame.stages); // Parameter sets alone produce no picture to take it.
+		decodingId_ = frame.id;
+		ppDecoder->Decode(frame.id, frame.size, frame.data(), std::bind(&Decoder::DecodeDone, this, _1));
 	}
 
 	void Decoder::DecodeDone(int32_t result)
@@ -123,34 +270,245 @@ namespace PnaclPlayer
 		assert(ppDecoder);
 
 		// Break out of the decode loop on abort.
-		if (result == PP_ERROR_ABORTED)
+		if (result == PLATFORM_ERROR_ABORTED)
 		{
 			decode_looping_ = false;
 			return;
 		}
-		assert(result == PP_OK);
+		if (result != PLATFORM_OK)
+		{
+			// The frame will not produce a picture.
+			int64_t timestamp;
+			FrameStageTimes stages;
+			decodeTimestamps_.Take(decodingId_, timestamp, stages);
+			errorStats_.decodeErrors++;
+			bool rejected = result == PLATFORM_ERROR_BADARGUMENT;
+			if (rejected)
+				errorStats_.rejectedFrames++;
+			HandleError("decode", result, !rejected);
+			if (!rejected)
+			{
+				decode_looping_ = false; // The backend is being replaced.
+				return;
+			}
+		}
 		if (!flushing_ && !resetting_)
 			DecodeNextFrame();
 	}
 
-	void Decoder::PictureReady(int32_t result, PP_VideoPicture picture)
+	void Decoder::GetPicture()
+	{
+		getPicturePending_ = true;
+		ppDecoder->GetPicture(std::bind(&Decoder::PictureReady, this, _1, _2));
+	}
+
+	void Decoder::PictureReady(int32_t result, const VideoPicture& picture)
 	{
 		assert(ppDecoder);
-		if (result == PP_ERROR_ABORTED)
+		getPicturePending_ = false;
+		if (result == PLATFORM_ERROR_ABORTED)
 			return; // Break out of the get picture loop on abort.
-		assert(result == PP_OK);
+		if (result != PLATFORM_OK)
+		{
+			errorStats_.pictureErrors++;
+			HandleError("picture", result, true);
+			return;
+		}
+		if (resetting_)
+		{
+			// Delivered just before the reset began.  ResetDone asks for pictures again.
+			ppDecoder->RecyclePicture(picture);
+			return;
+		}
 
-		ppDecoder->GetPicture(callback_factory_.NewCallbackWithOutput(&Decoder::PictureReady));
+		GetPicture();
 
-		int64_t timestamp = timestampMap[picture.decode_id];
-		instance_->ReceiveDecodedPicture(new DecodedFrame(this, picture, currentStreamNum, timestamp));
+		int64_t timestamp;
+		FrameStageTimes stages;
+		if (!decodeTimestamps_.Take(picture.decode_id, timestamp, stages))
+		{
+			// Without its timestamp the picture cannot be scheduled.
+			ppDecoder->RecyclePicture(picture);
+			return;
+		}
+		if (recovering_)
+		{
+			recovering_ = false;
+			int64_t recoveryMs = FrameLatencyStats::Now(instance_->platform()) / 1000 - errorMs_;
+			errorStats_.recoveries++;
+			errorStats_.lastRecoveryMs = recoveryMs;
+			if (recoveryMs > errorStats_.maxRecoveryMs)
+				errorStats_.maxRecoveryMs = recoveryMs;
+			std::stringstream sstm;
+			sstm << "dr {" // Decoder recovered
+				<< "\"s\":" << id_
+				<< ",\"ms\":" << recoveryMs
+				<< ",\"skipped\":" << errorStats_.skippedFrames
+				<< " }";
+			instance_->PostString(sstm.str());
+		}
+		DecodedFramePtr frame = framePool.Acquire(picture, currentStreamNum, timestamp);
+		frame->backendGeneration = backendGeneration_;
+		frame->stages = stages;
+		frame->stages.decoded = FrameLatencyStats::Now(instance_->platform());
+		instance_->ReceiveDecodedPicture(std::move(frame));
 	}
 
 	void Decoder::FlushDone(int32_t result)
 	{
 		assert(ppDecoder);
-		assert(result == PP_OK || result == PP_ERROR_ABORTED);
 		assert(flushing_);
 		flushing_ = false;
+		if (result == PLATFORM_ERROR_ABORTED || resetting_)
+			return; // Interrupted by Reset; ResetDone starts decoding again.
+		if (result != PLATFORM_OK)
+		{
+			errorStats_.flushErrors++;
+			HandleError("flush", result, true);
+			return;
+		}
+
+		// The flush aborted any GetPicture that was pending, ending the loop the way a reset does.  If the last picture's
+		// callback was still on its way instead, PictureReady has already asked for the next one.
+		if (!getPicturePending_)
+			GetPicture();
+		if (endOfStream_ && !flushPending_) // Not if EndOfStream came during an idle flush, which may not include its last frames.
+		{
+			endOfStream_ = false;
+			std::stringstream sstm;
+			sstm << "eos {" // End of stream
+				<< "\"s\":" << id_
+				<< " }";
+			instance_->PostString(sstm.str());
+		}
+		DecodeNextFrame();
+	}
+
+	void Decoder::RequestFlush()
+	{
+		flushPending_ = true;
+		if (!resetting_ && !flushing_ && !initializing_ && !decode_looping_)
+			DecodeNextFrame();
+	}
+
+	void Decoder::SetIdleFlush(int32_t ms)
+	{
+		idleFlushMs_ = ms > 0 ? ms : 0;
+		if (idleFlushMs_ > 0)
+			ScheduleIdleCheck(idleFlushMs_);
+	}
+
+	void Decoder::EndOfStream()
+	{
+		flushStats_.endOfStreamFlushes++;
+		endOfStream_ = true;
+		RequestFlush();
+	}
+
+	void Decoder::ScheduleIdleCheck(int32_t delayMs)
+	{
+		if (idleCheckPending_)
+			return;
+		idleCheckPending_ = true;
+		std::weak_ptr<bool> alive(alive_);
+		instance_->platform()->CallOnMainThread(delayMs, [this, alive](int32_t result)
+		{
+			if (!alive.expired())
+				IdleCheck();
+		}, 0);
+	}
+
+	void Decoder::IdleCheck()
+	{
+		idleCheckPending_ = false;
+		if (idleFlushMs_ <= 0 || flushPending_ || flushing_ || (!unflushed_ && encodedFrameQueue.empty()))
+			return;
+		int64_t idleMs = FrameLatencyStats::Now(instance_->platform()) / 1000 - lastReceivedMs_;
+		if (idleMs < idleFlushMs_)
+		{
+			// A frame arrived since this check was scheduled.
+			ScheduleIdleCheck((int32_t)(idleFlushMs_ - idleMs));
+			return;
+		}
+		flushStats_.idleFlushes++;
+		RequestFlush();
+	}
+
+	void Decoder::HandleError(const char* stage, int32_t result, bool reinitialize)
+	{
+		if (!recovering_)
+		{
+			recovering_ = true;
+			errorMs_ = FrameLatencyStats::Now(instance_->platform()) / 1000;
+		}
+		std::stringstream sstm;
+		sstm << "de {" // Decoder error
+			<< "\"s\":" << id_
+			<< ",\"stage\":\"" << stage << "\""
+			<< ",\"result\":" << result
+			<< ",\"reinit\":" << (reinitialize ? "true" : "false")
+			<< " }";
+		instance_->PostString(sstm.str());
+
+		SkipQueueToKeyframe();
+		if (reinitialize)
+			ScheduleReinitialize(initializing_ ? kInitializeRetryMs : 0); // Only Initialize itself fails while initializing_.
+	}
+
+	void Decoder::SkipQueueToKeyframe()
+	{
+		// Parameter sets are kept: the new backend, or the keyframe, needs them.
+		size_t kept = 0;
+		for (std::deque<EncodedFrame>::iterator it = encodedFrameQueue.begin(); it != encodedFrameQueue.end() && !it->keyframe();)
+		{
+			if (it->parameterSets())
+			{
+				++it;
+				kept++;
+				continue;
+			}
+			errorStats_.skippedFrames++;
+			queuedBytes_ -= it->size;
+			it = encodedFrameQueue.erase(it);
+		}
+		if (encodedFrameQueue.size() == kept)
+			skipToKeyframe_ = true;
+		QueueChanged();
+	}
+
+	void Decoder::ScheduleReinitialize(int32_t delayMs)
+	{
+		// Stop using the failed backend.  Frames are queued, as during the first initialization, until the new one is ready.
+		initializing_ = true;
+		if (reinitializePending_)
+			return;
+		reinitializePending_ = true;
+		std::weak_ptr<bool> alive(alive_);
+		instance_->platform()->CallOnMainThread(delayMs, [this, alive](int32_t result)
+		{
+			if (!alive.expired())
+				Reinitialize();
+		}, 0);
+	}
+
+	void Decoder::Reinitialize()
+	{
+		reinitializePending_ = false;
+		errorStats_.reinitializations++;
+		delete ppDecoder; // Its pending callbacks are never run.
+		backendGeneration_++;
+		currentStreamNum++; // The player drops pictures of the old backend that it has not shown yet.
+		decodeTimestamps_.Clear();
+		flushing_ = false;
+		resetting_ = false;
+		decode_looping_ = false;
+		getPicturePending_ = false;
+		// An end of stream still waiting for its flush is kept, and the new backend is flushed once it has decoded the queue.
+		flushPending_ = flushPending_ || endOfStream_;
+		unflushed_ = false;
+		initializing_ = true;
+		ppDecoder = instance_->platform()->CreateVideoDecoder(context_);
+		assert(ppDecoder);
+		ppDecoder->Initialize(hwaccel_, std::bind(&Decoder::InitializeDone, this, _1));
 	}
 }
\ No newline at end of file
@@ -1,21 +1,71 @@
 #pragma once
 #include "EncodedFrame.h"
 #include "DecodedFrame.h"
+#include "DecodedFramePool.h"
+#include "H264Parser.h"
+#include "DecodeTimestampRing.h"
 
-#include <queue>
-#include <map>
+#include "Platform.h"
 
-#include "ppapi/cpp/graphics_3d.h"
-#include "ppapi/cpp/video_decoder.h"
-#include "ppapi/utility/completion_callback_factory.h"
+#include <deque>
+#include <functional>
 
 namespace PnaclPlayer
 {
+	/// <summary>
+	/// Counters for frames the decoder discarded without decoding to catch up with a live stream.
+	/// </summary>
+	struct BacklogStats
+	{
+		BacklogStats() : sheds(0), skippedFrames(0), skippedBytes(0), startupSkippedFrames(0) {}
+		/// <summary>Number of times the backlog was cut back to a keyframe.</summary>
+		int64_t sheds;
+		int64_t skippedFrames;
+		int64_t skippedBytes;
+		/// <summary>Frames discarded while the decoder was initializing, because a newer keyframe arrived before decoding began.</summary>
+		int64_t startupSkippedFrames;
+	};
+
+	/// <summary>
+	/// Counters for the errors reported by the video decoder backend, and for recovering from them.
+	/// </summary>
+	struct DecodeErrorStats
+	{
+		DecodeErrorStats() : initializeErrors(0), decodeErrors(0), pictureErrors(0), resetErrors(0), flushErrors(0), rejectedFrames(0), reinitializations(0), skippedFrames(0), recoveries(0), lastRecoveryMs(0), maxRecoveryMs(0) {}
+		int64_t initializeErrors;
+		int64_t decodeErrors;
+		int64_t pictureErrors;
+		int64_t resetErrors;
+		int64_t flushErrors;
+		/// <summary>Decode errors that rejected only the frame (PLATFORM_ERROR_BADARGUMENT), leaving the backend usable.</summary>
+		int64_t rejectedFrames;
+		/// <summary>Times the backend was replaced with a new one, because it had failed.</summary>
+		int64_t reinitializations;
+		/// <summary>Frames discarded after an error while waiting for a keyframe.</summary>
+		int64_t skippedFrames;
+		int64_t recoveries;
+		/// <summary>Time from an error to the next picture, for the latest and the slowest recovery.</summary>
+		int64_t lastRecoveryMs;
+		int64_t maxRecoveryMs;
+	};
+
+	/// <summary>
+	/// Counters for the times the decoder was flushed to get out the pictures it was holding back.
+	/// </summary>
+	struct FlushStats
+	{
+		FlushStats() : idleFlushes(0), endOfStreamFlushes(0) {}
+		/// <summary>Flushes because no frame had arrived for the idle flush interval.</summary>
+		int64_t idleFlushes;
+		/// <summary>Flushes asked for by EndOfStream.</summary>
+		int64_t endOfStreamFlushes;
+	};
+
 	class pnacl_player;
 	class Decoder
 	{
 	public:
-		Decoder(pnacl_player* instance, int id, const pp::Graphics3D& graphics_3d, int hwaccel);
+		Decoder(pnacl_player* instance, int id, GraphicsContext* context, int hwaccel);
 		~Decoder();
 
 		int id() const { return id_; }
@@ -31,11 +81,12 @@ namespace PnaclPlayer
 		/// <summary>
 		/// The queue of frames that have not yet been decoded.
 		/// </summary>
-		std::queue<EncodedFrame> encodedFrameQueue;
+		std::deque<EncodedFrame> encodedFrameQueue;
+
 		/// <summary>
-		/// The queue of frames that have not yet been decoded.
+		/// Frames handed to the player are allocated from this pool.  It must outlive every frame, so the player releases all of its frames before deleting the Decoder.
 		/// </summary>
-		std::map<int32_t, int64_t> timestampMap;
+		DecodedFramePool framePool;
 
 		/// <summary>
 		/// The current stream number.  Incremented with each Reset() call.
@@ -44,35 +95,185 @@ namespace PnaclPlayer
 
 		/// <summary>
 		/// Clears the queue of frames that have not yet been decoded, and begins asynchronously resetting the decoder.  It is safe to begin sending new frames to the decoder immediately after this method returns.
+		/// While the decoder is initializing (or being replaced after an error) or already resetting, the queue is cleared and pictures already decoded become stale all the same.
 		/// </summary>
 		void Reset();
 		/// <summary>
-		/// Call this when finished with PP_VideoPicture, to allow the decoder to continue decoding frames.
+		/// Call this when finished with a VideoPicture, to allow the decoder to continue decoding frames.  Pictures lent by a backend that has since been replaced are ignored.
 		/// </summary>
-		void RecyclePicture(const PP_VideoPicture& picture);
+		void RecyclePicture(const VideoPicture& picture, int32_t backendGeneration);
 		/// <summary>
 		/// Call this when the browser sends an ArrayBuffer containing video data.  The decoder is responsible for deleting the EncodedFrame when it is no longer needed.
+		/// Frames received while the decoder is initializing are queued, and decoding starts from the most recent keyframe among them.
 		/// </summary>
 		void ReceiveFrame(EncodedFrame frame);
+		/// <summary>
+		/// Discards received frames until the next keyframe, so that decoding a new stream starts at a frame that can be decoded
+		/// on its own.  Stops discarding at the first frame that cannot be classified (see ClassifyFrame).  Frames holding only parameter sets are kept.
+		/// </summary>
+		void SkipToKeyframe() { skipToKeyframe_ = true; }
+		/// <summary>
+		/// The most recent sequence parameter set seen in the stream.  Only valid if haveSps() is true.
+		/// </summary>
+		const H264SpsInfo& sps() const { return sps_; }
+		bool haveSps() const { return haveSps_; }
+
+		/// <summary>
+		/// Enables live catch-up: whenever the frames waiting to be decoded span more than maxMs of timestamps or hold more than
+		/// maxBytes, everything before the newest keyframe in the queue is discarded.  A limit of 0 or less disables that check.
+		/// </summary>
+		void SetBacklogLimits(int64_t maxMs, int64_t maxBytes);
+		const BacklogStats& backlogStats() const { return backlogStats_; }
+
+		/// <summary>
+		/// Enables flush on idle: when no frame has arrived for |ms|, the decoder is flushed once the frames it has been given are
+		/// decoded.  A decoder may hold its last pictures back (to reorder them) until more data comes, so without this the last
+		/// frame of a live stream that pauses, such as a motion-triggered camera, is shown late or not at all.  Decoding resumes
+		/// normally with the next frame.  0 or less disables it.
+		/// </summary>
+		void SetIdleFlush(int32_t ms);
+		/// <summary>
+		/// Flushes the decoder once the frames already received are decoded, so every picture of a finished clip is shown, and
+		/// then tells the browser with an "eos" message.  Frames received after this are decoded as usual.
+		/// </summary>
+		void EndOfStream();
+		const FlushStats& flushStats() const { return flushStats_; }
+		const DecodeErrorStats& errorStats() const { return errorStats_; }
+
+		/// <summary>
+		/// Sets a function called whenever frames are added to or removed from the queue, for the flow control of the stream the decoder belongs to.
+		/// </summary>
+		void SetQueueChangedFunc(const std::function<void()>& func) { queueChangedFunc_ = func; }
+		/// <summary>
+		/// Bytes in the frames waiting to be decoded.
+		/// </summary>
+		int64_t queuedBytes() const { return queuedBytes_; }
+		/// <summary>
+		/// Counts pictures whose decode id could not be matched to a timestamp.  Such pictures are recycled without being shown.
+		/// </summary>
+		const DecodeTimestampStats& decodeTimestampStats() const { return decodeTimestamps_.stats(); }
 	private:
+		/// <summary>
+		/// Frames preallocated in framePool.  PPAPI does not tell us how many pictures the decoder will lend out at once; the pool grows past this if it needs to.
+		/// </summary>
+		static const size_t kInitialFramePoolSize = 8;
+		/// <summary>
+		/// Frames that can be inside the video decoder at once before their timestamps are overwritten.  H.264 allows 16 reference
+		/// frames plus the pictures lent to the player; this leaves plenty of room.
+		/// </summary>
+		static const size_t kDecodeTimestampRingSize = 128;
+		/// <summary>
+		/// Wait before trying again after the backend failed to initialize, so a decoder that cannot start does not spin.
+		/// </summary>
+		static const int32_t kInitializeRetryMs = 1000;
+
 		void InitializeDone(int32_t result);
 		void Start();
 		void DecodeNextFrame();
 		void DecodeDone(int32_t result);
-		void PictureReady(int32_t result, PP_VideoPicture picture);
+		/// <summary>
+		/// Asks ppDecoder for the next picture, continuing the GetPicture loop.
+		/// </summary>
+		void GetPicture();
+		void PictureReady(int32_t result, const VideoPicture& picture);
 		void FlushDone(int32_t result);
 		void ResetDone(int32_t result);
+		/// <summary>
+		/// Flushes the decoder as soon as it has no frame to decode.
+		/// </summary>
+		void RequestFlush();
+		/// <summary>
+		/// Checks for idleness after |delayMs|, unless a check is already pending.
+		/// </summary>
+		void ScheduleIdleCheck(int32_t delayMs);
+		void IdleCheck();
+		/// <summary>
+		/// Handles a failed backend call instead of asserting.  Frames are discarded until the next keyframe, since frames after
+		/// the error may refer to pictures the decoder no longer has.  |reinitialize| replaces the backend, which is needed for every
+		/// error except PLATFORM_ERROR_BADARGUMENT from Decode (that rejects just the one frame); any other error leaves a
+		/// PPB_VideoDecoder failing every later call.  Posts "de {...}" with the stage and result.
+		/// </summary>
+		void HandleError(const char* stage, int32_t result, bool reinitialize);
+		/// <summary>
+		/// Replaces ppDecoder with a new, initializing backend.  Pictures still held from the old one become stale.
+		/// </summary>
+		void Reinitialize();
+		/// <summary>
+		/// Posts Reinitialize, unless it is already pending.  It does not run right away because errors arrive in ppDecoder's own callbacks.
+		/// </summary>
+		void ScheduleReinitialize(int32_t delayMs);
+		/// <summary>
+		/// Discards queued frames up to the next keyframe, or all of them and the ones received until a keyframe arrives.  Parameter set frames are kept.
+		/// </summary>
+		void SkipQueueToKeyframe();
+		/// <summary>
+		/// Sets the keyframe and parameter set flags from the frame's NAL units, and tells the browser when the stream's SPS changes.  Returns false if it is not known whether the frame is a keyframe:
+		/// the frame is not Annex-B H.264 and was not flagged as a keyframe by the sender.
+		/// </summary>
+		bool ClassifyFrame(EncodedFrame& frame);
+		/// <summary>
+		/// Applies the backlog limits to encodedFrameQueue.
+		/// </summary>
+		void ShedBacklog();
+		/// <summary>
+		/// Returns the index in encodedFrameQueue where decoding must start to decode the keyframe at |keyframe| (which may be one past
+		/// the end, for a keyframe about to be queued): the first of the parameter set frames just before it, if any.
+		/// </summary>
+		size_t KeyframeRunStart(size_t keyframe) const;
+		void PopEncodedFrame();
+		/// <summary>
+		/// Calls queueChangedFunc_, if set.  Called whenever the queue changes.
+		/// </summary>
+		void QueueChanged();
 
 		pnacl_player* instance_;
 		int id_;
+		// Kept to create a new backend after an error.
+		GraphicsContext* context_;
+		HardwareAcceleration hwaccel_;
 
-		pp::VideoDecoder* ppDecoder;
-		pp::CompletionCallbackFactory<Decoder> callback_factory_;
+		VideoDecoderBackend* ppDecoder;
+		// Incremented whenever ppDecoder is replaced.
+		int32_t backendGeneration_;
+		// The decode id of the frame in ppDecoder->Decode, whose timestamp is forgotten if the decode fails.
+		uint32_t decodingId_;
 
 		int next_picture_id_;
 		bool flushing_;
 		bool resetting_;
 		bool initializing_;
 		bool decode_looping_;
+		int64_t queuedBytes_;
+		int64_t maxBacklogMs_;
+		int64_t maxBacklogBytes_;
+		BacklogStats backlogStats_;
+		std::function<void()> queueChangedFunc_;
+		// Timestamps of the frames passed to ppDecoder, by decode id.
+		DecodeTimestampRing decodeTimestamps_;
+		H264SpsInfo sps_;
+		bool haveSps_;
+		bool skipToKeyframe_;
+		// A GetPicture call is waiting for its PictureReady.
+		bool getPicturePending_;
+		int32_t idleFlushMs_;
+		// When the last frame was received, in milliseconds.
+		int64_t lastReceivedMs_;
+		bool idleCheckPending_;
+		// Frames have been passed to ppDecoder since the last flush, so it may be holding pictures back.
+		bool unflushed_;
+		// A flush is to start the next time the frame queue is empty.
+		bool flushPending_;
+		// The flush pending or in progress was asked for by EndOfStream.
+		bool endOfStream_;
+		FlushStats flushStats_;
+		DecodeErrorStats errorStats_;
+		// An error has happened and no picture has come out since.  Frames skipped during the recovery are counted in skippedFrames.
+		bool recovering_;
+		// When the first error of the current recovery happened, in milliseconds.
+		int64_t errorMs_;
+		// Reinitialize has been posted and not run yet.
+		bool reinitializePending_;
+		// Pending idle checks and reinitializations hold a weak reference to this, so they do nothing once the decoder has been deleted.
+		std::shared_ptr<bool> alive_;
 	};
 }
\ No newline at end of file
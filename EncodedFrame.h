@@ -1,14 +1,67 @@
 #pragma once
-#include "ppapi/cpp/var_array_buffer.h"
+#include "Platform.h"
+#include "FrameLatencyStats.h"
+#include "H264Parser.h"
 namespace PnaclPlayer
 {
+	/// <summary>
+	/// Bits of EncodedFrame::flags.
+	/// </summary>
+	enum EncodedFrameFlags
+	{
+		/// <summary>The frame starts with an IDR picture, so decoding can begin here.</summary>
+		ENCODED_FRAME_KEYFRAME = 1,
+		/// <summary>Bits 8 to 15 hold the frame's generation: the number of times the sender has switched its stream to another source, modulo 256.</summary>
+		ENCODED_FRAME_GENERATION_SHIFT = 8,
+		/// <summary>Set by the player from the NAL units (the sender's flags are only 16 bits): the frame holds an SPS or PPS and no picture
+		/// other than an IDR.  Pages often send the parameter sets in a message of their own just before the IDR, so such frames belong to
+		/// the keyframe that follows them.</summary>
+		ENCODED_FRAME_PARAMETER_SETS = 1 << 16,
+		/// <summary>Set by the player once the NAL units have been parsed, so the keyframe and parameter set flags need not be worked out again.</summary>
+		ENCODED_FRAME_CLASSIFIED = 1 << 17
+	};
+
+	/// <summary>
+	/// One access unit waiting to be decoded.  The bytes are a range within a buffer received from the browser, which may be shared with other frames that arrived in the same message.
+	/// </summary>
 	struct EncodedFrame
 	{
-		EncodedFrame() : buffer(pp::VarArrayBuffer()), timestamp(0) {}
-		EncodedFrame(pp::VarArrayBuffer& buffer, int64_t timestamp) : buffer(buffer), timestamp(timestamp), id(0) {}
+		EncodedFrame() : buffer(), offset(0), size(0), timestamp(0), flags(0), id(0) {}
+		EncodedFrame(const ByteBufferPtr& buffer, int64_t timestamp) : buffer(buffer), offset(0), size(buffer->ByteLength()), timestamp(timestamp), flags(0), id(0) {}
+		EncodedFrame(const ByteBufferPtr& buffer, uint32_t offset, uint32_t size, int64_t timestamp, uint32_t flags) : buffer(buffer), offset(offset), size(size), timestamp(timestamp), flags(flags), id(0) {}
 		~EncodedFrame() {}
-		pp::VarArrayBuffer buffer;
+
+		const void* data() const { return (const uint8_t*)buffer->Map() + offset; }
+		bool keyframe() const { return (flags & ENCODED_FRAME_KEYFRAME) != 0; }
+		bool parameterSets() const { return (flags & ENCODED_FRAME_PARAMETER_SETS) != 0; }
+		bool classified() const { return (flags & ENCODED_FRAME_CLASSIFIED) != 0; }
+
+		/// <summary>
+		/// Parses the NAL units into |info| and sets the keyframe, parameter set and classified flags from them.  Returns false, leaving
+		/// the flags as they are, if the frame is not Annex-B H.264.
+		/// </summary>
+		bool Classify(H264FrameInfo& info)
+		{
+			if (!H264Parser::ParseFrame((const uint8_t*)data(), size, info))
+				return false;
+			flags |= ENCODED_FRAME_CLASSIFIED;
+			if (info.idr())
+				flags |= ENCODED_FRAME_KEYFRAME;
+			if ((info.has(NAL_SPS) || info.has(NAL_PPS)) && (info.firstSliceType == 0 || info.idr()))
+				flags |= ENCODED_FRAME_PARAMETER_SETS;
+			return true;
+		}
+		uint8_t generation() const { return (uint8_t)(flags >> ENCODED_FRAME_GENERATION_SHIFT); }
+
+		ByteBufferPtr buffer;
+		uint32_t offset;
+		uint32_t size;
 		int64_t timestamp;
+		uint32_t flags;
 		int32_t id;
+		/// <summary>
+		/// When the frame reached each stage so far, for the latency stats.
+		/// </summary>
+		FrameStageTimes stages;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "FrameLatencyStats.h"
+
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	FrameLatencyStats::FrameLatencyStats()
+	{
+	}
+
+	FrameLatencyStats::~FrameLatencyStats()
+	{
+	}
+
+	void FrameLatencyStats::Record(const FrameStageTimes& times, int64_t presented)
+	{
+		stages_[LATENCY_INGEST].Record(times.queued - times.received);
+		stages_[LATENCY_QUEUE].Record(times.submitted - times.queued);
+		stages_[LATENCY_DECODE].Record(times.decoded - times.submitted);
+		stages_[LATENCY_SCHEDULE].Record(times.scheduled - times.decoded);
+		stages_[LATENCY_PAINT].Record(times.drawn - times.scheduled);
+		stages_[LATENCY_SWAP].Record(presented - times.drawn);
+		stages_[LATENCY_TOTAL].Record(presented - times.received);
+	}
+
+	void FrameLatencyStats::Clear()
+	{
+		for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+			stages_[i].Clear();
+		judder_.Clear();
+	}
+
+	std::string FrameLatencyStats::ToJson() const
+	{
+		std::string json = "{";
+		for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+		{
+			if (i > 0)
+				json += ",";
+			json += "\"";
+			json += StageName((LatencyStage)i);
+			json += "\":";
+			stages_[i].AppendJson(json);
+		}
+		json += ",\"judder\":";
+		judder_.AppendJson(json);
+		json += "}";
+		return json;
+	}
+
+	const char* FrameLatencyStats::StageName(LatencyStage stage)
+	{
+		switch (stage)
+		{
+		case LATENCY_INGEST: return "ingest";
+		case LATENCY_QUEUE: return "queue";
+		case LATENCY_DECODE: return "decode";
+		case LATENCY_SCHEDULE: return "schedule";
+		case LATENCY_PAINT: return "paint";
+		case LATENCY_SWAP: return "swap";
+		case LATENCY_TOTAL: return "total";
+		default:
+			assert(false);
+			return "";
+		}
+	}
+}
\ No newline at end of file
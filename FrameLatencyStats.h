@@ -0,0 +1,83 @@
+#pragma once
+#include "Platform.h"
+#include "LatencyHistogram.h"
+#include <string>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// The stages a frame passes through between arriving from the page and being on screen.  Each is measured from the end of the one before it.
+	/// </summary>
+	enum LatencyStage
+	{
+		/// <summary>From the message arriving to the frame being queued at its decoder, including any wait in the ingest queue.</summary>
+		LATENCY_INGEST,
+		/// <summary>Waiting in the decoder's queue of encoded frames.</summary>
+		LATENCY_QUEUE,
+		/// <summary>From Decode to PictureReady.</summary>
+		LATENCY_DECODE,
+		/// <summary>Held by the RenderScheduler until the frame is due.</summary>
+		LATENCY_SCHEDULE,
+		/// <summary>Waiting in the paint queue for the previous refresh to finish.</summary>
+		LATENCY_PAINT,
+		/// <summary>From drawing and SwapBuffers to PaintFinished.</summary>
+		LATENCY_SWAP,
+		/// <summary>The whole way, from the message arriving to PaintFinished.</summary>
+		LATENCY_TOTAL,
+		LATENCY_STAGE_COUNT
+	};
+
+	/// <summary>
+	/// The times, in microseconds from FrameLatencyStats::Now, at which a frame reached each stage.  Carried along with the frame.
+	/// </summary>
+	struct FrameStageTimes
+	{
+		FrameStageTimes() : received(0), queued(0), submitted(0), decoded(0), scheduled(0), drawn(0) {}
+		int64_t received;
+		int64_t queued;
+		int64_t submitted;
+		int64_t decoded;
+		int64_t scheduled;
+		int64_t drawn;
+	};
+
+	/// <summary>
+	/// A latency histogram for every stage, filled in as frames reach the screen.  Frames that are dropped or skipped are not counted.
+	/// </summary>
+	class FrameLatencyStats
+	{
+	public:
+		FrameLatencyStats();
+		~FrameLatencyStats();
+
+		/// <summary>
+		/// The clock frames are stamped with, in microseconds.
+		/// </summary>
+		static int64_t Now(Platform* platform)
+		{
+			return (int64_t)(platform->GetTimeTicks() * 1000000);
+		}
+
+		/// <summary>
+		/// Counts a frame that finished painting at the given time.
+		/// </summary>
+		void Record(const FrameStageTimes& times, int64_t presented);
+		/// <summary>
+		/// Counts how far, in microseconds, the time between two consecutive frames on screen differed from the time between their presentation times.
+		/// </summary>
+		void RecordJudder(int64_t judderUs) { judder_.Record(judderUs); }
+		void Clear();
+
+		const LatencyHistogram& stage(LatencyStage stage) const { return stages_[stage]; }
+		const LatencyHistogram& judder() const { return judder_; }
+		/// <summary>
+		/// Returns {"ingest":{..},"queue":{..},..,"total":{..},"judder":{..}} with a LatencyHistogram summary for every stage and for judder.
+		/// </summary>
+		std::string ToJson() const;
+
+		static const char* StageName(LatencyStage stage);
+
+	private:
+		LatencyHistogram stages_[LATENCY_STAGE_COUNT];
+		LatencyHistogram judder_;
+	};
+}
\ No newline at end of file
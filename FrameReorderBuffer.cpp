@@ -0,0 +1,38 @@
+#include "FrameReorderBuffer.h"
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	FrameReorderBuffer::FrameReorderBuffer(size_t capacity) : capacity_(capacity), head_(0), count_(0)
+	{
+		assert(capacity > 0);
+		// Round the ring up to a power of two so slot indices wrap with a mask instead of a division.
+		size_t ring = 1;
+		while (ring < capacity)
+			ring <<= 1;
+		mask_ = ring - 1;
+		slots_.resize(ring);
+	}
+
+	void FrameReorderBuffer::Insert(DecodedFramePtr frame)
+	{
+		assert(!full());
+		size_t i = count_;
+		while (i > 0 && slots_[Slot(i - 1)]->presentationTime > frame->presentationTime)
+		{
+			slots_[Slot(i)] = std::move(slots_[Slot(i - 1)]);
+			i--;
+		}
+		slots_[Slot(i)] = std::move(frame);
+		count_++;
+	}
+
+	DecodedFramePtr FrameReorderBuffer::PopFront()
+	{
+		assert(!empty());
+		DecodedFramePtr oldest = std::move(slots_[head_]);
+		head_ = (head_ + 1) & mask_;
+		count_--;
+		return oldest;
+	}
+}
\ No newline at end of file
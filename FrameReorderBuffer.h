@@ -0,0 +1,41 @@
+#pragma once
+#include "DecodedFrame.h"
+#include <vector>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// A fixed-capacity queue of decoded frames kept in order of presentation time (which follows the timestamps).  Storage is a ring allocated once at construction, so
+	/// inserting and dequeuing never allocate.  Frames normally arrive in order and are inserted at the back in O(1); a frame that
+	/// arrives out of order is moved toward the front past the frames due after it, like one step of an insertion sort.
+	/// Frames due at the same time keep their arrival order.
+	/// </summary>
+	class FrameReorderBuffer
+	{
+	public:
+		FrameReorderBuffer(size_t capacity);
+		~FrameReorderBuffer() {}
+
+		size_t size() const { return count_; }
+		size_t capacity() const { return capacity_; }
+		bool empty() const { return count_ == 0; }
+		bool full() const { return count_ == capacity_; }
+		/// <summary>Returns the frame due first.  Do not call if the queue is empty.</summary>
+		DecodedFrame* front() const { return slots_[head_].get(); }
+		/// <summary>Returns the frame due index-th, counting from 0 for front().  Do not call with an index beyond the queue.</summary>
+		DecodedFrame* at(size_t index) const { return slots_[Slot(index)].get(); }
+
+		/// <summary>Adds a frame in presentation time order.  Do not call if the queue is full.</summary>
+		void Insert(DecodedFramePtr frame);
+		/// <summary>Removes and returns the frame due first.  Do not call if the queue is empty.</summary>
+		DecodedFramePtr PopFront();
+
+	private:
+		size_t Slot(size_t index) const { return (head_ + index) & mask_; }
+
+		std::vector<DecodedFramePtr> slots_;
+		size_t capacity_;
+		size_t mask_;
+		size_t head_;
+		size_t count_;
+	};
+}
\ No newline at end of file
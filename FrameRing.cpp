@@ -0,0 +1,35 @@
+#include "FrameRing.h"
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	void FrameRing::PushBack(DecodedFramePtr frame)
+	{
+		assert(!full());
+		size_t tail = head_ + count_;
+		if (tail >= slots_.size())
+			tail -= slots_.size();
+		slots_[tail] = std::move(frame);
+		count_++;
+	}
+
+	DecodedFramePtr FrameRing::PopFront()
+	{
+		assert(!empty());
+		DecodedFramePtr oldest = std::move(slots_[head_]);
+		if (++head_ == slots_.size())
+			head_ = 0;
+		count_--;
+		return oldest;
+	}
+
+	void FrameRing::SetCapacity(size_t capacity)
+	{
+		assert(capacity > 0 && capacity >= count_);
+		std::vector<DecodedFramePtr> slots(capacity);
+		for (size_t i = 0; i < count_; i++)
+			slots[i] = std::move(slots_[(head_ + i) % slots_.size()]);
+		slots_.swap(slots);
+		head_ = 0;
+	}
+}
\ No newline at end of file
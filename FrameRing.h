@@ -0,0 +1,35 @@
+#pragma once
+#include "DecodedFrame.h"
+#include <vector>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// A first-in-first-out queue of decoded frames with a fixed capacity.  Storage is allocated when the capacity is set, so
+	/// pushing and popping never allocate.
+	/// </summary>
+	class FrameRing
+	{
+	public:
+		FrameRing(size_t capacity) : slots_(capacity), head_(0), count_(0) {}
+		~FrameRing() {}
+
+		size_t size() const { return count_; }
+		size_t capacity() const { return slots_.size(); }
+		bool empty() const { return count_ == 0; }
+		bool full() const { return count_ == slots_.size(); }
+		/// <summary>Returns the oldest frame.  Do not call if the queue is empty.</summary>
+		DecodedFrame* front() const { return slots_[head_].get(); }
+
+		/// <summary>Adds a frame at the back.  Do not call if the queue is full.</summary>
+		void PushBack(DecodedFramePtr frame);
+		/// <summary>Removes and returns the oldest frame.  Do not call if the queue is empty.</summary>
+		DecodedFramePtr PopFront();
+		/// <summary>Reallocates the ring with a new capacity, keeping the queued frames in order.  The new capacity must be at least size().</summary>
+		void SetCapacity(size_t capacity);
+
+	private:
+		std::vector<DecodedFramePtr> slots_;
+		size_t head_;
+		size_t count_;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "FrameTelemetry.h"
+
+#include <string.h>
+
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	// The page parses batches with a DataView at fixed offsets, so the layout must not depend on the compiler.
+	static_assert(sizeof(FrameTelemetryHeader) == 16, "FrameTelemetryHeader layout changed");
+	static_assert(sizeof(FrameTelemetryRecord) == 24, "FrameTelemetryRecord layout changed");
+
+	const size_t FrameTelemetry::kDefaultMaxRecords;
+	const int32_t FrameTelemetry::kDefaultMaxDelayMs;
+
+	FrameTelemetry::FrameTelemetry(Platform* platform) : platform_(platform), binary_(false), maxRecords_(0), maxDelayMs_(0), count_(0), sequence_(0)
+	{
+	}
+
+	FrameTelemetry::~FrameTelemetry()
+	{
+	}
+
+	void FrameTelemetry::EnableBinary(size_t maxRecords, int32_t maxDelayMs)
+	{
+		assert(maxRecords > 0 && maxRecords <= 0xFFFF);
+		assert(maxDelayMs > 0);
+		Flush();
+		binary_ = true;
+		maxRecords_ = maxRecords;
+		maxDelayMs_ = maxDelayMs;
+		batch_.assign(sizeof(FrameTelemetryHeader) + maxRecords * sizeof(FrameTelemetryRecord), 0);
+		FrameTelemetryHeader* header = (FrameTelemetryHeader*)&batch_[0];
+		memcpy(header->magic, "tlm1", 4);
+		header->recordSize = sizeof(FrameTelemetryRecord);
+	}
+
+	void FrameTelemetry::Disable()
+	{
+		Flush();
+		binary_ = false;
+	}
+
+	void FrameTelemetry::Add(FrameTelemetryEvent event, int32_t stream, int64_t timestamp, int32_t expectedInterframe, int32_t width, int32_t height, int64_t now)
+	{
+		assert(binary_);
+		FrameTelemetryRecord& record = records()[count_];
+		record.timestamp = timestamp;
+		record.expectedInterframe = expectedInterframe;
+		record.width = (uint16_t)width;
+		record.height = (uint16_t)height;
+		record.event = (uint8_t)event;
+		record.reserved = 0;
+		record.stream = (uint16_t)stream;
+		record.time = (uint32_t)now;
+
+		if (++count_ == 1)
+		{
+			// Start the delay for this batch.  If the batch fills up first, the sequence number will have moved on and the callback does nothing.
+			platform_->CallOnMainThread(maxDelayMs_, std::bind(&FrameTelemetry::DelayElapsed, this, std::placeholders::_1), (int32_t)sequence_);
+		}
+		if (count_ >= maxRecords_)
+			Flush();
+	}
+
+	void FrameTelemetry::Flush()
+	{
+		if (count_ == 0)
+			return;
+		FrameTelemetryHeader* header = (FrameTelemetryHeader*)&batch_[0];
+		header->recordCount = (uint16_t)count_;
+		header->sequence = sequence_++;
+		platform_->PostBinary(&batch_[0], (uint32_t)(sizeof(FrameTelemetryHeader) + count_ * sizeof(FrameTelemetryRecord)));
+		count_ = 0;
+	}
+
+	void FrameTelemetry::DelayElapsed(int32_t batch)
+	{
+		if ((uint32_t)batch == sequence_)
+			Flush();
+	}
+}
\ No newline at end of file
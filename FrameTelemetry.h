@@ -0,0 +1,97 @@
+#pragma once
+#include "Platform.h"
+#include <vector>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// What happened to the frame described by a FrameTelemetryRecord.
+	/// </summary>
+	enum FrameTelemetryEvent
+	{
+		/// <summary>Same meaning as an "rf" string message.</summary>
+		TELEMETRY_RENDERED = 0,
+		/// <summary>Same meaning as a "df" string message.</summary>
+		TELEMETRY_DROPPED = 1
+	};
+
+	/// <summary>
+	/// Start of every binary telemetry batch.  All fields are little-endian.  The header is followed by recordCount records of recordSize bytes each.
+	/// </summary>
+	struct FrameTelemetryHeader
+	{
+		/// <summary>Always "tlm1".  Lets the page tell telemetry apart from any other ArrayBuffer.</summary>
+		char magic[4];
+		uint16_t recordSize;
+		uint16_t recordCount;
+		/// <summary>Incremented for every batch sent, so the page can detect a lost batch.</summary>
+		uint32_t sequence;
+		uint32_t reserved;
+	};
+
+	/// <summary>
+	/// One frame in a binary telemetry batch.  Carries the same fields as the "rf" and "df" strings plus the time the event happened.
+	/// </summary>
+	struct FrameTelemetryRecord
+	{
+		/// <summary>"t": the frame's timestamp.</summary>
+		int64_t timestamp;
+		/// <summary>"i": the expected interframe time in milliseconds.</summary>
+		int32_t expectedInterframe;
+		/// <summary>"w" and "h".</summary>
+		uint16_t width;
+		uint16_t height;
+		/// <summary>A FrameTelemetryEvent.</summary>
+		uint8_t event;
+		uint8_t reserved;
+		/// <summary>"s": the id of the stream the frame belongs to.</summary>
+		uint16_t stream;
+		/// <summary>Low 32 bits of perfNow() when the event happened.</summary>
+		uint32_t time;
+	};
+
+	/// <summary>
+	/// Collects rf/df frame events into a preallocated batch and sends it to the browser as one ArrayBuffer when it holds
+	/// maxRecords records or when maxDelayMs has passed since its first record, whichever comes first.
+	/// </summary>
+	class FrameTelemetry
+	{
+	public:
+		FrameTelemetry(Platform* platform);
+		~FrameTelemetry();
+
+		static const size_t kDefaultMaxRecords = 64;
+		static const int32_t kDefaultMaxDelayMs = 250;
+
+		/// <summary>
+		/// Starts batching with the given limits.  Any records already batched are sent first.
+		/// </summary>
+		void EnableBinary(size_t maxRecords, int32_t maxDelayMs);
+		/// <summary>
+		/// Sends any batched records and goes back to string mode.
+		/// </summary>
+		void Disable();
+		/// <summary>
+		/// If true, frame events should be passed to Add instead of being posted as strings.
+		/// </summary>
+		bool binary() const { return binary_; }
+
+		void Add(FrameTelemetryEvent event, int32_t stream, int64_t timestamp, int32_t expectedInterframe, int32_t width, int32_t height, int64_t now);
+		/// <summary>
+		/// Sends the batched records now, if there are any.
+		/// </summary>
+		void Flush();
+
+	private:
+		void DelayElapsed(int32_t batch);
+		FrameTelemetryRecord* records() { return (FrameTelemetryRecord*)(&batch_[0] + sizeof(FrameTelemetryHeader)); }
+
+		Platform* platform_;
+		bool binary_;
+		size_t maxRecords_;
+		int32_t maxDelayMs_;
+		// Header followed by room for maxRecords_ records.  Allocated by EnableBinary, so adding a record never allocates.
+		std::vector<uint8_t> batch_;
+		size_t count_;
+		uint32_t sequence_;
+	};
+}
\ No newline at end of file
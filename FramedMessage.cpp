@@ -0,0 +1,61 @@
+#include "FramedMessage.h"
+
+#include <string.h>
+
+namespace PnaclPlayer
+{
+	static const char kFramedMessageMagic[] = "pnf1";
+
+	const uint32_t FramedMessageReader::kMagicSize;
+	const uint32_t FramedMessageReader::kHeaderSize;
+
+	FramedMessageReader::FramedMessageReader(const ByteBufferPtr& buffer) : buffer_(buffer), data_((const uint8_t*)buffer->Map()), size_(buffer->ByteLength()), position_(kMagicSize)
+	{
+	}
+
+	bool FramedMessageReader::IsFramed(ByteBuffer& buffer)
+	{
+		return buffer.ByteLength() >= kMagicSize && memcmp(buffer.Map(), kFramedMessageMagic, kMagicSize) == 0;
+	}
+
+	int32_t FramedMessageReader::Validate() const
+	{
+		int32_t count = 0;
+		uint32_t position = kMagicSize;
+		while (position < size_)
+		{
+			if (size_ - position < kHeaderSize)
+				return -1;
+			FramedMessageHeader header;
+			ReadHeader(data_ + position, header);
+			position += kHeaderSize;
+			if (header.length == 0 || header.length > size_ - position)
+				return -1;
+			position += header.length;
+			count++;
+		}
+		return count;
+	}
+
+	bool FramedMessageReader::Next(EncodedFrame& frame, int32_t& stream)
+	{
+		if (position_ >= size_)
+			return false;
+		FramedMessageHeader header;
+		ReadHeader(data_ + position_, header);
+		position_ += kHeaderSize;
+		frame = EncodedFrame(buffer_, position_, header.length, header.timestamp, header.flags);
+		stream = header.stream;
+		position_ += header.length;
+		return true;
+	}
+
+	void FramedMessageReader::ReadHeader(const uint8_t* src, FramedMessageHeader& header)
+	{
+		// The header can be at any offset, so copy rather than cast.  Every target this builds for is little-endian.
+		memcpy(&header.timestamp, src, 8);
+		memcpy(&header.length, src + 8, 4);
+		memcpy(&header.flags, src + 12, 2);
+		memcpy(&header.stream, src + 14, 2);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include "EncodedFrame.h"
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Header written before each frame in a framed ingest message.  All fields are little-endian and the header is not aligned within the message.
+	/// </summary>
+	struct FramedMessageHeader
+	{
+		int64_t timestamp;
+		/// <summary>Number of payload bytes that follow the header.</summary>
+		uint32_t length;
+		/// <summary>EncodedFrameFlags, including the generation in the high byte.  Undefined bits must be zero.</summary>
+		uint16_t flags;
+		/// <summary>Id of the stream the frame belongs to.</summary>
+		uint16_t stream;
+	};
+
+	/// <summary>
+	/// Splits a framed ingest message into EncodedFrames.  A framed message is the 4 byte magic "pnf1" followed by one or more frames,
+	/// each a FramedMessageHeader and its payload.  The frames reference the message buffer directly; nothing is copied.
+	/// </summary>
+	class FramedMessageReader
+	{
+	public:
+		static const uint32_t kMagicSize = 4;
+		static const uint32_t kHeaderSize = 16;
+
+		FramedMessageReader(const ByteBufferPtr& buffer);
+		~FramedMessageReader() {}
+
+		/// <summary>
+		/// Returns true if the buffer starts with the framed message magic.  An Annex-B H.264 stream always starts with a zero byte, so a plain frame never matches.
+		/// </summary>
+		static bool IsFramed(ByteBuffer& buffer);
+
+		/// <summary>
+		/// Checks that every header and payload lies within the buffer.  Returns the number of frames, or -1 if the message is malformed.
+		/// </summary>
+		int32_t Validate() const;
+		/// <summary>
+		/// Reads the next frame and the id of the stream it belongs to.  Returns false at the end of the message.  Call Validate first; a malformed message is not detected here.
+		/// </summary>
+		bool Next(EncodedFrame& frame, int32_t& stream);
+
+	private:
+		static void ReadHeader(const uint8_t* src, FramedMessageHeader& header);
+
+		ByteBufferPtr buffer_;
+		const uint8_t* data_;
+		uint32_t size_;
+		uint32_t position_;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "GLStateCache.h"
+
+#include <GLES2/gl2ext.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace PnaclPlayer
+{
+	GLStateCache::GLStateCache(GraphicsContext* context) : context_(context), program_(0), activeTexture_(GL_TEXTURE0), haveClearColor_(false), haveViewport_(false)
+	{
+		std::fill(&textures_[0][0], &textures_[0][0] + kCachedTextureUnits * kTextureTargets, kUnknownTexture);
+	}
+
+	GLStateCache::~GLStateCache()
+	{
+		delete context_;
+	}
+
+	bool GLStateCache::Issue(bool changed)
+	{
+		if (changed)
+			stats_.issued++;
+		else
+			stats_.elided++;
+		return changed;
+	}
+
+	void GLStateCache::ForgetUniforms(GLuint program)
+	{
+		std::map<UniformKey, UniformValue>::iterator it = uniforms_.lower_bound(UniformKey(program, std::numeric_limits<GLint>::min()));
+		while (it != uniforms_.end() && it->first.first == program)
+			uniforms_.erase(it++);
+	}
+
+	int32_t GLStateCache::ResizeBuffers(int32_t width, int32_t height)
+	{
+		Issue(true);
+		return context_->ResizeBuffers(width, height);
+	}
+
+	int32_t GLStateCache::SwapBuffers(const PlatformCallback& callback)
+	{
+		Issue(true);
+		stats_.swaps++;
+		std::fill(&textures_[0][0], &textures_[0][0] + kCachedTextureUnits * kTextureTargets, kUnknownTexture);
+		return context_->SwapBuffers(callback);
+	}
+
+	GLenum GLStateCache::GetError()
+	{
+		Issue(true);
+		return context_->GetError();
+	}
+
+	void GLStateCache::ClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)
+	{
+		if (!Issue(!haveClearColor_ || clearColor_[0] != red || clearColor_[1] != green || clearColor_[2] != blue || clearColor_[3] != alpha))
+			return;
+		haveClearColor_ = true;
+		clearColor_[0] = red;
+		clearColor_[1] = green;
+		clearColor_[2] = blue;
+		clearColor_[3] = alpha;
+		context_->ClearColor(red, green, blue, alpha);
+	}
+
+	void GLStateCache::Clear(GLbitfield mask)
+	{
+		Issue(true);
+		context_->Clear(mask);
+	}
+
+	void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		if (!Issue(!haveViewport_ || viewport_[0] != x || viewport_[1] != y || viewport_[2] != width || viewport_[3] != height))
+			return;
+		haveViewport_ = true;
+		viewport_[0] = x;
+		viewport_[1] = y;
+		viewport_[2] = width;
+		viewport_[3] = height;
+		context_->Viewport(x, y, width, height);
+	}
+
+	void GLStateCache::GenBuffers(GLsizei n, GLuint* buffers)
+	{
+		Issue(true);
+		context_->GenBuffers(n, buffers);
+	}
+
+	void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+	{
+		std::map<GLenum, GLuint>::iterator it = buffers_.find(target);
+		if (!Issue(it == buffers_.end() || it->second != buffer))
+			return;
+		buffers_[target] = buffer;
+		context_->BindBuffer(target, buffer);
+	}
+
+	void GLStateCache::BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+	{
+		Issue(true);
+		context_->BufferData(target, size, data, usage);
+	}
+
+	GLuint GLStateCache::CreateProgram()
+	{
+		Issue(true);
+		return context_->CreateProgram();
+	}
+
+	void GLStateCache::DeleteProgram(GLuint program)
+	{
+		Issue(true);
+		ForgetUniforms(program);
+		// A deleted program stays in use until another one is, but its name may be reused, so make the next UseProgram go through.
+		if (program_ == program)
+			program_ = 0;
+		context_->DeleteProgram(program);
+	}
+
+	void GLStateCache::LinkProgram(GLuint program)
+	{
+		Issue(true);
+		ForgetUniforms(program);
+		context_->LinkProgram(program);
+	}
+
+	void GLStateCache::UseProgram(GLuint program)
+	{
+		if (!Issue(program != program_))
+			return;
+		program_ = program;
+		context_->UseProgram(program);
+	}
+
+	GLuint GLStateCache::CreateShader(GLenum type)
+	{
+		Issue(true);
+		return context_->CreateShader(type);
+	}
+
+	void GLStateCache::ShaderSource(GLuint shader, GLsizei count, const char** str, const GLint* length)
+	{
+		Issue(true);
+		context_->ShaderSource(shader, count, str, length);
+	}
+
+	void GLStateCache::CompileShader(GLuint shader)
+	{
+		Issue(true);
+		context_->CompileShader(shader);
+	}
+
+	void GLStateCache::AttachShader(GLuint program, GLuint shader)
+	{
+		Issue(true);
+		context_->AttachShader(program, shader);
+	}
+
+	void GLStateCache::DeleteShader(GLuint shader)
+	{
+		Issue(true);
+		context_->DeleteShader(shader);
+	}
+
+	GLint GLStateCache::GetUniformLocation(GLuint program, const char* name)
+	{
+		Issue(true);
+		return context_->GetUniformLocation(program, name);
+	}
+
+	GLint GLStateCache::GetAttribLocation(GLuint program, const char* name)
+	{
+		Issue(true);
+		return context_->GetAttribLocation(program, name);
+	}
+
+	void GLStateCache::Uniform1i(GLint location, GLint x)
+	{
+		UniformValue value = { (GLfloat)x, 0 };
+		std::map<UniformKey, UniformValue>::iterator it = uniforms_.find(UniformKey(program_, location));
+		if (!Issue(it == uniforms_.end() || !(it->second == value)))
+			return;
+		uniforms_[UniformKey(program_, location)] = value;
+		context_->Uniform1i(location, x);
+	}
+
+	void GLStateCache::Uniform2f(GLint location, GLfloat x, GLfloat y)
+	{
+		UniformValue value = { x, y };
+		std::map<UniformKey, UniformValue>::iterator it = uniforms_.find(UniformKey(program_, location));
+		if (!Issue(it == uniforms_.end() || !(it->second == value)))
+			return;
+		uniforms_[UniformKey(program_, location)] = value;
+		context_->Uniform2f(location, x, y);
+	}
+
+	void GLStateCache::EnableVertexAttribArray(GLuint index)
+	{
+		if (!Issue(enabledAttribs_.insert(index).second))
+			return;
+		context_->EnableVertexAttribArray(index);
+	}
+
+	void GLStateCache::VertexAttribPointer(GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* ptr)
+	{
+		Issue(true);
+		context_->VertexAttribPointer(indx, size, type, normalized, stride, ptr);
+	}
+
+	void GLStateCache::ActiveTexture(GLenum texture)
+	{
+		if (!Issue(texture != activeTexture_))
+			return;
+		activeTexture_ = texture;
+		context_->ActiveTexture(texture);
+	}
+
+	GLuint* GLStateCache::TextureBinding(GLenum target)
+	{
+		GLuint unit = activeTexture_ - GL_TEXTURE0;
+		if (unit >= (GLuint)kCachedTextureUnits)
+			return NULL;
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return &textures_[unit][0];
+		case GL_TEXTURE_EXTERNAL_OES: return &textures_[unit][1];
+		case GL_TEXTURE_RECTANGLE_ARB: return &textures_[unit][2];
+		default: return NULL;
+		}
+	}
+
+	void GLStateCache::BindTexture(GLenum target, GLuint texture)
+	{
+		GLuint* binding = TextureBinding(target);
+		if (!Issue(!binding || *binding != texture))
+			return;
+		if (binding)
+			*binding = texture;
+		context_->BindTexture(target, texture);
+	}
+
+	void GLStateCache::DrawArrays(GLenum mode, GLint first, GLsizei count)
+	{
+		Issue(true);
+		stats_.draws++;
+		context_->DrawArrays(mode, first, count);
+	}
+}
\ No newline at end of file
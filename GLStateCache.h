@@ -0,0 +1,119 @@
+#pragma once
+#include "Platform.h"
+
+#include <map>
+#include <set>
+#include <utility>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Counts of the GL calls a GLStateCache passed on to its context and of those it skipped because they would not have changed anything.
+	/// </summary>
+	struct GLCallStats
+	{
+		GLCallStats() : issued(0), elided(0), draws(0), swaps(0) {}
+		int64_t issued;
+		int64_t elided;
+		int64_t draws;
+		int64_t swaps;
+	};
+
+	/// <summary>
+	/// GraphicsContext that remembers the GL state it has set and drops calls that would set it to what it already is.  Each call
+	/// through PPB_OpenGLES2 goes into the command buffer and is run out of process, so a paint that draws the same program, uniforms
+	/// and viewport as the last one costs only its Clear, BindTexture, DrawArrays and SwapBuffers.  All GL calls on the context must go
+	/// through the cache, or it will skip calls it should not.  Texture bindings are only trusted until the next SwapBuffers, because
+	/// the decoder owns the picture textures and may delete and reuse their names between paints.
+	/// </summary>
+	class GLStateCache : public GraphicsContext
+	{
+	public:
+		/// <summary>
+		/// Takes ownership of |context|.
+		/// </summary>
+		GLStateCache(GraphicsContext* context);
+		virtual ~GLStateCache();
+
+		/// <summary>
+		/// The wrapped context, for creating video decoders that share it.
+		/// </summary>
+		GraphicsContext* context() const { return context_; }
+		const GLCallStats& stats() const { return stats_; }
+
+		virtual int32_t ResizeBuffers(int32_t width, int32_t height);
+		virtual int32_t SwapBuffers(const PlatformCallback& callback);
+
+		virtual GLenum GetError();
+		virtual void ClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha);
+		virtual void Clear(GLbitfield mask);
+		virtual void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+		virtual void GenBuffers(GLsizei n, GLuint* buffers);
+		virtual void BindBuffer(GLenum target, GLuint buffer);
+		virtual void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+		virtual GLuint CreateProgram();
+		virtual void DeleteProgram(GLuint program);
+		virtual void LinkProgram(GLuint program);
+		virtual void UseProgram(GLuint program);
+		virtual GLuint CreateShader(GLenum type);
+		virtual void ShaderSource(GLuint shader, GLsizei count, const char** str, const GLint* length);
+		virtual void CompileShader(GLuint shader);
+		virtual void AttachShader(GLuint program, GLuint shader);
+		virtual void DeleteShader(GLuint shader);
+		virtual GLint GetUniformLocation(GLuint program, const char* name);
+		virtual GLint GetAttribLocation(GLuint program, const char* name);
+		virtual void Uniform1i(GLint location, GLint x);
+		virtual void Uniform2f(GLint location, GLfloat x, GLfloat y);
+		virtual void EnableVertexAttribArray(GLuint index);
+		virtual void VertexAttribPointer(GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* ptr);
+		virtual void ActiveTexture(GLenum texture);
+		virtual void BindTexture(GLenum target, GLuint texture);
+		virtual void DrawArrays(GLenum mode, GLint first, GLsizei count);
+
+	private:
+		/// <summary>
+		/// Counts a call as issued if |changed|, or as elided if not, and returns |changed|.
+		/// </summary>
+		bool Issue(bool changed);
+		/// <summary>
+		/// Forgets the uniform values of a program, whose uniforms are reset when it is linked and gone when it is deleted.
+		/// </summary>
+		void ForgetUniforms(GLuint program);
+		/// <summary>
+		/// Returns the slot in textures_ of |target| on the active texture unit, or NULL if bindings to it are not cached.
+		/// </summary>
+		GLuint* TextureBinding(GLenum target);
+
+		/// <summary>Texture units whose bindings are cached.  Binding on higher units goes straight through.</summary>
+		static const int kCachedTextureUnits = 8;
+		/// <summary>Texture targets a picture can have: GL_TEXTURE_2D, GL_TEXTURE_EXTERNAL_OES and GL_TEXTURE_RECTANGLE_ARB.</summary>
+		static const int kTextureTargets = 3;
+		/// <summary>A textures_ entry whose binding is not known.  Not a texture name glGenTextures returns.</summary>
+		static const GLuint kUnknownTexture = 0xFFFFFFFF;
+
+		/// <summary>
+		/// A uniform's value, as set by Uniform1i (in x) or Uniform2f.
+		/// </summary>
+		struct UniformValue
+		{
+			GLfloat x;
+			GLfloat y;
+			bool operator==(const UniformValue& other) const { return x == other.x && y == other.y; }
+		};
+		typedef std::pair<GLuint, GLint> UniformKey;
+
+		GraphicsContext* context_;
+		GLCallStats stats_;
+
+		GLuint program_;
+		GLenum activeTexture_;
+		bool haveClearColor_;
+		GLclampf clearColor_[4];
+		bool haveViewport_;
+		GLint viewport_[4];
+		std::map<GLenum, GLuint> buffers_;
+		// The texture bound to each target of each unit, or kUnknownTexture.  A fixed array, so forgetting them every SwapBuffers allocates nothing.
+		GLuint textures_[kCachedTextureUnits][kTextureTargets];
+		std::map<UniformKey, UniformValue> uniforms_;
+		std::set<GLuint> enabledAttribs_;
+	};
+}
\ No newline at end of file
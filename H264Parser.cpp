@@ -0,0 +1,259 @@
+#include "H264Parser.h"
+
+#include <string.h>
+
+namespace PnaclPlayer
+{
+	namespace
+	{
+		const uint64_t kLowBits = 0x0101010101010101ULL;
+		const uint64_t kHighBits = 0x8080808080808080ULL;
+
+		/// <summary>
+		/// True if any of the eight bytes of v is zero.  The classic SWAR test: subtracting one from each byte only borrows into the high bit of a byte that was zero (or already had it set, which ~v masks out).
+		/// </summary>
+		inline bool HasZeroByte(uint64_t v)
+		{
+			return ((v - kLowBits) & ~v & kHighBits) != 0;
+		}
+
+		/// <summary>
+		/// Reads an RBSP bit by bit straight out of a NAL unit, dropping emulation prevention bytes (00 00 03) as it goes.
+		/// </summary>
+		class BitReader
+		{
+		public:
+			BitReader(const uint8_t* data, size_t size) : data_(data), size_(size), position_(0), zeros_(0), byte_(0), bitsLeft_(0), overrun_(false) {}
+
+			/// <summary>True once a read went past the end of the data.  Values read after that are zero.</summary>
+			bool overrun() const { return overrun_; }
+
+			uint32_t ReadBit()
+			{
+				if (bitsLeft_ == 0 && !LoadByte())
+					return 0;
+				bitsLeft_--;
+				return (byte_ >> bitsLeft_) & 1;
+			}
+			uint32_t ReadBits(int count)
+			{
+				uint32_t value = 0;
+				for (int i = 0; i < count; i++)
+					value = (value << 1) | ReadBit();
+				return value;
+			}
+			/// <summary>ue(v): unsigned Exp-Golomb.</summary>
+			uint32_t ReadUe()
+			{
+				int leadingZeros = 0;
+				while (ReadBit() == 0)
+				{
+					if (overrun_ || ++leadingZeros > 31)
+					{
+						overrun_ = true;
+						return 0;
+					}
+				}
+				return ((1u << leadingZeros) - 1) + ReadBits(leadingZeros);
+			}
+			/// <summary>se(v): signed Exp-Golomb.</summary>
+			int32_t ReadSe()
+			{
+				uint32_t code = ReadUe();
+				return (code & 1) ? (int32_t)((code + 1) / 2) : -(int32_t)(code / 2);
+			}
+
+		private:
+			bool LoadByte()
+			{
+				if (position_ >= size_)
+				{
+					overrun_ = true;
+					return false;
+				}
+				uint8_t b = data_[position_++];
+				if (zeros_ >= 2 && b == 3)
+				{
+					zeros_ = 0;
+					if (position_ >= size_)
+					{
+						overrun_ = true;
+						return false;
+					}
+					b = data_[position_++];
+				}
+				zeros_ = b == 0 ? zeros_ + 1 : 0;
+				byte_ = b;
+				bitsLeft_ = 8;
+				return true;
+			}
+
+			const uint8_t* data_;
+			size_t size_;
+			size_t position_;
+			int zeros_;
+			uint8_t byte_;
+			int bitsLeft_;
+			bool overrun_;
+		};
+
+		void SkipScalingList(BitReader& reader, int size)
+		{
+			int32_t lastScale = 8;
+			int32_t nextScale = 8;
+			for (int j = 0; j < size; j++)
+			{
+				if (nextScale != 0)
+					nextScale = (lastScale + reader.ReadSe() + 256) % 256;
+				lastScale = nextScale == 0 ? lastScale : nextScale;
+			}
+		}
+
+		/// <summary>
+		/// Profiles whose SPS carries chroma format, bit depth and scaling matrix fields.
+		/// </summary>
+		bool HasChromaInfo(int32_t profile)
+		{
+			switch (profile)
+			{
+				case 100: case 110: case 122: case 244: case 44: case 83: case 86: case 118: case 128: case 138: case 139: case 134: case 135:
+					return true;
+				default:
+					return false;
+			}
+		}
+	}
+
+	const uint8_t* H264Parser::FindStartCode(const uint8_t* begin, const uint8_t* end)
+	{
+		const uint8_t* p = begin;
+		while (end - p >= 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, 8);
+			if (HasZeroByte(word))
+			{
+				// A start code can only begin at a zero byte, so only words containing one need a closer look.
+				for (int i = 0; i < 8; i++)
+				{
+					if (p[i] == 0 && end - (p + i) >= 3 && p[i + 1] == 0 && p[i + 2] == 1)
+						return p + i;
+				}
+			}
+			p += 8;
+		}
+		for (; end - p >= 3; p++)
+		{
+			if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+				return p;
+		}
+		return end;
+	}
+
+	bool H264Parser::ParseFrame(const uint8_t* data, size_t size, H264FrameInfo& info)
+	{
+		info = H264FrameInfo();
+		const uint8_t* end = data + size;
+		const uint8_t* startCode = FindStartCode(data, end);
+		if (startCode == end)
+			return false;
+		while (startCode != end)
+		{
+			const uint8_t* nal = startCode + 3;
+			if (nal == end)
+				break;
+			int32_t type = nal[0] & 0x1F;
+			info.nalTypes |= 1u << type;
+			if (type >= NAL_SLICE && type <= NAL_SLICE_IDR)
+			{
+				info.firstSliceType = type;
+				break;
+			}
+			const uint8_t* next = FindStartCode(nal, end);
+			if (type == NAL_SPS && !info.hasSps)
+				info.hasSps = ParseSps(nal, next - nal, info.sps);
+			startCode = next;
+		}
+		return true;
+	}
+
+	bool H264Parser::ParseSps(const uint8_t* nal, size_t size, H264SpsInfo& sps)
+	{
+		if (size < 4 || (nal[0] & 0x1F) != NAL_SPS)
+			return false;
+		BitReader reader(nal + 1, size - 1);
+		sps.profile = reader.ReadBits(8);
+		sps.constraints = reader.ReadBits(8);
+		sps.level = reader.ReadBits(8);
+		reader.ReadUe(); // seq_parameter_set_id
+
+		uint32_t chromaFormat = 1;
+		bool separateColourPlanes = false;
+		if (HasChromaInfo(sps.profile))
+		{
+			chromaFormat = reader.ReadUe();
+			if (chromaFormat == 3)
+				separateColourPlanes = reader.ReadBit() != 0;
+			reader.ReadUe(); // bit_depth_luma_minus8
+			reader.ReadUe(); // bit_depth_chroma_minus8
+			reader.ReadBit(); // qpprime_y_zero_transform_bypass_flag
+			if (reader.ReadBit()) // seq_scaling_matrix_present_flag
+			{
+				int lists = chromaFormat != 3 ? 8 : 12;
+				for (int i = 0; i < lists && !reader.overrun(); i++)
+				{
+					if (reader.ReadBit())
+						SkipScalingList(reader, i < 6 ? 16 : 64);
+				}
+			}
+		}
+
+		reader.ReadUe(); // log2_max_frame_num_minus4
+		uint32_t pocType = reader.ReadUe();
+		if (pocType == 0)
+			reader.ReadUe(); // log2_max_pic_order_cnt_lsb_minus4
+		else if (pocType == 1)
+		{
+			reader.ReadBit(); // delta_pic_order_always_zero_flag
+			reader.ReadSe(); // offset_for_non_ref_pic
+			reader.ReadSe(); // offset_for_top_to_bottom_field
+			uint32_t cycle = reader.ReadUe();
+			for (uint32_t i = 0; i < cycle && !reader.overrun(); i++)
+				reader.ReadSe(); // offset_for_ref_frame
+		}
+		reader.ReadUe(); // max_num_ref_frames
+		reader.ReadBit(); // gaps_in_frame_num_value_allowed_flag
+		uint32_t widthInMbs = reader.ReadUe() + 1;
+		uint32_t heightInMapUnits = reader.ReadUe() + 1;
+		uint32_t frameMbsOnly = reader.ReadBit();
+		if (!frameMbsOnly)
+			reader.ReadBit(); // mb_adaptive_frame_field_flag
+		reader.ReadBit(); // direct_8x8_inference_flag
+		uint32_t cropLeft = 0, cropRight = 0, cropTop = 0, cropBottom = 0;
+		if (reader.ReadBit()) // frame_cropping_flag
+		{
+			cropLeft = reader.ReadUe();
+			cropRight = reader.ReadUe();
+			cropTop = reader.ReadUe();
+			cropBottom = reader.ReadUe();
+		}
+		if (reader.overrun() || chromaFormat > 3)
+			return false;
+
+		// Crop offsets are in chroma sample units (section 7.4.2.1.1).
+		uint32_t cropUnitX = 1;
+		uint32_t cropUnitY = 2 - frameMbsOnly;
+		if (chromaFormat != 0 && !separateColourPlanes)
+		{
+			cropUnitX = chromaFormat == 3 ? 1 : 2;
+			cropUnitY *= chromaFormat == 1 ? 2 : 1;
+		}
+		int64_t width = (int64_t)widthInMbs * 16 - (int64_t)cropUnitX * (cropLeft + cropRight);
+		int64_t height = (int64_t)(2 - frameMbsOnly) * heightInMapUnits * 16 - (int64_t)cropUnitY * (cropTop + cropBottom);
+		if (width <= 0 || height <= 0 || width > 16384 || height > 16384)
+			return false;
+		sps.width = (int32_t)width;
+		sps.height = (int32_t)height;
+		return true;
+	}
+}
\ No newline at end of file
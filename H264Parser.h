@@ -0,0 +1,73 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// The nal_unit_type values the player cares about (ITU-T H.264 table 7-1).
+	/// </summary>
+	enum NalUnitType
+	{
+		NAL_SLICE = 1,
+		NAL_SLICE_IDR = 5,
+		NAL_SEI = 6,
+		NAL_SPS = 7,
+		NAL_PPS = 8,
+		NAL_AUD = 9
+	};
+
+	/// <summary>
+	/// Fields of a sequence parameter set.  width and height are the displayed size, after frame cropping.
+	/// </summary>
+	struct H264SpsInfo
+	{
+		H264SpsInfo() : profile(0), constraints(0), level(0), width(0), height(0) {}
+		int32_t profile;
+		int32_t constraints;
+		int32_t level;
+		int32_t width;
+		int32_t height;
+	};
+
+	/// <summary>
+	/// What an access unit contains, as far as the start of its first slice.
+	/// </summary>
+	struct H264FrameInfo
+	{
+		H264FrameInfo() : nalTypes(0), firstSliceType(0), hasSps(false) {}
+		/// <summary>Bit n is set if a NAL unit of type n was seen.</summary>
+		uint32_t nalTypes;
+		/// <summary>NAL_SLICE_IDR, NAL_SLICE or another VCL type, or 0 if the frame holds no slice.</summary>
+		int32_t firstSliceType;
+		/// <summary>True if the frame carried an SPS that parsed successfully; sps is only valid if this is set.</summary>
+		bool hasSps;
+		H264SpsInfo sps;
+
+		bool idr() const { return firstSliceType == NAL_SLICE_IDR; }
+		bool has(NalUnitType type) const { return (nalTypes & (1u << type)) != 0; }
+	};
+
+	/// <summary>
+	/// Annex-B byte stream scanning and just enough H.264 header parsing to classify frames.
+	/// </summary>
+	class H264Parser
+	{
+	public:
+		/// <summary>
+		/// Returns a pointer to the first 00 00 01 start code prefix in [begin, end), or end if there is none.  Scans eight bytes
+		/// at a time, so stretches of non-zero bytes (nearly all slice data) are skipped cheaply.
+		/// </summary>
+		static const uint8_t* FindStartCode(const uint8_t* begin, const uint8_t* end);
+
+		/// <summary>
+		/// Classifies an access unit.  Stops at the first slice NAL unit, since parameter sets and SEI precede it, so the cost
+		/// does not depend on the size of the slice data.  Returns false if the buffer holds no start code.
+		/// </summary>
+		static bool ParseFrame(const uint8_t* data, size_t size, H264FrameInfo& info);
+
+		/// <summary>
+		/// Parses an SPS NAL unit, starting at its one byte NAL header.  Returns false if it is truncated or unsupported.
+		/// </summary>
+		static bool ParseSps(const uint8_t* nal, size_t size, H264SpsInfo& sps);
+	};
+}
\ No newline at end of file
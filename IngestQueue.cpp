@@ -0,0 +1,127 @@
+#include "IngestQueue.h"
+#include "FramedMessage.h"
+
+#include <stdlib.h>
+
+#include <thread>
+
+namespace PnaclPlayer
+{
+	const size_t IngestQueue::kCapacity;
+	const size_t IngestQueue::kDrainBatch;
+
+	IngestQueue::IngestQueue(Platform* platform, const Consumer& consumer) : platform_(platform), consumer_(consumer), threaded_(false), queue_(kCapacity), drainScheduled_(false), nextFrameTimestamp_(0), nextFrameStream_(0), nextFrameGeneration_(0), alive_(new bool(true))
+	{
+	}
+
+	IngestQueue::~IngestQueue()
+	{
+	}
+
+	void IngestQueue::HandleMessage(const std::string& message)
+	{
+		if (message.find("f ") == 0)
+		{
+			// "f <timestamp> [streamId] [generation]" announces the next ArrayBuffer.
+			const char* args = message.c_str() + 2;
+			char* end = NULL;
+			nextFrameTimestamp_ = (int64_t)strtoll(args, &end, 10);
+			nextFrameStream_ = (int32_t)strtol(end, &end, 10);
+			nextFrameGeneration_ = (uint8_t)strtol(end, NULL, 10);
+			return;
+		}
+		IngestItem item;
+		item.type = INGEST_MESSAGE;
+		item.text = message;
+		Push(item);
+	}
+
+	void IngestQueue::HandleMessage(const ByteBufferPtr& buffer)
+	{
+		int64_t received = FrameLatencyStats::Now(platform_);
+		IngestItem item;
+		if (FramedMessageReader::IsFramed(*buffer))
+		{
+			FramedMessageReader reader(buffer);
+			// Validate the whole message first so a truncated message is rejected as a unit rather than delivering some of its frames.
+			if (reader.Validate() < 0)
+			{
+				item.type = INGEST_ERROR;
+				item.text = "invalid framed message";
+				Push(item);
+				return;
+			}
+			while (reader.Next(item.frame, item.stream))
+			{
+				item.frame.stages.received = received;
+				Push(item);
+			}
+		}
+		else
+		{
+			item.frame = EncodedFrame(buffer, 0, buffer->ByteLength(), nextFrameTimestamp_, (uint32_t)nextFrameGeneration_ << ENCODED_FRAME_GENERATION_SHIFT);
+			item.frame.stages.received = received;
+			item.stream = nextFrameStream_;
+			Push(item);
+		}
+		if (!threaded_)
+			Drain(kCapacity);
+	}
+
+	void IngestQueue::Push(IngestItem& item)
+	{
+		while (!queue_.TryPush(item))
+		{
+			if (threaded_)
+				std::this_thread::yield(); // The main thread is behind.  Waiting here holds up the browser's messages, not painting.
+			else
+				Drain(kCapacity);
+		}
+		if (threaded_)
+			ScheduleDrain();
+		else if (item.type != INGEST_FRAME)
+			Drain(kCapacity);
+	}
+
+	bool IngestQueue::Drain(size_t maxItems)
+	{
+		IngestItem item;
+		for (size_t i = 0; i < maxItems; i++)
+		{
+			if (!queue_.TryPop(item))
+				return false;
+			consumer_(item);
+		}
+		return !queue_.empty();
+	}
+
+	void IngestQueue::ScheduleDrain()
+	{
+		if (!drainScheduled_.exchange(true))
+			PostDrainTask();
+	}
+
+	void IngestQueue::PostDrainTask()
+	{
+		std::weak_ptr<bool> alive(alive_);
+		platform_->CallOnMainThread(0, [this, alive](int32_t result)
+		{
+			if (!alive.expired())
+				DrainTask(result);
+		}, 0);
+	}
+
+	void IngestQueue::DrainTask(int32_t result)
+	{
+		if (Drain(kDrainBatch))
+		{
+			// More to do.  Go to the back of the main thread's queue so callbacks that came due meanwhile run first.
+			PostDrainTask();
+			return;
+		}
+		drainScheduled_.store(false);
+		// The producer may have pushed after the last pop but before the flag was cleared, and skipped scheduling a drain.
+		if (!queue_.empty())
+			ScheduleDrain();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+#include "Platform.h"
+#include "EncodedFrame.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace PnaclPlayer
+{
+	enum IngestItemType
+	{
+		/// <summary>A frame to pass to the decoder of its stream.</summary>
+		INGEST_FRAME,
+		/// <summary>A string message from the browser, to be handled on the main thread in order with the frames around it.</summary>
+		INGEST_MESSAGE,
+		/// <summary>A malformed message.  The text is posted to the browser.</summary>
+		INGEST_ERROR
+	};
+
+	struct IngestItem
+	{
+		IngestItem() : type(INGEST_FRAME), stream(0) {}
+		IngestItemType type;
+		int32_t stream;
+		EncodedFrame frame;
+		std::string text;
+	};
+
+	/// <summary>
+	/// Turns the messages the browser sends into frames for the decoders.  The producer side (HandleMessage) splits framed
+	/// messages, pairs ArrayBuffers with their "f" announcements, and hands the results to the consumer callback, in order,
+	/// through a lock-free SpscQueue.
+	///
+	/// By default both sides run on the main thread and every message is consumed before HandleMessage returns.  In threaded
+	/// mode HandleMessage is called on an ingest thread instead, and the queue is drained on the main thread a few items per
+	/// task, so a burst of incoming frames is interleaved with paint callbacks rather than delaying them.
+	/// </summary>
+	class IngestQueue
+	{
+	public:
+		typedef std::function<void(IngestItem& item)> Consumer;
+
+		IngestQueue(Platform* platform, const Consumer& consumer);
+		~IngestQueue();
+
+		/// <summary>
+		/// Switches threaded mode on or off.  Call before the first message.
+		/// </summary>
+		void SetThreaded(bool threaded) { threaded_ = threaded; }
+		bool threaded() const { return threaded_; }
+
+		/// <summary>
+		/// Producer.  Records an "f &lt;timestamp&gt; [streamId] [generation]" announcement for the next ArrayBuffer, or passes any other message through to the consumer.
+		/// </summary>
+		void HandleMessage(const std::string& message);
+		/// <summary>
+		/// Producer.  Passes the frames in a framed message, or a single frame announced by the last "f" message, to the consumer.
+		/// </summary>
+		void HandleMessage(const ByteBufferPtr& buffer);
+
+	private:
+		/// <summary>
+		/// Items queued before the producer has to wait for the main thread.  Generous, since each item is small and the frames themselves are not copied.
+		/// </summary>
+		static const size_t kCapacity = 1024;
+		/// <summary>
+		/// Items consumed per main-thread task in threaded mode.  Bounds how long a burst can hold up a paint callback.
+		/// </summary>
+		static const size_t kDrainBatch = 8;
+
+		void Push(IngestItem& item);
+		/// <summary>
+		/// Consumes up to maxItems items.  Returns false if the queue is empty.
+		/// </summary>
+		bool Drain(size_t maxItems);
+		void ScheduleDrain();
+		void PostDrainTask();
+		void DrainTask(int32_t result);
+
+		Platform* platform_;
+		Consumer consumer_;
+		bool threaded_;
+		SpscQueue<IngestItem> queue_;
+		// Set while a DrainTask is queued on the main thread, so the producer posts at most one at a time.
+		std::atomic<bool> drainScheduled_;
+		// Producer state: the announcement for the next ArrayBuffer.
+		int64_t nextFrameTimestamp_;
+		int32_t nextFrameStream_;
+		uint8_t nextFrameGeneration_;
+		// Pending DrainTask callbacks hold a weak reference to this, so they do nothing once the queue is deleted.
+		std::shared_ptr<bool> alive_;
+	};
+}
\ No newline at end of file
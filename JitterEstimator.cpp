@@ -0,0 +1,84 @@
+#include "JitterEstimator.h"
+
+#include <math.h>
+
+namespace PnaclPlayer
+{
+	// Indexed by JitterBufferMode.  The fixed mode's depth does not change, but its delay steers the playback clock.
+	const JitterEstimator::Profile JitterEstimator::kProfiles[] = {
+		{ kFixedDepth, kFixedDepth, 2, 1 },
+		{ 1, 4, 2, 1 },
+		{ 3, 24, 4, 0.005 }
+	};
+
+	/// <summary>
+	/// Timestamp or arrival gaps beyond this are a stream discontinuity (a seek, a camera reconnect, a stalled tab), not jitter.
+	/// </summary>
+	static const int64_t kDiscontinuityMs = 2000;
+	/// <summary>
+	/// Gain of the jitter and frame interval filters; 1/16 as in RFC 3550.
+	/// </summary>
+	static const double kFilterGain = 1.0 / 16;
+
+	JitterEstimator::JitterEstimator() : mode_(JITTER_BUFFER_FIXED)
+	{
+		Reset();
+	}
+
+	void JitterEstimator::SetMode(JitterBufferMode mode)
+	{
+		mode_ = mode;
+		UpdateTargetDepth();
+	}
+
+	void JitterEstimator::Reset()
+	{
+		haveLast_ = false;
+		lastArrival_ = 0;
+		lastTimestamp_ = 0;
+		frameInterval_ = 0;
+		jitter_ = 0;
+		heldDelay_ = 0;
+		UpdateTargetDepth();
+	}
+
+	void JitterEstimator::AddArrival(int64_t arrivalMs, int64_t timestamp)
+	{
+		if (haveLast_)
+		{
+			int64_t timestampDelta = timestamp - lastTimestamp_;
+			int64_t arrivalDelta = arrivalMs - lastArrival_;
+			// Frames arriving out of order (timestampDelta <= 0) say nothing about the frame rate, but their arrival deviation is still jitter.
+			if (timestampDelta > 0 && timestampDelta < kDiscontinuityMs)
+				frameInterval_ = frameInterval_ == 0 ? timestampDelta : frameInterval_ + (timestampDelta - frameInterval_) * kFilterGain;
+			int64_t deviation = arrivalDelta - timestampDelta;
+			if (deviation < 0)
+				deviation = -deviation;
+			if (deviation < kDiscontinuityMs)
+				jitter_ += (deviation - jitter_) * kFilterGain;
+		}
+		haveLast_ = true;
+		lastArrival_ = arrivalMs;
+		lastTimestamp_ = timestamp;
+
+		const Profile& profile = kProfiles[mode_];
+		double delay = jitter_ * profile.jitterMultiplier;
+		double decayed = heldDelay_ * (1 - profile.decayPerFrame);
+		heldDelay_ = delay > decayed ? delay : decayed;
+		UpdateTargetDepth();
+	}
+
+	void JitterEstimator::UpdateTargetDepth()
+	{
+		const Profile& profile = kProfiles[mode_];
+		int32_t depth = profile.minDepth;
+		if (mode_ != JITTER_BUFFER_FIXED && frameInterval_ > 0)
+		{
+			// Enough queued frames to cover the delay.
+			double frames = ceil(heldDelay_ / frameInterval_);
+			if (frames > depth)
+				depth = frames > profile.maxDepth ? profile.maxDepth : (int32_t)frames;
+		}
+		targetDepth_ = depth;
+	}
+}
\ No newline at end of file
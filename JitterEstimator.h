@@ -0,0 +1,76 @@
+#pragma once
+#include <stdint.h>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// How RenderScheduler sizes its queue of decoded frames.
+	/// </summary>
+	enum JitterBufferMode
+	{
+		/// <summary>Always queue up to 2 frames.  The original behavior.</summary>
+		JITTER_BUFFER_FIXED,
+		/// <summary>Follow the measured jitter closely and keep the queue as short as it allows.  For live view and PTZ control, where latency matters more than smoothness.</summary>
+		JITTER_BUFFER_LOW_LATENCY,
+		/// <summary>Size the queue for the worst recent jitter and shrink it only slowly.  For recorded playback, where latency does not matter.</summary>
+		JITTER_BUFFER_SMOOTH
+	};
+
+	/// <summary>
+	/// Estimates the jitter of frame arrivals relative to their timestamps (the interarrival jitter of RFC 3550) and turns it
+	/// into a target number of queued frames.
+	/// </summary>
+	class JitterEstimator
+	{
+	public:
+		JitterEstimator();
+		~JitterEstimator() {}
+
+		void SetMode(JitterBufferMode mode);
+		JitterBufferMode mode() const { return mode_; }
+		/// <summary>
+		/// Forgets the stream's history, for a new stream.  Keeps the mode.
+		/// </summary>
+		void Reset();
+
+		/// <summary>
+		/// Records that the frame with the given timestamp arrived at the given time, both in milliseconds.
+		/// </summary>
+		void AddArrival(int64_t arrivalMs, int64_t timestamp);
+
+		/// <summary>Smoothed absolute deviation of arrival intervals from timestamp intervals, in milliseconds.</summary>
+		double jitterMs() const { return jitter_; }
+		/// <summary>Smoothed interval between frame timestamps, in milliseconds.  0 until two frames have arrived.</summary>
+		double frameIntervalMs() const { return frameInterval_; }
+		/// <summary>The number of frames the scheduler should let queue up before it jumps its clock ahead.</summary>
+		int32_t targetDepth() const { return targetDepth_; }
+		/// <summary>
+		/// How long, in milliseconds, a frame should wait between arriving and being due: the delay that covers the jitter.  The
+		/// scheduler's playback clock is steered to keep it.
+		/// </summary>
+		double targetDelayMs() const { return heldDelay_; }
+
+	private:
+		struct Profile
+		{
+			int32_t minDepth;
+			int32_t maxDepth;
+			/// <summary>Milliseconds of buffering per millisecond of jitter.</summary>
+			double jitterMultiplier;
+			/// <summary>Fraction of the buffered delay given up per frame once the jitter falls.  1 follows the jitter immediately.</summary>
+			double decayPerFrame;
+		};
+		static const Profile kProfiles[];
+		static const int32_t kFixedDepth = 2;
+
+		void UpdateTargetDepth();
+
+		JitterBufferMode mode_;
+		bool haveLast_;
+		int64_t lastArrival_;
+		int64_t lastTimestamp_;
+		double frameInterval_;
+		double jitter_;
+		double heldDelay_;
+		int32_t targetDepth_;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "LatencyHistogram.h"
+
+#include "pnacl_player_assert.h"
+#include <string.h>
+#include <sstream>
+
+namespace PnaclPlayer
+{
+	LatencyHistogram::LatencyHistogram()
+	{
+		Clear();
+	}
+
+	LatencyHistogram::~LatencyHistogram()
+	{
+	}
+
+	int64_t LatencyHistogram::BucketHighestValue(size_t index)
+	{
+		if (index < 2 * kSubBucketHalf)
+			return (int64_t)index;
+		// Inverse of BucketIndex: index = shift * half + (value >> shift), where value >> shift is in [half, 2 * half).
+		int shift = (int)(index / kSubBucketHalf) - 1;
+		int64_t subBucket = (int64_t)(index % kSubBucketHalf) + kSubBucketHalf;
+		return ((subBucket + 1) << shift) - 1;
+	}
+
+	int64_t LatencyHistogram::Percentile(double percentile) const
+	{
+		if (count_ == 0)
+			return 0;
+		int64_t rank = (int64_t)(percentile / 100 * count_ + 0.5);
+		if (rank < 1)
+			rank = 1;
+		if (rank > count_)
+			rank = count_;
+		int64_t seen = 0;
+		for (size_t i = 0; i < kBucketCount; i++)
+		{
+			seen += counts_[i];
+			if (seen >= rank)
+			{
+				int64_t value = BucketHighestValue(i);
+				return value < max_ ? value : max_;
+			}
+		}
+		assert(false);
+		return max_;
+	}
+
+	void LatencyHistogram::Clear()
+	{
+		memset(counts_, 0, sizeof(counts_));
+		count_ = 0;
+		sum_ = 0;
+		min_ = kMaxValue;
+		max_ = 0;
+	}
+
+	void LatencyHistogram::AppendJson(std::string& out) const
+	{
+		std::stringstream sstm;
+		sstm << "{\"n\":" << count_
+			<< ",\"mean\":" << mean()
+			<< ",\"p50\":" << Percentile(50)
+			<< ",\"p90\":" << Percentile(90)
+			<< ",\"p99\":" << Percentile(99)
+			<< ",\"p999\":" << Percentile(99.9)
+			<< ",\"max\":" << max()
+			<< "}";
+		out += sstm.str();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Counts durations in microseconds in logarithmic buckets, like HdrHistogram: every power of two is split into 32 linear
+	/// sub-buckets, so any value is placed within about 3% of itself.  The buckets are a fixed array covering 0 to 2^32 us
+	/// (larger values are counted as 2^32 - 1), so recording is a bit scan and an increment and never allocates.
+	/// </summary>
+	class LatencyHistogram
+	{
+	public:
+		LatencyHistogram();
+		~LatencyHistogram();
+
+		/// <summary>
+		/// Counts one duration.  Negative durations are counted as 0.
+		/// </summary>
+		void Record(int64_t valueUs)
+		{
+			if (valueUs < 0)
+				valueUs = 0;
+			else if (valueUs > kMaxValue)
+				valueUs = kMaxValue;
+			counts_[BucketIndex((uint32_t)valueUs)]++;
+			count_++;
+			sum_ += valueUs;
+			if (valueUs < min_)
+				min_ = valueUs;
+			if (valueUs > max_)
+				max_ = valueUs;
+		}
+		/// <summary>
+		/// Returns the value at the given percentile (0-100), as the highest value of its bucket but no more than the largest value recorded.  Returns 0 if nothing was recorded.
+		/// </summary>
+		int64_t Percentile(double percentile) const;
+		void Clear();
+
+		int64_t count() const { return count_; }
+		int64_t min() const { return count_ ? min_ : 0; }
+		int64_t max() const { return max_; }
+		int64_t mean() const { return count_ ? sum_ / count_ : 0; }
+
+		/// <summary>
+		/// Appends {"n":..,"mean":..,"p50":..,"p90":..,"p99":..,"p999":..,"max":..} in microseconds.
+		/// </summary>
+		void AppendJson(std::string& out) const;
+
+	private:
+		static const int kSubBucketBits = 6;
+		static const uint32_t kSubBucketHalf = 1 << (kSubBucketBits - 1);
+		static const int64_t kMaxValue = 0xFFFFFFFF;
+		static const size_t kBucketCount = (32 - kSubBucketBits) * kSubBucketHalf + 2 * kSubBucketHalf;
+
+		static size_t BucketIndex(uint32_t value)
+		{
+			if (value < 2 * kSubBucketHalf)
+				return value;
+			int shift = HighestBit(value) - kSubBucketBits + 1;
+			return (size_t)shift * kSubBucketHalf + (value >> shift);
+		}
+		static int64_t BucketHighestValue(size_t index);
+		static int HighestBit(uint32_t value)
+		{
+#ifdef _MSC_VER
+			unsigned long bit;
+			_BitScanReverse(&bit, value);
+			return (int)bit;
+#else
+			return 31 - __builtin_clz(value);
+#endif
+		}
+
+		uint32_t counts_[kBucketCount];
+		int64_t count_;
+		int64_t sum_;
+		int64_t min_;
+		int64_t max_;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "MessageTrace.h"
+
+#include "pnacl_player_assert.h"
+#include <string.h>
+
+namespace PnaclPlayer
+{
+	static const char kMessageTraceMagic[] = "pnt1";
+
+	const uint32_t MessageTraceWriter::kHeaderSize;
+	const uint32_t MessageTraceWriter::kVersion;
+
+	MessageTraceWriter::MessageTraceWriter() : recording_(false), start_(0), maxBytes_(0)
+	{
+	}
+
+	MessageTraceWriter::~MessageTraceWriter()
+	{
+	}
+
+	void MessageTraceWriter::Start(int64_t now, size_t maxBytes)
+	{
+		trace_.reset(new std::vector<uint8_t>(kHeaderSize));
+		memcpy(&(*trace_)[0], kMessageTraceMagic, 4);
+		memcpy(&(*trace_)[4], &kVersion, 4);
+		recording_ = true;
+		start_ = now;
+		maxBytes_ = maxBytes;
+		stats_ = MessageTraceStats();
+		stats_.bytes = kHeaderSize;
+	}
+
+	std::shared_ptr<std::vector<uint8_t>> MessageTraceWriter::Stop()
+	{
+		if (!recording_)
+			return std::shared_ptr<std::vector<uint8_t>>();
+		recording_ = false;
+		std::shared_ptr<std::vector<uint8_t>> trace = trace_;
+		trace_.reset();
+		return trace;
+	}
+
+	void MessageTraceWriter::Append(int64_t now, MessageTraceType type, const void* payload, uint32_t length)
+	{
+		assert(recording_);
+		size_t padded = ((size_t)length + 7) & ~(size_t)7;
+		size_t position = trace_->size();
+		if (position + sizeof(MessageTraceRecord) + padded > maxBytes_)
+		{
+			stats_.dropped++;
+			return;
+		}
+		MessageTraceRecord record;
+		record.arrival = now - start_;
+		record.length = length;
+		record.type = (uint16_t)type;
+		record.reserved = 0;
+		trace_->resize(position + sizeof(MessageTraceRecord) + padded); // Zero-fills the padding.
+		memcpy(&(*trace_)[position], &record, sizeof(record));
+		if (length)
+			memcpy(&(*trace_)[position + sizeof(record)], payload, length);
+		stats_.messages++;
+		stats_.bytes = (int64_t)trace_->size();
+	}
+
+	MessageTraceReader::MessageTraceReader(const void* data, size_t size) : data_((const uint8_t*)data), size_(size), position_(MessageTraceWriter::kHeaderSize)
+	{
+	}
+
+	int64_t MessageTraceReader::Validate() const
+	{
+		if (size_ < MessageTraceWriter::kHeaderSize || memcmp(data_, kMessageTraceMagic, 4) != 0)
+			return -1;
+		uint32_t version;
+		memcpy(&version, data_ + 4, 4);
+		if (version != MessageTraceWriter::kVersion)
+			return -1;
+		int64_t count = 0;
+		size_t position = MessageTraceWriter::kHeaderSize;
+		while (position < size_)
+		{
+			if (size_ - position < sizeof(MessageTraceRecord))
+				return -1;
+			MessageTraceRecord record;
+			memcpy(&record, data_ + position, sizeof(record));
+			position += sizeof(record);
+			if ((record.type != TRACE_STRING && record.type != TRACE_BINARY) || Padded(record.length) > size_ - position)
+				return -1;
+			position += Padded(record.length);
+			count++;
+		}
+		return count;
+	}
+
+	bool MessageTraceReader::Next(MessageTraceRecord& record, const uint8_t*& payload)
+	{
+		if (position_ >= size_)
+			return false;
+		memcpy(&record, data_ + position_, sizeof(record));
+		payload = data_ + position_ + sizeof(record);
+		position_ += sizeof(record) + Padded(record.length);
+		return true;
+	}
+}
\ No newline at end of file
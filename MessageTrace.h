@@ -0,0 +1,122 @@
+#pragma once
+#include "Platform.h"
+#include <memory>
+#include <string>
+#include <vector>
+namespace PnaclPlayer
+{
+	enum MessageTraceType
+	{
+		/// <summary>A string message.  The payload is its bytes, without a terminator.</summary>
+		TRACE_STRING = 1,
+		/// <summary>An ArrayBuffer message.  The payload is its bytes.</summary>
+		TRACE_BINARY = 2
+	};
+
+	/// <summary>
+	/// Written before each message in a trace.  Records start on 8 byte boundaries, so a trace file can be memory-mapped and read in place.
+	/// </summary>
+	struct MessageTraceRecord
+	{
+		/// <summary>Microseconds from the start of the recording to the message's arrival.</summary>
+		int64_t arrival;
+		/// <summary>Number of payload bytes that follow the record.  The payload is then padded with zeros to a multiple of 8 bytes.</summary>
+		uint32_t length;
+		/// <summary>A MessageTraceType.</summary>
+		uint16_t type;
+		uint16_t reserved;
+	};
+
+	/// <summary>
+	/// Counters for a recording.
+	/// </summary>
+	struct MessageTraceStats
+	{
+		MessageTraceStats() : messages(0), bytes(0), dropped(0) {}
+		int64_t messages;
+		/// <summary>Size of the trace, including headers and padding.</summary>
+		int64_t bytes;
+		/// <summary>Messages that arrived after the trace reached its size limit.</summary>
+		int64_t dropped;
+	};
+
+	/// <summary>
+	/// Records the messages the page sends, with their arrival times, so a session can be replayed offline.  A trace is the 8 byte
+	/// header "pnt1" and a uint32 version (1), followed by a MessageTraceRecord and payload for each message.  All fields are little-endian.
+	/// The trace is built in memory, up to a size limit, and handed over as a whole when the recording stops.
+	/// </summary>
+	class MessageTraceWriter
+	{
+	public:
+		static const uint32_t kHeaderSize = 8;
+		static const uint32_t kVersion = 1;
+
+		MessageTraceWriter();
+		~MessageTraceWriter();
+
+		/// <summary>
+		/// Starts a new recording, discarding any unfinished one.  Messages that would take the trace past maxBytes are dropped.
+		/// </summary>
+		void Start(int64_t now, size_t maxBytes);
+		/// <summary>
+		/// Ends the recording and returns the trace.  Returns NULL if nothing was being recorded.
+		/// </summary>
+		std::shared_ptr<std::vector<uint8_t>> Stop();
+
+		/// <summary>
+		/// Adds a message that arrived at the given time, in microseconds on the clock passed to Start.  Does nothing unless recording.
+		/// </summary>
+		void Record(int64_t now, const std::string& message)
+		{
+			if (recording_)
+				Append(now, TRACE_STRING, message.data(), (uint32_t)message.size());
+		}
+		void Record(int64_t now, ByteBuffer& buffer)
+		{
+			if (recording_)
+				Append(now, TRACE_BINARY, buffer.Map(), buffer.ByteLength());
+		}
+
+		bool recording() const { return recording_; }
+		const MessageTraceStats& stats() const { return stats_; }
+
+	private:
+		void Append(int64_t now, MessageTraceType type, const void* payload, uint32_t length);
+
+		bool recording_;
+		int64_t start_;
+		size_t maxBytes_;
+		std::shared_ptr<std::vector<uint8_t>> trace_;
+		MessageTraceStats stats_;
+	};
+
+	/// <summary>
+	/// Reads the messages in a trace written by MessageTraceWriter.  The payloads point into the trace; nothing is copied.
+	/// </summary>
+	class MessageTraceReader
+	{
+	public:
+		MessageTraceReader(const void* data, size_t size);
+		~MessageTraceReader() {}
+
+		/// <summary>
+		/// Checks the header, and that every record and payload lies within the trace.  Returns the number of messages, or -1 if the trace is malformed.
+		/// </summary>
+		int64_t Validate() const;
+		/// <summary>
+		/// Reads the next message.  Returns false at the end of the trace.  Call Validate first; a malformed trace is not detected here.
+		/// </summary>
+		bool Next(MessageTraceRecord& record, const uint8_t*& payload);
+		/// <summary>
+		/// Goes back to the first message.
+		/// </summary>
+		void Rewind() { position_ = MessageTraceWriter::kHeaderSize; }
+
+	private:
+		static size_t Padded(uint32_t length) { return ((size_t)length + 7) & ~(size_t)7; }
+
+		const uint8_t* data_;
+		size_t size_;
+		size_t position_;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <GLES2/gl2.h>
+
+// The player logic (pnacl_player, Decoder, RenderScheduler) talks to the outside world only through the interfaces in this file.
+// PpapiPlatform implements them on top of PPAPI for the real plugin, and host/HostPlatform implements them with in-process fakes
+// so the same logic can be built, profiled and benchmarked natively without Chrome or the NaCl SDK.
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Result codes passed to platform callbacks.  The values are identical to the PPAPI result codes of the same name, so the PPAPI backend can pass results through unchanged.
+	/// </summary>
+	enum PlatformResult
+	{
+		PLATFORM_OK = 0,
+		PLATFORM_OK_COMPLETIONPENDING = -1,
+		PLATFORM_ERROR_FAILED = -2,
+		PLATFORM_ERROR_ABORTED = -3,
+		PLATFORM_ERROR_BADARGUMENT = -4,
+		PLATFORM_ERROR_NOMEMORY = -8,
+		PLATFORM_ERROR_NOTSUPPORTED = -12,
+		PLATFORM_ERROR_RESOURCE_FAILED = -15,
+		PLATFORM_ERROR_CONTEXT_LOST = -50
+	};
+
+	/// <summary>
+	/// Hardware acceleration preference for the video decoder.  The values match the "hwaccel" startup argument.
+	/// </summary>
+	enum HardwareAcceleration
+	{
+		HWACCEL_NONE = 0,
+		HWACCEL_WITHFALLBACK = 1,
+		HWACCEL_ONLY = 2
+	};
+
+	struct PictureSize
+	{
+		int32_t width;
+		int32_t height;
+	};
+
+	struct PictureRect
+	{
+		int32_t x;
+		int32_t y;
+		int32_t width;
+		int32_t height;
+	};
+
+	/// <summary>
+	/// A decoded picture owned by the video decoder.  Mirrors PP_VideoPicture.  Must be handed back via VideoDecoderBackend::RecyclePicture when no longer needed.
+	/// </summary>
+	struct VideoPicture
+	{
+		uint32_t decode_id;
+		uint32_t texture_id;
+		uint32_t texture_target;
+		PictureSize texture_size;
+		PictureRect visible_rect;
+	};
+
+	typedef std::function<void(int32_t result)> PlatformCallback;
+	typedef std::function<void(int32_t result, const VideoPicture& picture)> PictureCallback;
+
+	/// <summary>
+	/// A read-only block of bytes received from the browser (an ArrayBuffer in the PPAPI backend).  The storage stays valid for as long as the object exists.
+	/// </summary>
+	class ByteBuffer
+	{
+	public:
+		virtual ~ByteBuffer() {}
+		virtual uint32_t ByteLength() = 0;
+		virtual void* Map() = 0;
+	};
+	typedef std::shared_ptr<ByteBuffer> ByteBufferPtr;
+
+	/// <summary>
+	/// A hardware or software H.264 decoder.  Same contract as pp::VideoDecoder: at most one Decode, one GetPicture, one Flush and one Reset may be pending at a time, and pending callbacks are never run after the backend is deleted.
+	/// </summary>
+	class VideoDecoderBackend
+	{
+	public:
+		virtual ~VideoDecoderBackend() {}
+		virtual void Initialize(HardwareAcceleration hwaccel, const PlatformCallback& callback) = 0;
+		virtual void Decode(uint32_t decode_id, uint32_t size, const void* buffer, const PlatformCallback& callback) = 0;
+		virtual void GetPicture(const PictureCallback& callback) = 0;
+		virtual void RecyclePicture(const VideoPicture& picture) = 0;
+		virtual void Flush(const PlatformCallback& callback) = 0;
+		virtual void Reset(const PlatformCallback& callback) = 0;
+	};
+
+	/// <summary>
+	/// A Graphics3D context plus the subset of OpenGL ES 2.0 used by the player.  The GL functions have the same semantics as the PPB_OpenGLES2 functions of the same names, minus the context argument.
+	/// </summary>
+	class GraphicsContext
+	{
+	public:
+		virtual ~GraphicsContext() {}
+
+		virtual int32_t ResizeBuffers(int32_t width, int32_t height) = 0;
+		virtual int32_t SwapBuffers(const PlatformCallback& callback) = 0;
+
+		virtual GLenum GetError() = 0;
+		virtual void ClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha) = 0;
+		virtual void Clear(GLbitfield mask) = 0;
+		virtual void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+		virtual void GenBuffers(GLsizei n, GLuint* buffers) = 0;
+		virtual void BindBuffer(GLenum target, GLuint buffer) = 0;
+		virtual void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) = 0;
+		virtual GLuint CreateProgram() = 0;
+		virtual void DeleteProgram(GLuint program) = 0;
+		virtual void LinkProgram(GLuint program) = 0;
+		virtual void UseProgram(GLuint program) = 0;
+		virtual GLuint CreateShader(GLenum type) = 0;
+		virtual void ShaderSource(GLuint shader, GLsizei count, const char** str, const GLint* length) = 0;
+		virtual void CompileShader(GLuint shader) = 0;
+		virtual void AttachShader(GLuint program, GLuint shader) = 0;
+		virtual void DeleteShader(GLuint shader) = 0;
+		virtual GLint GetUniformLocation(GLuint program, const char* name) = 0;
+		virtual GLint GetAttribLocation(GLuint program, const char* name) = 0;
+		virtual void Uniform1i(GLint location, GLint x) = 0;
+		virtual void Uniform2f(GLint location, GLfloat x, GLfloat y) = 0;
+		virtual void EnableVertexAttribArray(GLuint index) = 0;
+		virtual void VertexAttribPointer(GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* ptr) = 0;
+		virtual void ActiveTexture(GLenum texture) = 0;
+		virtual void BindTexture(GLenum target, GLuint texture) = 0;
+		virtual void DrawArrays(GLenum mode, GLint first, GLsizei count) = 0;
+	};
+
+	/// <summary>
+	/// Everything the player needs from its host: a clock, main-thread callbacks, messaging to the page, and factories for graphics contexts and video decoders.
+	/// </summary>
+	class Platform
+	{
+	public:
+		virtual ~Platform() {}
+
+		/// <summary>
+		/// Returns a monotonic time in seconds, like PPB_Core::GetTimeTicks.
+		/// </summary>
+		virtual double GetTimeTicks() = 0;
+		/// <summary>
+		/// Runs the callback on the main thread with the given result after the given delay.  Safe to call from any thread.
+		/// </summary>
+		virtual void CallOnMainThread(int32_t delay_in_milliseconds, const PlatformCallback& callback, int32_t result) = 0;
+		/// <summary>
+		/// Sends a string to the browser.
+		/// </summary>
+		virtual void PostString(const std::string& message) = 0;
+		/// <summary>
+		/// Sends a copy of the bytes to the browser as an ArrayBuffer.
+		/// </summary>
+		virtual void PostBinary(const void* data, uint32_t size) = 0;
+		/// <summary>
+		/// Writes a message to the developer console.
+		/// </summary>
+		virtual void LogToConsole(bool isError, const std::string& message) = 0;
+		/// <summary>
+		/// Creates a graphics context of the given size and binds it to the plugin.  Returns NULL on failure.  The caller owns the returned object.
+		/// </summary>
+		virtual GraphicsContext* CreateGraphicsContext(int32_t width, int32_t height) = 0;
+		/// <summary>
+		/// Creates an uninitialized video decoder that renders into textures of the given context.  The caller owns the returned object.
+		/// </summary>
+		virtual VideoDecoderBackend* CreateVideoDecoder(GraphicsContext* context) = 0;
+	};
+}
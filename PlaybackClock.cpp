@@ -0,0 +1,101 @@
+#include "PlaybackClock.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// The rate never differs from the local clock's by more than this.  5% drains 100 ms of excess buffer in 2 seconds, and is
+	/// not noticeable in video.
+	/// </summary>
+	static const double kMaxSlew = 0.05;
+	/// <summary>
+	/// The learned drift is limited to this.  Real camera clocks are within a few hundred ppm; more is a stream problem that should
+	/// not be learned.
+	/// </summary>
+	static const double kMaxDrift = 0.002;
+	/// <summary>
+	/// Milliseconds of buffer error that give 100% slew (before the limit): the proportional term removes an error with this time
+	/// constant.
+	/// </summary>
+	static const double kProportionalMs = 2000;
+	/// <summary>
+	/// The integral term's time constant.  Thirty times the proportional one, so the loop is well damped and the drift estimate does
+	/// not follow jitter.
+	/// </summary>
+	static const double kIntegralMs = 60000;
+	/// <summary>
+	/// The error is integrated into the drift only while it is smaller than this, so the drift is learned from steady playback and not
+	/// from the recovery after a stall or a new stream (conditional integration, to keep the integral from winding up).
+	/// </summary>
+	static const double kIntegrateBelowMs = 12;
+	/// <summary>
+	/// Fraction of each frame's buffer error taken into the smoothed error.  Arrival jitter is averaged over roughly its inverse
+	/// in frames.
+	/// </summary>
+	static const double kErrorGain = 1.0 / 16;
+	/// <summary>
+	/// Gaps between measurements longer than this (a stall, a paused stream) are not integrated as if the error had held throughout.
+	/// </summary>
+	static const int64_t kMaxSteerIntervalMs = 200;
+
+	PlaybackClock::PlaybackClock()
+	{
+		Reset(0);
+	}
+
+	void PlaybackClock::Reset(int64_t nowMs)
+	{
+		basePosition_ = 0;
+		baseLocal_ = nowMs;
+		rate_ = 1;
+		Unlock(nowMs);
+	}
+
+	int64_t PlaybackClock::Read(int64_t nowMs) const
+	{
+		return (int64_t)floor(basePosition_ + (nowMs - baseLocal_) * rate_ + 0.5);
+	}
+
+	void PlaybackClock::Jump(int64_t offsetMs)
+	{
+		basePosition_ += offsetMs;
+		haveError_ = false;
+	}
+
+	void PlaybackClock::Rebase(int64_t nowMs)
+	{
+		basePosition_ += (nowMs - baseLocal_) * rate_;
+		baseLocal_ = nowMs;
+	}
+
+	void PlaybackClock::Steer(int64_t nowMs, double errorMs)
+	{
+		if (!haveError_)
+		{
+			haveError_ = true;
+			error_ = errorMs;
+		}
+		else
+		{
+			error_ += (errorMs - error_) * kErrorGain;
+			int64_t elapsed = std::min(nowMs - lastSteer_, kMaxSteerIntervalMs);
+			if (elapsed > 0 && fabs(error_) < kIntegrateBelowMs)
+				drift_ = std::max(-kMaxDrift, std::min(kMaxDrift, drift_ + error_ * elapsed / (kProportionalMs * kIntegralMs)));
+		}
+		lastSteer_ = nowMs;
+		Rebase(nowMs);
+		rate_ = 1 + std::max(-kMaxSlew, std::min(kMaxSlew, error_ / kProportionalMs + drift_));
+	}
+
+	void PlaybackClock::Unlock(int64_t nowMs)
+	{
+		Rebase(nowMs);
+		rate_ = 1;
+		drift_ = 0;
+		haveError_ = false;
+		error_ = 0;
+		lastSteer_ = 0;
+	}
+}
\ No newline at end of file
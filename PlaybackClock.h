@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// The RenderScheduler's playback clock: a position on the stream's timestamp clock that advances with the local clock, at a
+	/// rate that is steered to hold the frame buffer at its target.  The rate is a phase-locked loop: the smoothed buffer error
+	/// speeds the clock up or slows it down by up to a few percent, which drains or refills the buffer without a visible jump, and
+	/// the integral of the error learns the long-term drift between the camera's clock and the local one.  Jump moves the clock at
+	/// once, for errors too large to slew away.
+	/// </summary>
+	class PlaybackClock
+	{
+	public:
+		PlaybackClock();
+		~PlaybackClock() {}
+
+		/// <summary>
+		/// Starts the clock at position 0 at the given local time, at the local clock's rate, and forgets the learned drift.
+		/// </summary>
+		void Reset(int64_t nowMs);
+
+		/// <summary>The clock's position at the given local time, in milliseconds.</summary>
+		int64_t Read(int64_t nowMs) const;
+		/// <summary>Moves the clock by the given number of milliseconds at once.  Positive jumps ahead.  The smoothed error starts over; the learned drift is kept.</summary>
+		void Jump(int64_t offsetMs);
+
+		/// <summary>
+		/// Feeds the loop one measurement of how far the buffer is from its target, in milliseconds of media (positive: too much is
+		/// buffered, so the clock should run faster), and sets the rate from it.  Called once per frame.
+		/// </summary>
+		void Steer(int64_t nowMs, double errorMs);
+		/// <summary>Returns the rate to that of the local clock from the given local time, and forgets the loop's state and the learned drift.</summary>
+		void Unlock(int64_t nowMs);
+
+		/// <summary>How fast the clock runs against the local clock: 1.02 is 2% fast.</summary>
+		double rate() const { return rate_; }
+		/// <summary>The learned drift of the camera's clock against the local one, in parts per million.</summary>
+		double driftPpm() const { return drift_ * 1e6; }
+
+	private:
+		/// <summary>Restarts the linear segment the clock is on at the given local time, so the rate can change there.</summary>
+		void Rebase(int64_t nowMs);
+
+		double basePosition_;
+		int64_t baseLocal_;
+		double rate_;
+		bool haveError_;
+		double error_;
+		int64_t lastSteer_;
+		double drift_;
+	};
+}
\ No newline at end of file
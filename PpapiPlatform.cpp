@@ -0,0 +1,323 @@
+#include "PpapiPlatform.h"
+
+#include "ppapi/cpp/var_array_buffer.h"
+#include "ppapi/cpp/video_decoder.h"
+
+namespace PnaclPlayer
+{
+	namespace
+	{
+		/// <summary>
+		/// ByteBuffer backed by an ArrayBuffer received from the browser.
+		/// </summary>
+		class PpapiByteBuffer : public ByteBuffer
+		{
+		public:
+			PpapiByteBuffer(const pp::Var& var) : buffer_(var) {}
+			virtual ~PpapiByteBuffer() {}
+			virtual uint32_t ByteLength() { return buffer_.ByteLength(); }
+			virtual void* Map() { return buffer_.Map(); }
+
+		private:
+			pp::VarArrayBuffer buffer_;
+		};
+
+		/// <summary>
+		/// Receives the page's messages on the ingest thread and passes them to the player's ingest queue.
+		/// </summary>
+		class PpapiIngestHandler : public pp::MessageHandler
+		{
+		public:
+			PpapiIngestHandler(pnacl_player* player) : player_(player) {}
+			virtual ~PpapiIngestHandler() {}
+
+			virtual void HandleMessage(pp::InstanceHandle instance, const pp::Var& message_data)
+			{
+				if (message_data.is_string())
+					player_->HandleMessageOnIngestThread(message_data.AsString());
+				else if (message_data.is_array_buffer())
+					player_->HandleMessageOnIngestThread(ByteBufferPtr(new PpapiByteBuffer(message_data)));
+			}
+			virtual pp::Var HandleBlockingMessage(pp::InstanceHandle instance, const pp::Var& message_data)
+			{
+				return pp::Var(); // The page never uses postMessageAndAwaitResponse.
+			}
+			virtual void WasUnregistered(pp::InstanceHandle instance)
+			{
+				delete this;
+			}
+
+		private:
+			pnacl_player* player_;
+		};
+
+		/// <summary>
+		/// GraphicsContext backed by a pp::Graphics3D and PPB_OpenGLES2.
+		/// </summary>
+		class PpapiGraphicsContext : public GraphicsContext
+		{
+		public:
+			PpapiGraphicsContext(pp::Instance* instance, const PPB_OpenGLES2* gles2_if, int32_t width, int32_t height) : gles2_if_(gles2_if), callback_factory_(this)
+			{
+				int32_t context_attributes[] = {
+					PP_GRAPHICS3DATTRIB_ALPHA_SIZE,     8,
+					PP_GRAPHICS3DATTRIB_BLUE_SIZE,      8,
+					PP_GRAPHICS3DATTRIB_GREEN_SIZE,     8,
+					PP_GRAPHICS3DATTRIB_RED_SIZE,       8,
+					PP_GRAPHICS3DATTRIB_DEPTH_SIZE,     0,
+					PP_GRAPHICS3DATTRIB_STENCIL_SIZE,   0,
+					PP_GRAPHICS3DATTRIB_SAMPLES,        0,
+					PP_GRAPHICS3DATTRIB_SAMPLE_BUFFERS, 0,
+					PP_GRAPHICS3DATTRIB_WIDTH,          width,
+					PP_GRAPHICS3DATTRIB_HEIGHT,         height,
+					PP_GRAPHICS3DATTRIB_NONE,
+				};
+				context_ = pp::Graphics3D(instance, context_attributes);
+				assert(!context_.is_null());
+				assert(instance->BindGraphics(context_));
+				resource_ = context_.pp_resource();
+			}
+			virtual ~PpapiGraphicsContext() {}
+
+			const pp::Graphics3D& graphics_3d() const { return context_; }
+
+			virtual int32_t ResizeBuffers(int32_t width, int32_t height) { return context_.ResizeBuffers(width, height); }
+			virtual int32_t SwapBuffers(const PlatformCallback& callback)
+			{
+				swapCallback_ = callback;
+				return context_.SwapBuffers(callback_factory_.NewCallback(&PpapiGraphicsContext::SwapDone));
+			}
+
+			virtual GLenum GetError() { return gles2_if_->GetError(resource_); }
+			virtual void ClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha) { gles2_if_->ClearColor(resource_, red, green, blue, alpha); }
+			virtual void Clear(GLbitfield mask) { gles2_if_->Clear(resource_, mask); }
+			virtual void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) { gles2_if_->Viewport(resource_, x, y, width, height); }
+			virtual void GenBuffers(GLsizei n, GLuint* buffers) { gles2_if_->GenBuffers(resource_, n, buffers); }
+			virtual void BindBuffer(GLenum target, GLuint buffer) { gles2_if_->BindBuffer(resource_, target, buffer); }
+			virtual void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) { gles2_if_->BufferData(resource_, target, size, data, usage); }
+			virtual GLuint CreateProgram() { return gles2_if_->CreateProgram(resource_); }
+			virtual void DeleteProgram(GLuint program) { gles2_if_->DeleteProgram(resource_, program); }
+			virtual void LinkProgram(GLuint program) { gles2_if_->LinkProgram(resource_, program); }
+			virtual void UseProgram(GLuint program) { gles2_if_->UseProgram(resource_, program); }
+			virtual GLuint CreateShader(GLenum type) { return gles2_if_->CreateShader(resource_, type); }
+			virtual void ShaderSource(GLuint shader, GLsizei count, const char** str, const GLint* length) { gles2_if_->ShaderSource(resource_, shader, count, str, length); }
+			virtual void CompileShader(GLuint shader) { gles2_if_->CompileShader(resource_, shader); }
+			virtual void AttachShader(GLuint program, GLuint shader) { gles2_if_->AttachShader(resource_, program, shader); }
+			virtual void DeleteShader(GLuint shader) { gles2_if_->DeleteShader(resource_, shader); }
+			virtual GLint GetUniformLocation(GLuint program, const char* name) { return gles2_if_->GetUniformLocation(resource_, program, name); }
+			virtual GLint GetAttribLocation(GLuint program, const char* name) { return gles2_if_->GetAttribLocation(resource_, program, name); }
+			virtual void Uniform1i(GLint location, GLint x) { gles2_if_->Uniform1i(resource_, location, x); }
+			virtual void Uniform2f(GLint location, GLfloat x, GLfloat y) { gles2_if_->Uniform2f(resource_, location, x, y); }
+			virtual void EnableVertexAttribArray(GLuint index) { gles2_if_->EnableVertexAttribArray(resource_, index); }
+			virtual void VertexAttribPointer(GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* ptr) { gles2_if_->VertexAttribPointer(resource_, indx, size, type, normalized, stride, ptr); }
+			virtual void ActiveTexture(GLenum texture) { gles2_if_->ActiveTexture(resource_, texture); }
+			virtual void BindTexture(GLenum target, GLuint texture) { gles2_if_->BindTexture(resource_, target, texture); }
+			virtual void DrawArrays(GLenum mode, GLint first, GLsizei count) { gles2_if_->DrawArrays(resource_, mode, first, count); }
+
+		private:
+			void SwapDone(int32_t result)
+			{
+				PlatformCallback callback;
+				callback.swap(swapCallback_);
+				callback(result);
+			}
+
+			const PPB_OpenGLES2* gles2_if_;
+			pp::Graphics3D context_;
+			PP_Resource resource_;
+			pp::CompletionCallbackFactory<PpapiGraphicsContext> callback_factory_;
+			PlatformCallback swapCallback_;
+		};
+
+		/// <summary>
+		/// VideoDecoderBackend backed by pp::VideoDecoder.  Deleting this object cancels any pending callbacks.
+		/// </summary>
+		class PpapiVideoDecoder : public VideoDecoderBackend
+		{
+		public:
+			PpapiVideoDecoder(pp::Instance* instance, const pp::Graphics3D& graphics_3d) : decoder_(instance), graphics_3d_(graphics_3d), callback_factory_(this)
+			{
+				assert(!decoder_.is_null());
+			}
+			virtual ~PpapiVideoDecoder() {}
+
+			virtual void Initialize(HardwareAcceleration hwaccel, const PlatformCallback& callback)
+			{
+				const PP_VideoProfile kBitstreamProfile = PP_VIDEOPROFILE_H264HIGH;
+				PP_HardwareAcceleration hwva = PP_HARDWAREACCELERATION_NONE;
+				if (hwaccel == HWACCEL_WITHFALLBACK)
+					hwva = PP_HARDWAREACCELERATION_WITHFALLBACK;
+				else if (hwaccel == HWACCEL_ONLY)
+					hwva = PP_HARDWAREACCELERATION_ONLY;
+				initializeCallback_ = callback;
+				decoder_.Initialize(graphics_3d_, kBitstreamProfile, hwva, 0, callback_factory_.NewCallback(&PpapiVideoDecoder::InitializeDone));
+			}
+			virtual void Decode(uint32_t decode_id, uint32_t size, const void* buffer, const PlatformCallback& callback)
+			{
+				decodeCallback_ = callback;
+				decoder_.Decode(decode_id, size, buffer, callback_factory_.NewCallback(&PpapiVideoDecoder::DecodeDone));
+			}
+			virtual void GetPicture(const PictureCallback& callback)
+			{
+				pictureCallback_ = callback;
+				decoder_.GetPicture(callback_factory_.NewCallbackWithOutput(&PpapiVideoDecoder::PictureReady));
+			}
+			virtual void RecyclePicture(const VideoPicture& picture)
+			{
+				PP_VideoPicture pp_picture;
+				pp_picture.decode_id = picture.decode_id;
+				pp_picture.texture_id = picture.texture_id;
+				pp_picture.texture_target = picture.texture_target;
+				pp_picture.texture_size.width = picture.texture_size.width;
+				pp_picture.texture_size.height = picture.texture_size.height;
+				pp_picture.visible_rect.point.x = picture.visible_rect.x;
+				pp_picture.visible_rect.point.y = picture.visible_rect.y;
+				pp_picture.visible_rect.size.width = picture.visible_rect.width;
+				pp_picture.visible_rect.size.height = picture.visible_rect.height;
+				decoder_.RecyclePicture(pp_picture);
+			}
+			virtual void Flush(const PlatformCallback& callback)
+			{
+				flushCallback_ = callback;
+				decoder_.Flush(callback_factory_.NewCallback(&PpapiVideoDecoder::FlushDone));
+			}
+			virtual void Reset(const PlatformCallback& callback)
+			{
+				resetCallback_ = callback;
+				decoder_.Reset(callback_factory_.NewCallback(&PpapiVideoDecoder::ResetDone));
+			}
+
+		private:
+			// Each callback is moved out of its slot before it runs, because running it usually queues the next operation of the same kind.
+			static void Run(PlatformCallback& slot, int32_t result)
+			{
+				PlatformCallback callback;
+				callback.swap(slot);
+				callback(result);
+			}
+			void InitializeDone(int32_t result) { Run(initializeCallback_, result); }
+			void DecodeDone(int32_t result) { Run(decodeCallback_, result); }
+			void FlushDone(int32_t result) { Run(flushCallback_, result); }
+			void ResetDone(int32_t result) { Run(resetCallback_, result); }
+			void PictureReady(int32_t result, PP_VideoPicture pp_picture)
+			{
+				VideoPicture picture;
+				picture.decode_id = pp_picture.decode_id;
+				picture.texture_id = pp_picture.texture_id;
+				picture.texture_target = pp_picture.texture_target;
+				picture.texture_size.width = pp_picture.texture_size.width;
+				picture.texture_size.height = pp_picture.texture_size.height;
+				picture.visible_rect.x = pp_picture.visible_rect.point.x;
+				picture.visible_rect.y = pp_picture.visible_rect.point.y;
+				picture.visible_rect.width = pp_picture.visible_rect.size.width;
+				picture.visible_rect.height = pp_picture.visible_rect.size.height;
+				PictureCallback callback;
+				callback.swap(pictureCallback_);
+				callback(result, picture);
+			}
+
+			pp::VideoDecoder decoder_;
+			pp::Graphics3D graphics_3d_;
+			pp::CompletionCallbackFactory<PpapiVideoDecoder> callback_factory_;
+			PlatformCallback initializeCallback_;
+			PlatformCallback decodeCallback_;
+			PlatformCallback flushCallback_;
+			PlatformCallback resetCallback_;
+			PictureCallback pictureCallback_;
+		};
+	}  // anonymous namespace
+
+	PpapiPlatform::PpapiPlatform(PP_Instance instance, pp::Module* module) : pp::Instance(instance), pp::Graphics3DClient(this), callback_factory_(this), ingest_thread_(this), ingest_handler_(NULL)
+	{
+		console_if_ = static_cast<const PPB_Console*>(pp::Module::Get()->GetBrowserInterface(PPB_CONSOLE_INTERFACE));
+		core_if_ = static_cast<const PPB_Core*>(pp::Module::Get()->GetBrowserInterface(PPB_CORE_INTERFACE));
+		gles2_if_ = static_cast<const PPB_OpenGLES2*>(pp::Module::Get()->GetBrowserInterface(PPB_OPENGLES2_INTERFACE));
+
+		player_ = new pnacl_player(this);
+	}
+
+	PpapiPlatform::~PpapiPlatform()
+	{
+		if (ingest_handler_)
+		{
+			// The handler is unregistered (and deletes itself) on the ingest thread, before the thread quits.
+			UnregisterMessageHandler();
+			ingest_thread_.Join();
+		}
+		delete player_;
+	}
+
+	bool PpapiPlatform::Init(uint32_t argc, const char * argn[], const char * argv[])
+	{
+		if (!player_->Init(argc, argn, argv))
+			return false;
+		if (player_->ingestThreaded())
+		{
+			ingest_handler_ = new PpapiIngestHandler(player_);
+			if (!ingest_thread_.Start() || RegisterMessageHandler(ingest_handler_, ingest_thread_.message_loop()) != PP_OK)
+			{
+				LogToConsole(true, "Could not start the ingest thread; handling messages on the main thread");
+				delete ingest_handler_;
+				ingest_handler_ = NULL;
+				player_->IngestThreadFailed();
+			}
+		}
+		return true;
+	}
+
+	void PpapiPlatform::DidChangeView(const pp::Rect& position, const pp::Rect& clip_ignored)
+	{
+		player_->DidChangeView(position.width(), position.height());
+	}
+
+	void PpapiPlatform::HandleMessage(const pp::Var& var_message)
+	{
+		if (var_message.is_string())
+			player_->HandleMessage(var_message.AsString());
+		else if (var_message.is_array_buffer())
+			player_->HandleMessage(ByteBufferPtr(new PpapiByteBuffer(var_message)));
+	}
+
+	double PpapiPlatform::GetTimeTicks()
+	{
+		return core_if_->GetTimeTicks();
+	}
+
+	void PpapiPlatform::CallOnMainThread(int32_t delay_in_milliseconds, const PlatformCallback& callback, int32_t result)
+	{
+		core_if_->CallOnMainThread(delay_in_milliseconds, callback_factory_.NewCallback(&PpapiPlatform::RunCallback, callback).pp_completion_callback(), result);
+	}
+
+	void PpapiPlatform::RunCallback(int32_t result, const PlatformCallback& callback)
+	{
+		callback(result);
+	}
+
+	void PpapiPlatform::PostString(const std::string& message)
+	{
+		PostMessage(pp::Var(message));
+	}
+
+	void PpapiPlatform::PostBinary(const void* data, uint32_t size)
+	{
+		pp::VarArrayBuffer buffer(size);
+		memcpy(buffer.Map(), data, size);
+		buffer.Unmap();
+		PostMessage(buffer);
+	}
+
+	void PpapiPlatform::LogToConsole(bool isError, const std::string& message)
+	{
+		console_if_->Log(pp_instance(), isError ? PP_LOGLEVEL_ERROR : PP_LOGLEVEL_LOG, pp::Var(message).pp_var());
+	}
+
+	GraphicsContext* PpapiPlatform::CreateGraphicsContext(int32_t width, int32_t height)
+	{
+		return new PpapiGraphicsContext(this, gles2_if_, width, height);
+	}
+
+	VideoDecoderBackend* PpapiPlatform::CreateVideoDecoder(GraphicsContext* context)
+	{
+		return new PpapiVideoDecoder(this, static_cast<PpapiGraphicsContext*>(context)->graphics_3d());
+	}
+}
\ No newline at end of file
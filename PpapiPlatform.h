@@ -0,0 +1,77 @@
+#pragma once
+#include "Platform.h"
+#include "pnacl_player.h"
+
+#include "ppapi/c/ppb_console.h"
+#include "ppapi/c/ppb_core.h"
+#include "ppapi/c/ppb_opengles2.h"
+#include "ppapi/cpp/graphics_3d.h"
+#include "ppapi/cpp/graphics_3d_client.h"
+#include "ppapi/cpp/instance.h"
+#include "ppapi/cpp/message_handler.h"
+#include "ppapi/cpp/module.h"
+#include "ppapi/cpp/var.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// The PPAPI plugin instance.  Implements Platform on top of the browser interfaces and forwards everything else to the pnacl_player it owns.
+	/// </summary>
+	class PpapiPlatform : public pp::Instance, public pp::Graphics3DClient, public Platform
+	{
+	public:
+		PpapiPlatform(PP_Instance instance, pp::Module* module);
+		virtual ~PpapiPlatform();
+
+		// pp::Instance implementation.
+		virtual void DidChangeView(const pp::Rect& position, const pp::Rect& clip_ignored);
+
+		// pp::Init implementation lets us access startup arguments
+		virtual bool Init(uint32_t argc, const char * argn[], const char * argv[]);
+
+		/// <summary>
+		/// Handler for messages coming in from the browser via postMessage().  The argument "var_message" can be any pp:Var type; for example int, string, Array, or Dictionary. Please see the pp:Var documentation for more details.
+		/// </summary>
+		/// <param name="var_message">The message posted by the browser.</param>
+		virtual void HandleMessage(const pp::Var& var_message);
+
+		// pp::Graphics3DClient implementation.
+		virtual void Graphics3DContextLost()
+		{
+			// TODO(vrk/fischman): Properly reset after a lost graphics context.  In particular need to delete context_ and re-create textures.
+			// Probably have to recreate the decoder from scratch, because old textures can still be outstanding in the decoder!
+			assert(false && "Unexpectedly lost graphics context");
+		}
+
+		// Platform implementation.
+		virtual double GetTimeTicks();
+		virtual void CallOnMainThread(int32_t delay_in_milliseconds, const PlatformCallback& callback, int32_t result);
+		virtual void PostString(const std::string& message);
+		virtual void PostBinary(const void* data, uint32_t size);
+		virtual void LogToConsole(bool isError, const std::string& message);
+		virtual GraphicsContext* CreateGraphicsContext(int32_t width, int32_t height);
+		virtual VideoDecoderBackend* CreateVideoDecoder(GraphicsContext* context);
+
+	private:
+		void RunCallback(int32_t result, const PlatformCallback& callback);
+
+		// Thread-safe because CallOnMainThread is also called from the ingest thread.
+		pp::CompletionCallbackFactory<PpapiPlatform, pp::ThreadSafeThreadTraits> callback_factory_;
+
+		// Unowned pointers.
+		const PPB_Console* console_if_;
+		const PPB_Core* core_if_;
+		const PPB_OpenGLES2* gles2_if_;
+
+		// Owned data.
+		pnacl_player* player_;
+		// In threaded ingest mode, messages from the page are delivered on this thread instead of the main thread.
+		pp::SimpleThread ingest_thread_;
+		// Deletes itself once unregistered.  NULL unless threaded ingest is running.
+		pp::MessageHandler* ingest_handler_;
+	};
+}
\ No newline at end of file
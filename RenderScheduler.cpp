@@ -1,15 +1,16 @@
 #include "RenderScheduler.h"
-#include "pnacl_player.h"
+
+#include <math.h>
 
 namespace PnaclPlayer
 {
-	void RenderScheduler::PrintSchedulerStatus(DecodedFrame* frame, std::string message)
+	void RenderScheduler::PrintSchedulerStatus(const DecodedFrame* frame, std::string message)
 	{
 #ifdef DebugLogging
 		std::stringstream sstm;
 		sstm << "{ ";
-		sstm << "playbackClockStart: " << playbackClockStart << ", ";
-		sstm << "playbackClockOffset: " << playbackClockOffset << ", ";
+		sstm << "playbackClock: " << ReadPlaybackClock() << ", ";
+		sstm << "clockRate: " << playbackClock.rate() << ", ";
 		sstm << "numFramesAccepted: " << numFramesAccepted << ", ";
 		sstm << "lastFrameTS: " << lastFrameTS << ", ";
 		sstm << "timeoutHelper: " << timeoutHelper << ", ";
@@ -22,7 +23,7 @@ namespace PnaclPlayer
 			sstm << "NULL";
 		sstm << ",    " << message << " ";
 		sstm << "}";
-		instance_->PostString(sstm.str());
+		client_->PostString(sstm.str());
 #endif
 	}
 	/// <summary>
@@ -30,23 +31,38 @@ namespace PnaclPlayer
 	/// </summary>
 	int64_t RenderScheduler::perfNow()
 	{
-		return instance_->perfNow();
+		return client_->perfNow();
 	}
 	/// <summary>To be called by the owner of this RenderScheduler when a frame is decoded and should be scheduled for rendering.</summary>
-	void RenderScheduler::AddFrame(DecodedFrame* frame)
+	void RenderScheduler::AddFrame(DecodedFramePtr frame)
 	{
-		PrintSchedulerStatus(frame, "start AddFrame()");
+		PrintSchedulerStatus(frame.get(), "start AddFrame()");
 		if (numFramesAccepted == 0)
-			playbackClockStart = perfNow();
+			playbackClock.Reset(perfNow());
 		numFramesAccepted++;
-		frame->expectedInterframe = frame->timestamp - lastFrameTS;
+		stats.framesAdded++;
+		frame->presentationTime = cadence.AddFrame(perfNow(), frame->timestamp);
+		if (cadence.intervalMs() > 0)
+			frame->expectedInterframe = (int32_t)(cadence.intervalMs() + 0.5);
+		else
+			frame->expectedInterframe = (int32_t)(frame->timestamp - lastFrameTS);
+		stats.frameIntervalMs = cadence.intervalMs();
+		stats.cadenceChanges = cadence.changes();
 		lastFrameTS = frame->timestamp;
-		frameQueue.push_back(frame);
-		// Sort the frame queue by timestamp, as this can improve playback if frames come in out-of-order.
-		// This is also the entire reason we are using a vector instead of a queue to hold frames.
-		std::sort(frameQueue.begin(), frameQueue.end(), comparePtrToDecodedFrame);
+		jitter.AddArrival(perfNow(), frame->presentationTime);
+		maxQueuedFrames = jitter.targetDepth();
+		stats.queueDepth = maxQueuedFrames;
+		stats.jitterMs = jitter.jitterMs();
+		double bufferError = SteerPlaybackClock(frame->presentationTime);
+		if (frameQueue.full())
+		{
+			// Only reachable if rendering has stalled for a long time.  Make room by dropping the oldest frame.
+			stats.framesDropped++;
+			client_->frameDropFunc(DequeueOldest(), true);
+		}
+		frameQueue.Insert(std::move(frame)); // The frame may be rendered and released by MaintainSchedule, so it is not referenced after this point.
 
-		if (frameQueue.size() > maxQueuedFrames)
+		if (frameQueue.size() > (size_t)maxQueuedFrames)
 		{
 			// Frame queue is overfull.
 			// Adjust the playback clock to match the oldest queued frame.
@@ -55,11 +71,17 @@ namespace PnaclPlayer
 			std::stringstream sstm;
 			sstm << "Jumping clock ahead " << timeRemaining;
 			PrintSchedulerStatus(NULL, sstm.str());
-			if (timeRemaining > 0)
+			// A burst after a stall is drained by jumping once per frame, each by up to an interval, so the threshold applies to the
+			// whole excess rather than to each jump.
+			if (timeRemaining > 0 && ExceedsJumpThreshold((int64_t)bufferError))
+			{
 				OffsetPlaybackClock(timeRemaining); // Jump the clock ahead because we are getting too many frames queued.
+				stats.clockJumps++;
+				stats.clockJumpTotal += timeRemaining;
+			}
 		}
 		MaintainSchedule();
-		PrintSchedulerStatus(frame, "end AddFrame()");
+		PrintSchedulerStatus(NULL, "end AddFrame()");
 	}
 	/// <summary>To be called by the owner of this RenderScheduler when changing streams.  Any queued frames will be dropped.</summary>
 	void RenderScheduler::Reset()
@@ -67,21 +89,72 @@ namespace PnaclPlayer
 		timeoutHelper++; // this invalidates the previous callback watching timeoutHelper
 		lastFrameTS = 0;
 		numFramesAccepted = 0;
-		playbackClockOffset = 0;
-		playbackClockStart = perfNow();
+		playbackClock.Reset(perfNow());
+		jitter.Reset();
+		cadence.Reset();
+		lastVsyncDue_ = 0;
+		lastVsyncPresentationTime_ = 0;
+		maxQueuedFrames = jitter.targetDepth();
+		stats.queueDepth = maxQueuedFrames;
 		while (frameQueue.size() > 0)
-			instance_->frameDropFunc(DequeueOldest(), false);
+		{
+			stats.framesDropped++;
+			client_->frameDropFunc(DequeueOldest(), false);
+		}
+	}
+	void RenderScheduler::SetJitterBufferMode(JitterBufferMode mode)
+	{
+		jitter.SetMode(mode);
+		maxQueuedFrames = jitter.targetDepth();
+		stats.queueDepth = maxQueuedFrames;
+	}
+	void RenderScheduler::SetClockJumpThreshold(int32_t ms)
+	{
+		clockJumpThresholdMs_ = ms;
+		if (ms <= 0)
+			playbackClock.Unlock(perfNow());
+		stats.clockRate = playbackClock.rate();
+		stats.clockDriftPpm = playbackClock.driftPpm();
+	}
+	double RenderScheduler::SteerPlaybackClock(int64_t presentationTime)
+	{
+		if (clockJumpThresholdMs_ <= 0 || numFramesAccepted < 2)
+			return 0;
+		// How long the frame that just arrived will wait before its paint must start, against the wait that covers the arrival jitter.
+		double error;
+		if (vsync_ && vsync_->locked())
+		{
+			// Vsync-aligned paints start most of a refresh before the frame is due.  Frames are shown on whole refreshes, so up to a
+			// refresh more than the target changes little on screen, and steering it out would only move due times across refreshes.
+			double period = vsync_->periodMs();
+			error = (double)(presentationTime - ReadPlaybackClock()) - period - jitter.targetDelayMs();
+			error = error > period ? error - period : error < 0 ? error : 0;
+		}
+		else
+			error = (double)(presentationTime - ReadPlaybackClock() - lastRenderDuration) - jitter.targetDelayMs();
+		// Errors past the threshold are handled by jumping the clock; feeding them to the loop would only disturb it.
+		if (!ExceedsJumpThreshold((int64_t)error))
+			playbackClock.Steer(perfNow(), error);
+		stats.clockRate = playbackClock.rate();
+		stats.clockDriftPpm = playbackClock.driftPpm();
+		return error;
 	}
 	void RenderScheduler::DelayedPaint(int32_t result)
 	{
 		if(frameQueue.empty() && timeoutHelper == result)
-			instance_->PostString("RenderScheduler::DelayedPaint() found empty frameQueue");
+			client_->PostString("RenderScheduler::DelayedPaint() found empty frameQueue");
 		if (timeoutHelper == result && !frameQueue.empty())
 		{
 			std::stringstream sstm;
 			sstm << "DelayedPaint(" << result << ")";
 			PrintSchedulerStatus(NULL, sstm.str());
-			instance_->frameRenderFunc(DequeueOldest());
+			if (vsync_ && vsync_->locked())
+				MaintainVsyncSchedule(); // Decide again: frames may have arrived for the same refresh.
+			else
+			{
+				stats.framesRendered++;
+				client_->frameRenderFunc(DequeueOldest());
+			}
 		}
 	}
 	/// <summary>To be called by the owner of this RenderScheduler when a frame is finished rendering.</summary>
@@ -93,25 +166,87 @@ namespace PnaclPlayer
 	void RenderScheduler::MaintainSchedule()
 	{
 		timeoutHelper++; // this invalidates the previous callback watching timeoutHelper
-		if (frameQueue.size() > 0)
+		if (frameQueue.size() > 0 && vsync_ && vsync_->locked())
+			MaintainVsyncSchedule();
+		else if (frameQueue.size() > 0)
 		{
 			int64_t timeToWait = GetTimeUntilRenderOldest();
 			if (timeToWait <= 0)
 			{
-				if (timeToWait < 0)
+				if (timeToWait < 0 && ExceedsJumpThreshold(timeToWait))
+				{
 					OffsetPlaybackClock(timeToWait); // Roll the clock back because frames are coming in late.
+					stats.clockRollbacks++;
+					stats.clockRollbackTotal -= timeToWait;
+				}
 				std::stringstream sstm;
 				sstm << "MaintainSchedule > " << timeToWait << " > frameRenderFunc()";
 				PrintSchedulerStatus(NULL, sstm.str());
-				instance_->frameRenderFunc(DequeueOldest());
+				stats.framesRendered++;
+				client_->frameRenderFunc(DequeueOldest());
 			}
 			else
 			{
 				std::stringstream sstm;
 				sstm << "MaintainSchedule < " << timeToWait << " < frameRenderFunc()";
 				PrintSchedulerStatus(NULL, sstm.str());
-				instance_->CallDelayedPaintAfterDelay((int32_t)timeToWait, timeoutHelper);
+				client_->CallDelayedPaintAfterDelay((int32_t)timeToWait, timeoutHelper);
 			}
 		}
 	}
+	void RenderScheduler::MaintainVsyncSchedule()
+	{
+		timeoutHelper++;
+		double period = vsync_->periodMs();
+		int64_t now = perfNow();
+		// The refresh a paint started now would be shown at.  Of the frames due by then, only the newest would be seen.
+		double refresh = vsync_->NextVsync((double)now);
+		double due = DueVsync(frameQueue.front(), lastVsyncDue_, lastVsyncPresentationTime_);
+		while (frameQueue.size() > 1 && DueVsync(frameQueue.at(1), due, frameQueue.front()->presentationTime) < refresh + period / 2)
+		{
+			stats.framesDropped++;
+			stats.framesSuperseded++;
+			client_->frameDropFunc(DequeueOldest(), true);
+			due = DueVsync(frameQueue.front(), lastVsyncDue_, lastVsyncPresentationTime_);
+		}
+		// Paints start early in the refresh before the one the frame is due at, so its paint makes that refresh.  Always starting at
+		// the same point in a refresh keeps a paint that takes most of a refresh from landing one refresh late only some of the time.
+		double wake = due - period + period / 8;
+		if (now >= wake - 1)
+		{
+			// Up to half a refresh early or late is on time.  Only a frame that missed its refresh rolls the clock back, by the miss, or
+			// the clock would ratchet later with every frame that rounds the other way.
+			lastVsyncDue_ = due;
+			lastVsyncPresentationTime_ = frameQueue.front()->presentationTime;
+			RenderOldest(due < refresh - period / 2 ? (int64_t)floor(due - refresh + 0.5) : 0);
+			return;
+		}
+		int32_t delay = (int32_t)ceil(wake - now);
+		std::stringstream sstm;
+		sstm << "MaintainVsyncSchedule < " << delay << " < frameRenderFunc()";
+		PrintSchedulerStatus(NULL, sstm.str());
+		client_->CallDelayedPaintAfterDelay(delay > 1 ? delay : 1, timeoutHelper);
+	}
+	double RenderScheduler::DueVsync(const DecodedFrame* frame, double previousDue, int64_t previousPresentationTime)
+	{
+		double due = vsync_->NearestVsync((double)(perfNow() + (frame->presentationTime - ReadPlaybackClock())));
+		// When frames come at the refresh rate, the clock's phase can sit on the rounding boundary, and frames a refresh apart round
+		// to the same refresh.  Keep them on successive refreshes instead of dropping one.
+		double period = vsync_->periodMs();
+		if (due < previousDue + period / 2 && frame->presentationTime - previousPresentationTime >= period * 3 / 4)
+			due = previousDue + period;
+		return due;
+	}
+	void RenderScheduler::RenderOldest(int64_t timeToWait)
+	{
+		if (timeToWait < 0 && ExceedsJumpThreshold(timeToWait))
+		{
+			OffsetPlaybackClock(timeToWait); // Roll the clock back because frames are coming in late.
+			stats.clockRollbacks++;
+			stats.clockRollbackTotal -= timeToWait;
+		}
+		PrintSchedulerStatus(NULL, "RenderOldest > frameRenderFunc()");
+		stats.framesRendered++;
+		client_->frameRenderFunc(DequeueOldest());
+	}
 }
\ No newline at end of file
@@ -1,58 +1,150 @@
 #pragma once
 #include "DecodedFrame.h"
+#include "FrameReorderBuffer.h"
+#include "JitterEstimator.h"
+#include "CadenceEstimator.h"
+#include "VsyncEstimator.h"
+#include "PlaybackClock.h"
+#include <algorithm>
 #include <queue>
 #include <sstream>
-#include "ppapi/utility/completion_callback_factory.h"
+#include <vector>
 namespace PnaclPlayer
 {
-	class pnacl_player;
+	/// <summary>
+	/// The owner of a RenderScheduler.  Provides the clock and the delayed callback, and takes frames back when they are due or dropped.  Implemented by VideoStream, and by the replay benchmark.
+	/// </summary>
+	class RenderSchedulerClient
+	{
+	public:
+		virtual ~RenderSchedulerClient() {}
+		/// <summary>
+		/// Returns the time in milliseconds similar to performance.now() in the browser, but related to no particular epoch.
+		/// </summary>
+		virtual int64_t perfNow() = 0;
+		/// <summary>The frame is due and should be painted now.  Ownership passes to the client.</summary>
+		virtual void frameRenderFunc(DecodedFramePtr frame) = 0;
+		/// <summary>The frame will not be painted.  Ownership passes to the client.</summary>
+		virtual void frameDropFunc(DecodedFramePtr frame, bool reportToClient) = 0;
+		/// <summary>Call RenderScheduler::DelayedPaint(result) after the given delay.</summary>
+		virtual void CallDelayedPaintAfterDelay(int32_t delay_in_milliseconds, int32_t result) = 0;
+		virtual void PostString(std::string message) = 0;
+	};
+
+	/// <summary>
+	/// Counters describing what the RenderScheduler has done since it was created.  Reset() does not clear them.
+	/// </summary>
+	struct RenderSchedulerStats
+	{
+		RenderSchedulerStats() : framesAdded(0), framesRendered(0), framesDropped(0), clockJumps(0), clockJumpTotal(0), clockRollbacks(0), clockRollbackTotal(0), queueDepth(2), jitterMs(0), frameIntervalMs(0), cadenceChanges(0), framesSuperseded(0), clockRate(1), clockDriftPpm(0) {}
+		int64_t framesAdded;
+		int64_t framesRendered;
+		int64_t framesDropped;
+		/// <summary>Number of times the playback clock was jumped ahead because too many frames were queued (by more than the clock jump threshold), and the total milliseconds jumped.</summary>
+		int64_t clockJumps;
+		int64_t clockJumpTotal;
+		/// <summary>Number of times the playback clock was rolled back because a frame was late (by more than the clock jump threshold), and the total milliseconds rolled back.</summary>
+		int64_t clockRollbacks;
+		int64_t clockRollbackTotal;
+		/// <summary>The number of frames currently allowed to queue before the clock is jumped ahead, as chosen by the jitter buffer.</summary>
+		int32_t queueDepth;
+		/// <summary>The current arrival jitter estimate in milliseconds.</summary>
+		double jitterMs;
+		/// <summary>The stream's frame interval in milliseconds, as estimated by the CadenceEstimator, or 0 if not known yet.</summary>
+		double frameIntervalMs;
+		/// <summary>Number of times the frame rate has changed.</summary>
+		int64_t cadenceChanges;
+		/// <summary>Frames dropped (and counted in framesDropped) because a later frame was due at the same refresh, so they would never have been seen.</summary>
+		int64_t framesSuperseded;
+		/// <summary>How fast the playback clock currently runs against the local clock: 1.02 is 2% fast, draining the buffer.</summary>
+		double clockRate;
+		/// <summary>The learned drift of the camera's clock against the local clock, in parts per million.</summary>
+		double clockDriftPpm;
+	};
+
 	class RenderScheduler
 	{
 	public:
-		RenderScheduler(pnacl_player* instance) : lastRenderStarted(0), lastRenderDuration(0), instance_(instance), maxQueuedFrames(2), playbackClockStart(0), playbackClockOffset(0), numFramesAccepted(0), lastFrameTS(0), timeoutHelper(0) {}
+		RenderScheduler(RenderSchedulerClient* client) : lastRenderStarted(0), lastRenderDuration(0), client_(client), maxQueuedFrames(2), clockJumpThresholdMs_(kDefaultClockJumpThresholdMs), numFramesAccepted(0), lastFrameTS(0), timeoutHelper(0), vsync_(NULL), lastVsyncDue_(0), lastVsyncPresentationTime_(0), frameQueue(kFrameQueueCapacity) {}
 		~RenderScheduler() {}
 		/// <summary>To be called by the owner of this RenderScheduler when a frame is decoded and should be scheduled for rendering.</summary>
-		void AddFrame(DecodedFrame* frame);
+		void AddFrame(DecodedFramePtr frame);
 		/// <summary>To be called by the owner of this RenderScheduler when a frame is finished rendering.</summary>
 		void RenderComplete();
 		/// <summary>To be called by the owner of this RenderScheduler when changing streams.  Any queued frames will be dropped.</summary>
 		void Reset();
 		void DelayedPaint(int32_t result);
+		/// <summary>Selects how the number of queued frames is chosen.  Takes effect with the next frame.</summary>
+		void SetJitterBufferMode(JitterBufferMode mode);
+		JitterBufferMode jitterBufferMode() const { return jitter.mode(); }
+		/// <summary>
+		/// Aligns presentation with the display's refreshes as estimated by the given VsyncEstimator, once it is locked.  NULL (the default) schedules by timer alone.
+		/// </summary>
+		void SetVsync(const VsyncEstimator* vsync) { vsync_ = vsync; }
+		/// <summary>
+		/// Sets how far, in milliseconds, the playback clock must be from where the buffer needs it before it is jumped there at once.
+		/// Smaller errors, and the camera's clock drift, are corrected by running the clock up to 5% fast or slow.  0 turns slewing off,
+		/// so every overfull queue jumps the clock and every late frame rolls it back, as before.
+		/// </summary>
+		void SetClockJumpThreshold(int32_t ms);
+		int32_t clockJumpThreshold() const { return clockJumpThresholdMs_; }
+		static const int32_t kDefaultClockJumpThresholdMs = 100;
 
 		int64_t lastRenderStarted;
 		int32_t lastRenderDuration;
+		RenderSchedulerStats stats;
 	private:
-		pnacl_player * instance_;
+		RenderSchedulerClient * client_;
 
 		int32_t maxQueuedFrames;
-		int64_t playbackClockStart;
-		int64_t playbackClockOffset;
+		PlaybackClock playbackClock;
+		int32_t clockJumpThresholdMs_;
 		int64_t numFramesAccepted;
 		int64_t lastFrameTS;
 		int32_t timeoutHelper;
+		// Chooses maxQueuedFrames from the measured arrival jitter.
+		JitterEstimator jitter;
+		// Gives each frame its presentation time and expected interframe time.
+		CadenceEstimator cadence;
+		// The display's refresh grid, owned by the client.  May be NULL.
+		const VsyncEstimator* vsync_;
+		// The refresh the last frame rendered in vsync mode was due at (perfNow clock), and its presentation time.
+		double lastVsyncDue_;
+		int64_t lastVsyncPresentationTime_;
 
-		// Pictures go into this vector when they are received from the decoder.
-		std::vector<DecodedFrame*> frameQueue;
-		static bool comparePtrToDecodedFrame(DecodedFrame* a, DecodedFrame* b) { return (a->timestamp < b->timestamp); }
+		/// <summary>
+		/// The most frames frameQueue can hold.  Must exceed the largest depth the jitter buffer can choose.  The queue normally holds no more than maxQueuedFrames + 1, because AddFrame jumps the clock ahead beyond that; the rest is slack for stalls.
+		/// </summary>
+		static const size_t kFrameQueueCapacity = 64;
+		// Pictures go into this queue when they are received from the decoder.  It is kept sorted by timestamp, as this can improve playback if frames come in out-of-order.
+		FrameReorderBuffer frameQueue;
 
 		int64_t ReadPlaybackClock()
 		{
-			return (perfNow() - playbackClockStart) + playbackClockOffset;
+			return playbackClock.Read(perfNow());
 		}
 		void OffsetPlaybackClock(int64_t offset)
 		{
-			playbackClockOffset += offset;
+			playbackClock.Jump(offset);
 		}
+		/// <summary>True if the playback clock should be jumped by the given offset rather than slewed.</summary>
+		bool ExceedsJumpThreshold(int64_t offset) const
+		{
+			return clockJumpThresholdMs_ <= 0 || offset > clockJumpThresholdMs_ || offset < -clockJumpThresholdMs_;
+		}
+		/// <summary>
+		/// Steers the playback clock's rate toward keeping each arriving frame the jitter buffer's target delay ahead of it.  Returns how
+		/// far beyond the target delay the frame is, in milliseconds: positive if too much is buffered.
+		/// </summary>
+		double SteerPlaybackClock(int64_t presentationTime);
 		int64_t GetTimeUntilRenderOldest()
 		{
-			return (frameQueue.front()->timestamp - ReadPlaybackClock()) - lastRenderDuration;
+			return (frameQueue.front()->presentationTime - ReadPlaybackClock()) - lastRenderDuration;
 		}
-		DecodedFrame* DequeueOldest()
+		DecodedFramePtr DequeueOldest()
 		{
 			/// <summary>Removes and returns a reference to the first item in the queue. Do not call if the queue is empty.</summary>
-			DecodedFrame* oldest = frameQueue.front();
-			frameQueue.erase(frameQueue.begin());
-			return oldest;
+			return frameQueue.PopFront();
 		}
 
 		/// <summary>
@@ -60,6 +152,18 @@ namespace PnaclPlayer
 		/// </summary>
 		int64_t perfNow();
 		void MaintainSchedule();
-		void PrintSchedulerStatus(DecodedFrame* frame, std::string message);
+		/// <summary>
+		/// MaintainSchedule when the refresh grid is known: decides which frame the next refresh a paint can make should show, and either paints it now or waits until the refresh before the one the oldest frame is due at.
+		/// </summary>
+		void MaintainVsyncSchedule();
+		/// <summary>
+		/// Returns the refresh nearest to the time the frame is due, on the perfNow clock, but at least one refresh after previousDue if the frame is most of a refresh after the frame that was due then.
+		/// </summary>
+		double DueVsync(const DecodedFrame* frame, double previousDue, int64_t previousPresentationTime);
+		/// <summary>
+		/// Renders the oldest frame, first rolling the clock back by timeToWait if it is negative (the frame is late).
+		/// </summary>
+		void RenderOldest(int64_t timeToWait);
+		void PrintSchedulerStatus(const DecodedFrame* frame, std::string message);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// A lock-free first-in-first-out queue with a fixed capacity for exactly one producer thread and one consumer thread.
+	/// Storage is allocated up front, so pushing and popping never allocate or block.  The producer owns tail_ and the consumer
+	/// owns head_; each only reads the other's index, with acquire/release ordering so an item's contents are visible before its slot is.
+	/// </summary>
+	template <typename T>
+	class SpscQueue
+	{
+	public:
+		/// <summary>
+		/// The capacity must be a power of two.
+		/// </summary>
+		SpscQueue(size_t capacity) : slots_(capacity), mask_(capacity - 1), head_(0), tail_(0)
+		{
+			assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+		}
+		~SpscQueue() {}
+
+		size_t capacity() const { return slots_.size(); }
+
+		/// <summary>
+		/// Producer only.  Moves the item into the queue and returns true, or returns false if the queue is full.
+		/// </summary>
+		bool TryPush(T& item)
+		{
+			size_t tail = tail_.load(std::memory_order_relaxed);
+			if (tail - head_.load(std::memory_order_acquire) == slots_.size())
+				return false;
+			slots_[tail & mask_] = std::move(item);
+			tail_.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		/// <summary>
+		/// Consumer only.  Moves the oldest item out of the queue and returns true, or returns false if the queue is empty.
+		/// </summary>
+		bool TryPop(T& item)
+		{
+			size_t head = head_.load(std::memory_order_relaxed);
+			if (head == tail_.load(std::memory_order_acquire))
+				return false;
+			item = std::move(slots_[head & mask_]);
+			// Leave nothing behind in the slot; items may hold references to large buffers.
+			slots_[head & mask_] = T();
+			head_.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		/// <summary>
+		/// Consumer only.  A producer may add items at any time, so the queue can be non-empty by the time the caller acts on a true result.
+		/// </summary>
+		bool empty() const { return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire); }
+
+	private:
+		std::vector<T> slots_;
+		size_t mask_;
+		// Padded onto separate cache lines so the two threads do not invalidate each other's line on every operation.  Padding
+		// rather than alignas, which would make every object containing a queue over-aligned.
+		char padding0_[64];
+		std::atomic<size_t> head_;
+		char padding1_[64 - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> tail_;
+		char padding2_[64 - sizeof(std::atomic<size_t>)];
+	};
+}
\ No newline at end of file
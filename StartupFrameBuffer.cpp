@@ -0,0 +1,102 @@
+#include "StartupFrameBuffer.h"
+
+namespace PnaclPlayer
+{
+	StartupFrameBuffer::StartupFrameBuffer(int64_t maxBytes) : bytes_(0), maxBytes_(maxBytes), skippedFrames_(0)
+	{
+	}
+
+	StartupFrameBuffer::~StartupFrameBuffer()
+	{
+	}
+
+	void StartupFrameBuffer::Add(int32_t stream, const EncodedFrame& frame)
+	{
+		Entry entry = { stream, frame };
+		H264FrameInfo info;
+		entry.frame.Classify(info);
+		uint8_t generation = entry.frame.generation();
+		if (HasNewerKeyframe(stream, generation))
+		{
+			// The page has switched this stream to another camera, and playback will start with that one.
+			skippedFrames_++;
+			return;
+		}
+		entries_.push_back(entry);
+		bytes_ += frame.size;
+		if (entry.frame.keyframe())
+		{
+			// Drop the stream's frames from before this keyframe, but not its parameter sets or the frames of a newer generation.
+			size_t keyframe = entries_.size() - 1;
+			size_t runStart = KeyframeRunStart(keyframe);
+			size_t i = 0;
+			for (std::deque<Entry>::iterator it = entries_.begin(); i < keyframe; i++)
+			{
+				int8_t age = (int8_t)(it->frame.generation() - generation);
+				if (it->stream != stream || age > 0 || (age == 0 && i >= runStart))
+					++it;
+				else
+					it = Erase(it);
+			}
+		}
+		while (bytes_ > maxBytes_ && entries_.size() > 1)
+		{
+			// Dropping part of a GOP would leave frames that cannot be decoded, so drop the oldest stream's frames up to its next keyframe.
+			int32_t oldest = entries_.front().stream;
+			size_t end = entries_.size();
+			for (size_t i = 0; i < entries_.size(); i++)
+			{
+				if (entries_[i].stream == oldest && entries_[i].frame.keyframe() && KeyframeRunStart(i) > 0)
+				{
+					end = KeyframeRunStart(i);
+					break;
+				}
+			}
+			size_t i = 0;
+			for (std::deque<Entry>::iterator it = entries_.begin(); i < end; i++)
+				it = it->stream == oldest ? Erase(it) : it + 1;
+		}
+	}
+
+	bool StartupFrameBuffer::HasNewerKeyframe(int32_t stream, uint8_t generation) const
+	{
+		for (size_t i = 0; i < entries_.size(); i++)
+		{
+			const Entry& entry = entries_[i];
+			if (entry.stream == stream && entry.frame.keyframe() && (int8_t)(entry.frame.generation() - generation) > 0)
+				return true;
+		}
+		return false;
+	}
+
+	size_t StartupFrameBuffer::KeyframeRunStart(size_t keyframe) const
+	{
+		int32_t stream = entries_[keyframe].stream;
+		uint8_t generation = entries_[keyframe].frame.generation();
+		size_t start = keyframe;
+		for (size_t i = keyframe; i-- > 0;)
+		{
+			const EncodedFrame& frame = entries_[i].frame;
+			if (entries_[i].stream != stream || frame.generation() != generation)
+				continue;
+			if (!frame.parameterSets() || frame.keyframe())
+				break;
+			start = i;
+		}
+		return start;
+	}
+
+	std::deque<StartupFrameBuffer::Entry>::iterator StartupFrameBuffer::Erase(std::deque<Entry>::iterator it)
+	{
+		bytes_ -= it->frame.size;
+		skippedFrames_++;
+		return entries_.erase(it);
+	}
+
+	void StartupFrameBuffer::TakeAll(std::deque<Entry>& entries)
+	{
+		entries.swap(entries_);
+		entries_.clear();
+		bytes_ = 0;
+	}
+}
\ No newline at end of file
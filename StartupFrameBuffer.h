@@ -0,0 +1,67 @@
+#pragma once
+#include "EncodedFrame.h"
+#include <deque>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Holds the frames that arrive before the player has created its streams, so that playback can start as soon as the decoders
+	/// are ready rather than at the first keyframe after that.  Only the frames from each stream's most recent keyframe on are kept:
+	/// whatever came before it is not needed to decode anything after it, and starting at the newest keyframe shows the newest video.
+	/// </summary>
+	class StartupFrameBuffer
+	{
+	public:
+		/// <summary>
+		/// Frames held are limited to maxBytes in total.  To stay under it, the stream with the oldest frame loses its frames up to its
+		/// next keyframe, or all of them if it has none, so no stream is left with frames that cannot be decoded.
+		/// </summary>
+		StartupFrameBuffer(int64_t maxBytes);
+		~StartupFrameBuffer();
+
+		/// <summary>
+		/// A frame of a stream, in arrival order.
+		/// </summary>
+		struct Entry
+		{
+			int32_t stream;
+			EncodedFrame frame;
+		};
+
+		/// <summary>
+		/// Holds a frame, classifying it (see EncodedFrame::Classify) so the decoder need not parse it again.  If it starts with an IDR
+		/// picture, the stream's earlier frames are discarded, except for frames of newer generations and for parameter sets of its own
+		/// generation sent in frames of their own just before it.  Frames of a generation older than a keyframe held for the stream are discarded on arrival.
+		/// </summary>
+		void Add(int32_t stream, const EncodedFrame& frame);
+		/// <summary>
+		/// Hands over every frame held, in arrival order, and empties the buffer.  The counters are kept.
+		/// </summary>
+		void TakeAll(std::deque<Entry>& entries);
+
+		bool empty() const { return entries_.empty(); }
+		/// <summary>Frames discarded so far, for a newer keyframe or to stay under the byte limit.</summary>
+		int64_t skippedFrames() const { return skippedFrames_; }
+
+		/// <summary>
+		/// Enough for a few seconds of a 1080p GOP.
+		/// </summary>
+		static const int64_t kDefaultMaxBytes = 8 * 1024 * 1024;
+
+	private:
+		/// <summary>
+		/// Returns the index of the first entry of the keyframe at |keyframe|: the first of the parameter set frames of its stream and
+		/// generation just before it, if any.
+		/// </summary>
+		size_t KeyframeRunStart(size_t keyframe) const;
+		bool HasNewerKeyframe(int32_t stream, uint8_t generation) const;
+		/// <summary>
+		/// Discards an entry, counting it as skipped.  Returns the iterator to the entry after it.
+		/// </summary>
+		std::deque<Entry>::iterator Erase(std::deque<Entry>::iterator it);
+
+		std::deque<Entry> entries_;
+		int64_t bytes_;
+		int64_t maxBytes_;
+		int64_t skippedFrames_;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "VideoStream.h"
+#include "pnacl_player.h"
+
+namespace PnaclPlayer
+{
+	VideoStream::VideoStream(pnacl_player* player, int32_t id, GraphicsContext* context, int hwaccel, size_t paintQueueCapacity) : decoder(NULL), standby(NULL), scheduler(NULL), pendingPictures(paintQueueCapacity), renderCompletePending(false), lastShownUs(0), lastShownPresentationTime(0), player_(player), id_(id), context_(context), hwaccel_(hwaccel), backlogLimitMs_(0), backlogLimitBytes_(0), queueHighBytes_(0), queueLowBytes_(0), paused_(false), idleFlushMs_(0), switching_(false), generation_(0), switchGeneration_(0), staleFrames_(0), switchStart_(0), alive_(new bool(true))
+	{
+		decoder = new Decoder(player, id, context, hwaccel);
+		decoder->SetQueueChangedFunc(std::bind(&VideoStream::UpdateFlowControl, this));
+		scheduler = new RenderScheduler(this);
+	}
+
+	VideoStream::~VideoStream()
+	{
+		// Frames live in the decoder's frame pool and hold pictures lent out by the decoder, so release them all before the decoder goes away.
+		ReleaseFrames();
+		delete scheduler;
+		delete standby;
+		delete decoder;
+	}
+
+	void VideoStream::ReleaseFrames()
+	{
+		currentlyRenderingFrame.reset();
+		displayedFrame.reset();
+		while (!pendingPictures.empty())
+			pendingPictures.PopFront();
+		renderCompletePending = false;
+	}
+
+	void VideoStream::CreateStandby()
+	{
+		if (standby)
+			return;
+		standby = new Decoder(player_, id_, context_, hwaccel_);
+		standby->SetQueueChangedFunc(std::bind(&VideoStream::UpdateFlowControl, this));
+		standby->SetBacklogLimits(backlogLimitMs_, backlogLimitBytes_);
+		standby->SetIdleFlush(idleFlushMs_);
+	}
+
+	void VideoStream::BeginSwitch()
+	{
+		BeginSwitch(generation_);
+	}
+
+	void VideoStream::BeginSwitch(uint8_t generation)
+	{
+		CreateStandby();
+		if (switching_)
+			standby->Reset(); // Switching again before the previous switch completed.  Only the newest stream matters, even if the standby is still initializing.
+		standby->SkipToKeyframe();
+		switching_ = true;
+		switchGeneration_ = generation;
+		switchStart_ = perfNow();
+	}
+
+	void VideoStream::CancelSwitch()
+	{
+		if (!switching_)
+			return;
+		switching_ = false;
+		standby->Reset(); // Clears the queue whether or not the standby has finished initializing.
+	}
+
+	bool VideoStream::AcceptPicture(const DecodedFrame* frame)
+	{
+		if (frame->decoder == decoder)
+			return true;
+		if (!switching_ || frame->decoder != standby)
+			return false;
+		CompleteSwitch();
+		return true;
+	}
+
+	void VideoStream::CompleteSwitch()
+	{
+		// Everything the old decoder produced that has not been painted yet is older than the new stream's first picture.  The
+		// picture on screen (and the one waiting for SwapBuffers) stays until the new picture replaces it.
+		scheduler->Reset();
+		while (!pendingPictures.empty())
+			player_->frameDropFunc(pendingPictures.PopFront(), false);
+		std::swap(decoder, standby);
+		switching_ = false;
+		generation_ = switchGeneration_;
+		// The old decoder becomes the standby for the next switch.  Resetting it makes its outstanding frames stale and leaves it ready to pre-roll,
+		// even if it is still resetting or being replaced after an error.
+		standby->Reset();
+
+		std::stringstream sstm;
+		sstm << "sw {" // Stream switched
+			<< "\"s\":" << id_
+			<< ",\"ms\":" << (perfNow() - switchStart_)
+			<< ",\"stale\":" << staleFrames_
+			<< " }";
+		PostString(sstm.str());
+	}
+
+	void VideoStream::ReceiveFrame(EncodedFrame frame)
+	{
+		uint8_t generation = frame.generation();
+		if (switching_ && generation == switchGeneration_)
+			standby->ReceiveFrame(frame);
+		else if (generation == generation_)
+			decoder->ReceiveFrame(frame);
+		else if ((int8_t)(generation - (switching_ ? switchGeneration_ : generation_)) > 0)
+		{
+			BeginSwitch(generation);
+			standby->ReceiveFrame(frame);
+		}
+		else
+			staleFrames_++; // Left over from a stream we already switched away from, or were switching to.
+	}
+
+	void VideoStream::SetBacklogLimits(int64_t maxMs, int64_t maxBytes)
+	{
+		backlogLimitMs_ = maxMs;
+		backlogLimitBytes_ = maxBytes;
+		decoder->SetBacklogLimits(maxMs, maxBytes);
+		if (standby)
+			standby->SetBacklogLimits(maxMs, maxBytes);
+	}
+
+	void VideoStream::SetQueueBudget(int64_t highBytes, int64_t lowBytes)
+	{
+		queueHighBytes_ = highBytes;
+		queueLowBytes_ = lowBytes < highBytes ? lowBytes : highBytes;
+		UpdateFlowControl();
+	}
+
+	void VideoStream::UpdateFlowControl()
+	{
+		int64_t bytes = decoder->queuedBytes();
+		size_t frames = decoder->encodedFrameQueue.size();
+		if (standby)
+		{
+			bytes += standby->queuedBytes();
+			frames += standby->encodedFrameQueue.size();
+		}
+		if (bytes > queueStats_.peakBytes)
+			queueStats_.peakBytes = bytes;
+		const char* state;
+		if (paused_)
+		{
+			if (queueHighBytes_ > 0 && bytes > queueLowBytes_)
+				return;
+			paused_ = false;
+			queueStats_.resumes++;
+			state = "resume";
+		}
+		else
+		{
+			if (queueHighBytes_ <= 0 || bytes <= queueHighBytes_)
+				return;
+			paused_ = true;
+			queueStats_.pauses++;
+			state = "pause";
+		}
+
+		std::stringstream sstm;
+		sstm << "fc {" // Flow control
+			<< "\"s\":" << id_
+			<< ",\"state\":\"" << state << "\""
+			<< ",\"bytes\":" << bytes
+			<< ",\"frames\":" << frames
+			<< " }";
+		PostString(sstm.str());
+	}
+
+	void VideoStream::SetIdleFlush(int32_t ms)
+	{
+		idleFlushMs_ = ms;
+		decoder->SetIdleFlush(ms);
+		if (standby)
+			standby->SetIdleFlush(ms);
+	}
+
+	int64_t VideoStream::perfNow()
+	{
+		return player_->perfNow();
+	}
+
+	void VideoStream::frameRenderFunc(DecodedFramePtr frame)
+	{
+		// The frame is now the player's responsibility.
+		player_->PaintPicture(this, std::move(frame));
+	}
+
+	void VideoStream::frameDropFunc(DecodedFramePtr frame, bool reportToClient)
+	{
+		player_->frameDropFunc(std::move(frame), reportToClient);
+	}
+
+	void VideoStream::CallDelayedPaintAfterDelay(int32_t delay_in_milliseconds, int32_t result)
+	{
+		std::weak_ptr<bool> alive(alive_);
+		player_->platform()->CallOnMainThread(delay_in_milliseconds, [this, alive](int32_t result)
+		{
+			if (!alive.expired())
+				DelayedPaint(result);
+		}, result);
+	}
+
+	void VideoStream::PostString(std::string message)
+	{
+		player_->PostString(message);
+	}
+
+	void VideoStream::DelayedPaint(int32_t result)
+	{
+		scheduler->DelayedPaint(result);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+#include "Platform.h"
+#include "Decoder.h"
+#include "DecodedFrame.h"
+#include "RenderScheduler.h"
+#include "FrameRing.h"
+
+#include <memory>
+
+namespace PnaclPlayer
+{
+	class pnacl_player;
+
+	/// <summary>
+	/// Counters for the bytes waiting to be decoded for a stream and the flow control messages sent about them.
+	/// </summary>
+	struct QueueStats
+	{
+		QueueStats() : peakBytes(0), pauses(0), resumes(0) {}
+		int64_t peakBytes;
+		int64_t pauses;
+		int64_t resumes;
+	};
+
+	/// <summary>
+	/// One video stream shown by the player: its decoder, its render scheduler, and the pictures waiting to be drawn in its cell of the wall.
+	/// </summary>
+	class VideoStream : public RenderSchedulerClient
+	{
+	public:
+		VideoStream(pnacl_player* player, int32_t id, GraphicsContext* context, int hwaccel, size_t paintQueueCapacity);
+		virtual ~VideoStream();
+
+		/// <summary>
+		/// The stream id used to route ingest messages.  Also the id of the stream's Decoder.
+		/// </summary>
+		int32_t id() const { return id_; }
+
+		/// <summary>
+		/// Releases every frame this stream holds outside its scheduler.
+		/// </summary>
+		void ReleaseFrames();
+
+		/// <summary>
+		/// Creates and initializes the standby decoder now, if it does not exist yet, so that a later BeginSwitch does not have to wait for it.
+		/// </summary>
+		void CreateStandby();
+		/// <summary>
+		/// Starts a seamless switch to a new stream whose frames are not marked with a new generation.  Frames received from now on
+		/// go to the standby decoder, starting at the first keyframe, while the current decoder plays out what it already has.
+		/// </summary>
+		void BeginSwitch();
+		/// <summary>
+		/// Abandons a switch in progress, discarding whatever the standby decoder has received.
+		/// </summary>
+		void CancelSwitch();
+		/// <summary>
+		/// True between BeginSwitch and the first picture of the new stream.
+		/// </summary>
+		bool switching() const { return switching_; }
+		/// <summary>
+		/// Called with every picture decoded for this stream.  Completes a switch in progress if the picture is the new stream's first.
+		/// Returns false if the picture belongs to a stream that is no longer shown and should be dropped.
+		/// </summary>
+		bool AcceptPicture(const DecodedFrame* frame);
+		/// <summary>
+		/// Passes a frame received from the browser to the right decoder by its generation.  A frame of a newer generation than the
+		/// current one starts a seamless switch: it and the rest of its generation go to the standby decoder, starting at the first
+		/// keyframe, while frames of the current generation keep playing.  The switch completes when the standby decoder produces
+		/// its first picture, and from then on frames of older generations are discarded.
+		/// </summary>
+		void ReceiveFrame(EncodedFrame frame);
+		/// <summary>
+		/// Sets the live catch-up limits of both decoders.  See Decoder::SetBacklogLimits.
+		/// </summary>
+		void SetBacklogLimits(int64_t maxMs, int64_t maxBytes);
+		/// <summary>
+		/// Enables flow control of the frames waiting to be decoded, counting the queues of both decoders, since the standby decoder
+		/// receives frames under the same stream id.  When they come to hold more than highBytes, the stream tells the browser to
+		/// pause sending it; when they drop to lowBytes or less, it tells it to resume.  A highBytes of 0 or less disables flow
+		/// control, sending a resume first if the stream is paused.
+		/// </summary>
+		void SetQueueBudget(int64_t highBytes, int64_t lowBytes);
+		const QueueStats& queueStats() const { return queueStats_; }
+		/// <summary>
+		/// Sets the idle flush interval of both decoders.  See Decoder::SetIdleFlush.
+		/// </summary>
+		void SetIdleFlush(int32_t ms);
+
+		// RenderSchedulerClient implementation.
+		virtual int64_t perfNow();
+		virtual void frameRenderFunc(DecodedFramePtr frame);
+		virtual void frameDropFunc(DecodedFramePtr frame, bool reportToClient);
+		virtual void CallDelayedPaintAfterDelay(int32_t delay_in_milliseconds, int32_t result);
+		virtual void PostString(std::string message);
+
+		// Owned data.
+		Decoder* decoder;
+		// Decoder that pre-rolls the next stream during a seamless switch.  NULL until first needed.  Its pictures share this stream's scheduler once it is promoted.
+		Decoder* standby;
+		RenderScheduler* scheduler;
+		// Pictures go into this queue when they are received from the scheduler.
+		FrameRing pendingPictures;
+		// The picture drawn in the refresh that is waiting for SwapBuffers to complete.
+		DecodedFramePtr currentlyRenderingFrame;
+		// In a wall, the last picture shown for this stream.  It is drawn again whenever another cell changes.
+		DecodedFramePtr displayedFrame;
+		// Set while the scheduler is owed a RenderComplete call for currentlyRenderingFrame.
+		bool renderCompletePending;
+		// When the last frame of this stream finished painting (microseconds, or 0 if none has), and its presentation time.  For the judder stats.
+		int64_t lastShownUs;
+		int64_t lastShownPresentationTime;
+
+	private:
+		void DelayedPaint(int32_t result);
+		void BeginSwitch(uint8_t generation);
+		void CompleteSwitch();
+		/// <summary>
+		/// Sends a pause or resume message if the bytes queued in both decoders have crossed a watermark.  Called whenever either queue changes.
+		/// </summary>
+		void UpdateFlowControl();
+
+		pnacl_player* player_;
+		int32_t id_;
+		GraphicsContext* context_;
+		int hwaccel_;
+		int64_t backlogLimitMs_;
+		int64_t backlogLimitBytes_;
+		int64_t queueHighBytes_;
+		int64_t queueLowBytes_;
+		bool paused_;
+		QueueStats queueStats_;
+		int32_t idleFlushMs_;
+		bool switching_;
+		// Generation of the frames going to the decoder, and during a switch, of the frames going to the standby decoder.
+		uint8_t generation_;
+		uint8_t switchGeneration_;
+		// Frames discarded because their generation was already replaced.  Reported with each switch.
+		int64_t staleFrames_;
+		// perfNow() when the switch in progress began.
+		int64_t switchStart_;
+		// Pending DelayedPaint callbacks hold a weak reference to this, so they do nothing once the stream has been removed.
+		std::shared_ptr<bool> alive_;
+	};
+}
\ No newline at end of file
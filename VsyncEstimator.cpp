@@ -0,0 +1,112 @@
+#include "VsyncEstimator.h"
+
+#include <math.h>
+
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Refresh periods outside this range (in milliseconds; 240 Hz to 24 Hz) are not believed.
+	/// </summary>
+	static const double kMinPeriodMs = 4;
+	static const double kMaxPeriodMs = 42;
+	/// <summary>
+	/// An interval fits if it is within this fraction of a period of a whole number of periods.
+	/// </summary>
+	static const double kFitFraction = 0.2;
+	/// <summary>
+	/// Intervals longer than this many periods (the player was idle) only move the phase, because they say little about the period.
+	/// </summary>
+	static const double kMaxPeriodsPerInterval = 8;
+	static const double kPeriodGain = 1.0 / 8;
+	/// <summary>
+	/// Completion callbacks run a little after the refresh, by however long the main thread was busy, so the phase follows them slowly.
+	/// </summary>
+	static const double kPhaseGain = 1.0 / 4;
+
+	VsyncEstimator::VsyncEstimator()
+	{
+		Reset();
+	}
+
+	void VsyncEstimator::Reset()
+	{
+		haveLast_ = false;
+		lastSwap_ = 0;
+		phase_ = 0;
+		period_ = 0;
+		fits_ = 0;
+	}
+
+	void VsyncEstimator::AddSwapComplete(double nowMs)
+	{
+		if (!haveLast_)
+		{
+			haveLast_ = true;
+			lastSwap_ = nowMs;
+			phase_ = nowMs;
+			return;
+		}
+		double interval = nowMs - lastSwap_;
+		lastSwap_ = nowMs;
+		if (interval <= 0)
+			return;
+
+		if (period_ <= 0)
+		{
+			// The first interval is a guess, good if the player was painting back to back.
+			if (interval >= kMinPeriodMs && interval <= kMaxPeriodMs)
+				period_ = interval;
+			phase_ = nowMs;
+			return;
+		}
+
+		double periods = floor(interval / period_ + 0.5);
+		if (periods < 1 && interval >= kMinPeriodMs)
+		{
+			// Two swaps closer together than one period: the estimate was a multiple of the real period.
+			period_ = interval;
+			fits_ = 0;
+			phase_ = nowMs;
+			return;
+		}
+		double predicted = phase_ + floor((nowMs - phase_) / period_ + 0.5) * period_;
+		if (fabs(interval - periods * period_) <= period_ * kFitFraction)
+		{
+			if (periods <= kMaxPeriodsPerInterval)
+			{
+				period_ += (interval / periods - period_) * kPeriodGain;
+				fits_++;
+			}
+			phase_ = predicted + (nowMs - predicted) * kPhaseGain;
+			return;
+		}
+		// Does not fit.  If it fits half or a third of the period, the estimate was a multiple of the real period.  Otherwise start over from this interval.
+		fits_ = 0;
+		phase_ = nowMs;
+		for (int divisor = 2; divisor <= 3; divisor++)
+		{
+			double candidate = period_ / divisor;
+			if (candidate < kMinPeriodMs)
+				break;
+			double candidatePeriods = floor(interval / candidate + 0.5);
+			if (fabs(interval - candidatePeriods * candidate) <= candidate * kFitFraction)
+			{
+				period_ = candidate;
+				return;
+			}
+		}
+		if (interval >= kMinPeriodMs && interval <= kMaxPeriodMs)
+			period_ = interval;
+	}
+
+	double VsyncEstimator::NearestVsync(double timeMs) const
+	{
+		return phase_ + floor((timeMs - phase_) / period_ + 0.5) * period_;
+	}
+
+	double VsyncEstimator::NextVsync(double timeMs) const
+	{
+		double earliest = timeMs + period_ / 4;
+		return phase_ + ceil((earliest - phase_) / period_) * period_;
+	}
+}
\ No newline at end of file
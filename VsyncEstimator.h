@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Estimates the display's refresh period and phase from the times SwapBuffers completes.  The browser completes a swap when
+	/// the compositor takes the frame, which happens on vsync, so the intervals between completions are whole numbers of refresh
+	/// periods.  The period is refined from every interval that fits the current estimate; an interval that does not fit means the
+	/// estimate is a multiple of the real period (seen only when every frame was held for several refreshes), and it is divided.
+	/// </summary>
+	class VsyncEstimator
+	{
+	public:
+		VsyncEstimator();
+		~VsyncEstimator() {}
+
+		void Reset();
+
+		/// <summary>
+		/// Records that a SwapBuffers completed at the given time, in milliseconds on the perfNow clock.
+		/// </summary>
+		void AddSwapComplete(double nowMs);
+
+		/// <summary>True once enough swaps have fit the estimate to schedule by it.</summary>
+		bool locked() const { return fits_ >= kLockAfter; }
+		/// <summary>The refresh period in milliseconds, or 0 if not known yet.</summary>
+		double periodMs() const { return period_; }
+		/// <summary>
+		/// Returns the refresh nearest to the given time.  Call only when locked.
+		/// </summary>
+		double NearestVsync(double timeMs) const;
+		/// <summary>
+		/// Returns the first refresh that a paint started at the given time can still make: the first one more than a quarter of a period away.  Call only when locked.
+		/// </summary>
+		double NextVsync(double timeMs) const;
+
+	private:
+		/// <summary>Intervals that fit the estimate before it is used.</summary>
+		static const int32_t kLockAfter = 4;
+
+		bool haveLast_;
+		double lastSwap_;
+		// Time of a recent refresh, filtered, as the phase of the refresh grid.
+		double phase_;
+		double period_;
+		int32_t fits_;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+// Small helpers shared by the host benchmarks.
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace PnaclPlayer
+{
+	namespace Bench
+	{
+		/// <summary>
+		/// Returns the nearest-rank percentile (0-100) of the values.  Sorts the vector in place.  Returns 0 for an empty vector.
+		/// </summary>
+		inline double Percentile(std::vector<double>& values, double percentile)
+		{
+			if (values.empty())
+				return 0;
+			std::sort(values.begin(), values.end());
+			size_t rank = (size_t)(percentile / 100 * values.size() + 0.5);
+			if (rank < 1)
+				rank = 1;
+			if (rank > values.size())
+				rank = values.size();
+			return values[rank - 1];
+		}
+
+		inline double Mean(const std::vector<double>& values)
+		{
+			if (values.empty())
+				return 0;
+			double sum = 0;
+			for (size_t i = 0; i < values.size(); i++)
+				sum += values[i];
+			return sum / values.size();
+		}
+
+		/// <summary>
+		/// Minimal "--name value" command line reader.  Unknown arguments are ignored.
+		/// </summary>
+		class Args
+		{
+		public:
+			Args(int argc, char* argv[]) : argc_(argc), argv_(argv) {}
+			const char* Get(const char* name, const char* fallback) const
+			{
+				for (int i = 1; i + 1 < argc_; i++)
+					if (strcmp(argv_[i], name) == 0)
+						return argv_[i + 1];
+				return fallback;
+			}
+			double GetDouble(const char* name, double fallback) const
+			{
+				const char* value = Get(name, NULL);
+				return value ? atof(value) : fallback;
+			}
+			bool Has(const char* name) const
+			{
+				for (int i = 1; i < argc_; i++)
+					if (strcmp(argv_[i], name) == 0)
+						return true;
+				return false;
+			}
+
+		private:
+			int argc_;
+			char** argv_;
+		};
+	}
+}
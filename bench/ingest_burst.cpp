@@ -0,0 +1,263 @@
+// Paint-callback latency under ingest bursts, with messages handled on the main thread and with threaded ingest.
+//
+// Runs in real time, with a real main thread and a real ingest thread around the player's IngestQueue.  A paint callback
+// runs every --paint-ms on the main thread and records how late it started.  Every --burst-ms the "browser" delivers a
+// burst of --burst framed messages, one frame each (an IDR of --idr-kb every --gop frames, otherwise --p-kb), as after a
+// network stall.  Each message costs a copy of its payload where it is received (the ArrayBuffer coming out of IPC), and
+// each frame costs the main thread a classification and a copy of its bitstream (what pp::VideoDecoder::Decode does).
+//
+//   main:   every message is a main-thread task queued ahead of the paint callback, as without the ingest thread.
+//   thread: messages are received on the ingest thread; the main thread drains the queue a few frames per task.
+//
+// Two measures are reported for each paint: how late it started by the wall clock, and how much CPU time the main thread
+// spent on other tasks between the paint coming due and starting.  The second is the work that stood in the paint's way.
+// It does not depend on how many cores the machine has, whereas the first only improves with threaded ingest if the
+// ingest thread gets a core of its own.
+//
+// Usage:
+//   ingest_burst [--seconds 5] [--paint-ms 16] [--burst 60] [--burst-ms 500] [--gop 30] [--idr-kb 200] [--p-kb 40]
+
+#include "BenchUtil.h"
+#include "FramedMessage.h"
+#include "H264Parser.h"
+#include "HostPlatform.h"
+#include "IngestQueue.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace PnaclPlayer;
+
+namespace
+{
+	double NowMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// <summary>
+	/// CPU time used by the calling thread, in milliseconds.
+	/// </summary>
+	double ThreadCpuMs()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+	}
+
+	/// <summary>
+	/// Platform whose main thread is a real thread running a real-time task queue.  CallOnMainThread is thread-safe; nothing else is used.
+	/// </summary>
+	class RealtimePlatform : public Platform
+	{
+	public:
+		RealtimePlatform() : stopped_(false) {}
+
+		virtual double GetTimeTicks() { return NowMs() / 1000; }
+		virtual void CallOnMainThread(int32_t delay_in_milliseconds, const PlatformCallback& callback, int32_t result)
+		{
+			Post(delay_in_milliseconds, [callback, result]() { callback(result); });
+		}
+		virtual void PostString(const std::string& message) {}
+		virtual void PostBinary(const void* data, uint32_t size) {}
+		virtual void LogToConsole(bool isError, const std::string& message) {}
+		virtual GraphicsContext* CreateGraphicsContext(int32_t width, int32_t height) { return NULL; }
+		virtual VideoDecoderBackend* CreateVideoDecoder(GraphicsContext* context) { return NULL; }
+
+		/// <summary>
+		/// Queues a task from any thread.  Tasks due at the same time run in the order they were posted.
+		/// </summary>
+		void Post(double delay_in_milliseconds, const std::function<void()>& task)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			tasks_.insert(std::make_pair(NowMs() + delay_in_milliseconds, task));
+			wake_.notify_one();
+		}
+		/// <summary>
+		/// Runs tasks on the calling thread, which becomes the main thread, until Stop is called.
+		/// </summary>
+		void Run()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			taskEnds_.push_back(std::make_pair(NowMs(), ThreadCpuMs()));
+			while (!stopped_)
+			{
+				if (tasks_.empty())
+				{
+					wake_.wait(lock);
+					continue;
+				}
+				double due = tasks_.begin()->first;
+				double now = NowMs();
+				if (due > now)
+				{
+					wake_.wait_for(lock, std::chrono::duration<double, std::milli>(due - now));
+					continue;
+				}
+				std::function<void()> task = tasks_.begin()->second;
+				tasks_.erase(tasks_.begin());
+				lock.unlock();
+				task();
+				taskEnds_.push_back(std::make_pair(NowMs(), ThreadCpuMs()));
+				lock.lock();
+			}
+		}
+		/// <summary>
+		/// Main thread only.  CPU time the main thread has spent on tasks since the given wall clock time.
+		/// </summary>
+		double CpuSince(double time)
+		{
+			// Find the CPU total as of the last task that finished before the time.
+			std::vector<std::pair<double, double>>::const_iterator it = std::upper_bound(taskEnds_.begin(), taskEnds_.end(), std::make_pair(time, 1e300));
+			double before = it == taskEnds_.begin() ? 0 : (it - 1)->second;
+			return ThreadCpuMs() - before;
+		}
+		void Stop()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopped_ = true;
+			wake_.notify_one();
+		}
+
+	private:
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::multimap<double, std::function<void()>> tasks_;
+		bool stopped_;
+		// Wall clock time and main thread CPU total at the end of every task.
+		std::vector<std::pair<double, double>> taskEnds_;
+	};
+
+	struct Options
+	{
+		double seconds;
+		double paintMs;
+		int burst;
+		double burstMs;
+		int gop;
+		uint32_t idrBytes;
+		uint32_t pBytes;
+	};
+
+	struct Result
+	{
+		std::vector<double> lateness;
+		std::vector<double> blockedCpu;
+		int64_t frames;
+	};
+
+	Result Run(const Options& options, bool threaded)
+	{
+		RealtimePlatform platform;
+		Result result;
+		result.frames = 0;
+		// Stands in for the shared memory buffer pp::VideoDecoder::Decode copies each frame into.
+		std::vector<uint8_t> decodeBuffer(options.idrBytes);
+		IngestQueue ingest(&platform, [&](IngestItem& item)
+		{
+			H264FrameInfo info;
+			H264Parser::ParseFrame((const uint8_t*)item.frame.data(), item.frame.size, info);
+			memcpy(&decodeBuffer[0], item.frame.data(), item.frame.size);
+			result.frames++;
+		});
+		ingest.SetThreaded(threaded);
+
+		// The frames as they come off the network, framed and ready to copy into a "received" buffer.
+		std::vector<std::vector<uint8_t>> wire;
+		for (int i = 0; i < options.gop; i++)
+		{
+			uint32_t size = i == 0 ? options.idrBytes : options.pBytes;
+			std::vector<uint8_t> message(FramedMessageReader::kMagicSize + FramedMessageReader::kHeaderSize + size, 0x5A);
+			FramedMessageHeader header;
+			header.timestamp = 0;
+			header.length = size;
+			header.flags = i == 0 ? ENCODED_FRAME_KEYFRAME : 0;
+			header.stream = 0;
+			memcpy(&message[0], "pnf1", FramedMessageReader::kMagicSize);
+			memcpy(&message[FramedMessageReader::kMagicSize], &header, FramedMessageReader::kHeaderSize);
+			uint8_t* nal = &message[FramedMessageReader::kMagicSize + FramedMessageReader::kHeaderSize];
+			nal[0] = 0;
+			nal[1] = 0;
+			nal[2] = 1;
+			nal[3] = i == 0 ? 0x65 : 0x41;
+			wire.push_back(message);
+		}
+
+		double start = NowMs();
+		double end = start + options.seconds * 1000;
+		std::function<void(double)> paint = [&](double due)
+		{
+			double now = NowMs();
+			result.lateness.push_back(now - due);
+			result.blockedCpu.push_back(platform.CpuSince(due));
+			if (now >= end)
+			{
+				platform.Stop();
+				return;
+			}
+			double next = due + options.paintMs;
+			platform.Post(next - now, [&paint, next]() { paint(next); });
+		};
+		platform.Post(options.paintMs, [&paint, start, &options]() { paint(start + options.paintMs); });
+
+		// The browser side.  Delivers each burst either to the ingest thread or as tasks on the main thread.
+		std::thread browser([&]()
+		{
+			int64_t sent = 0;
+			for (double next = start + options.burstMs / 2; next < end; next += options.burstMs)
+			{
+				std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(next))));
+				for (int i = 0; i < options.burst; i++, sent++)
+				{
+					const std::vector<uint8_t>& message = wire[sent % wire.size()];
+					if (threaded)
+						ingest.HandleMessage(ByteBufferPtr(new HostByteBuffer(&message[0], (uint32_t)message.size())));
+					else
+						platform.Post(0, [&ingest, &message]() { ingest.HandleMessage(ByteBufferPtr(new HostByteBuffer(&message[0], (uint32_t)message.size()))); });
+				}
+			}
+		});
+		platform.Run();
+		browser.join();
+		return result;
+	}
+
+	void Report(const char* name, const char* measure, std::vector<double>& values, int64_t frames)
+	{
+		double mean = Bench::Mean(values);
+		double p50 = Bench::Percentile(values, 50);
+		double p99 = Bench::Percentile(values, 99);
+		double max = values.empty() ? 0 : values.back();
+		printf("%-8s  %-11s  %8zu  %10.3f  %10.3f  %10.3f  %10.3f  %8lld\n", name, measure, values.size(), mean, p50, p99, max, (long long)frames);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Bench::Args args(argc, argv);
+	Options options;
+	options.seconds = args.GetDouble("--seconds", 5);
+	options.paintMs = args.GetDouble("--paint-ms", 16);
+	options.burst = (int)args.GetDouble("--burst", 60);
+	options.burstMs = args.GetDouble("--burst-ms", 500);
+	options.gop = (int)args.GetDouble("--gop", 30);
+	options.idrBytes = (uint32_t)(args.GetDouble("--idr-kb", 200) * 1024);
+	options.pBytes = (uint32_t)(args.GetDouble("--p-kb", 40) * 1024);
+
+	printf("paint callback delay (ms)\n");
+	printf("%-8s  %-11s  %8s  %10s  %10s  %10s  %10s  %8s\n", "ingest", "measure", "paints", "mean", "p50", "p99", "max", "frames");
+	const char* names[] = { "main", "thread" };
+	for (int threaded = 0; threaded < 2; threaded++)
+	{
+		Result result = Run(options, threaded != 0);
+		Report(names[threaded], "wall late", result.lateness, result.frames);
+		Report(names[threaded], "blocked cpu", result.blockedCpu, result.frames);
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+// Cost and accuracy of LatencyHistogram, which the player fills in for every painted frame.
+//
+// Records --count durations drawn from a log-normal distribution around --median-us, then reports:
+//   * the time per LatencyHistogram::Record and per FrameLatencyStats::Record (seven histograms, one painted frame), and
+//   * the histogram's percentiles against the exact nearest-rank percentiles of the same values.
+//
+// Usage:
+//   latency_bench [--count 1000000] [--median-us 20000] [--spread 1.0] [--seed 1]
+
+#include "BenchUtil.h"
+#include "FrameLatencyStats.h"
+#include "LatencyHistogram.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <random>
+
+using namespace PnaclPlayer;
+
+namespace
+{
+	double SecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Bench::Args args(argc, argv);
+	int count = (int)args.GetDouble("--count", 1000000);
+	double medianUs = args.GetDouble("--median-us", 20000);
+	double spread = args.GetDouble("--spread", 1.0);
+	std::mt19937 random((uint32_t)args.GetDouble("--seed", 1));
+	std::lognormal_distribution<double> distribution(log(medianUs), spread);
+
+	std::vector<int64_t> values(count);
+	for (int i = 0; i < count; i++)
+		values[i] = (int64_t)distribution(random);
+
+	LatencyHistogram histogram;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; i++)
+		histogram.Record(values[i]);
+	double recordSeconds = SecondsSince(start);
+
+	// Stage times for a frame that spends a share of its values[i] in each stage.
+	std::vector<FrameStageTimes> frames(count);
+	for (int i = 0; i < count; i++)
+	{
+		FrameStageTimes& times = frames[i];
+		int64_t step = values[i] / 8;
+		times.received = (int64_t)i * 1000;
+		times.queued = times.received + step;
+		times.submitted = times.queued + step;
+		times.decoded = times.submitted + 2 * step;
+		times.scheduled = times.decoded + 2 * step;
+		times.drawn = times.scheduled + step;
+	}
+	FrameLatencyStats stats;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; i++)
+		stats.Record(frames[i], frames[i].drawn + values[i] / 8);
+	double frameSeconds = SecondsSince(start);
+
+	printf("LatencyHistogram::Record:  %6.2f ns\n", recordSeconds * 1e9 / count);
+	printf("FrameLatencyStats::Record: %6.2f ns per frame (%d stages)\n", frameSeconds * 1e9 / count, (int)LATENCY_STAGE_COUNT);
+
+	std::vector<double> exact(values.begin(), values.end());
+	const double percentiles[] = { 50, 90, 99, 99.9, 100 };
+	double worstError = 0;
+	for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+	{
+		double expected = Bench::Percentile(exact, percentiles[i]);
+		double actual = (double)histogram.Percentile(percentiles[i]);
+		double error = expected > 0 ? fabs(actual - expected) / expected : 0;
+		if (error > worstError)
+			worstError = error;
+		printf("p%-5g exact %10.0f us, histogram %10.0f us (%+.2f%%)\n", percentiles[i], expected, actual, expected > 0 ? (actual - expected) * 100 / expected : 0);
+	}
+	printf("worst error: %.2f%%\n", worstError * 100);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+// Throughput benchmark for H264Parser.
+//
+// Builds a synthetic Annex-B stream (an IDR with SPS/PPS every --gop frames, P frames in between, random slice data with
+// emulation prevention applied so it contains no accidental start codes), then:
+//   * counts every start code in the stream with a byte-at-a-time loop and with H264Parser::FindStartCode, and
+//   * classifies every frame with H264Parser::ParseFrame, as the decoder does on ingest.
+//
+// Usage:
+//   nal_bench [--frames 300] [--gop 30] [--idr-kb 200] [--p-kb 25] [--reps 20] [--seed 1]
+
+#include "BenchUtil.h"
+#include "H264Parser.h"
+
+#include <stdio.h>
+
+#include <chrono>
+
+using namespace PnaclPlayer;
+
+namespace
+{
+	// 1920x1080 High profile level 4.0, as written by x264.
+	const uint8_t kSps[] = { 0x67, 0x64, 0x00, 0x28, 0xAC, 0xD9, 0x40, 0x78, 0x02, 0x27, 0xE5, 0xC0, 0x44, 0x00, 0x00, 0x03, 0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0xF0, 0x3C, 0x60, 0xC6, 0x58 };
+	const uint8_t kPps[] = { 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0 };
+
+	struct Frame
+	{
+		size_t offset;
+		size_t size;
+		bool idr;
+	};
+
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	void AppendNal(std::vector<uint8_t>& stream, const uint8_t* nal, size_t size, bool longStartCode)
+	{
+		static const uint8_t kStartCode[] = { 0, 0, 0, 1 };
+		stream.insert(stream.end(), kStartCode + (longStartCode ? 0 : 1), kStartCode + 4);
+		stream.insert(stream.end(), nal, nal + size);
+	}
+
+	/// <summary>
+	/// Appends a slice NAL unit with random payload.  Zero bytes are as common as in real CABAC data, and an emulation prevention byte is inserted wherever the encoder would insert one.
+	/// </summary>
+	void AppendSlice(std::vector<uint8_t>& stream, bool idr, size_t size, uint32_t& random)
+	{
+		static const uint8_t kStartCode[] = { 0, 0, 1 };
+		stream.insert(stream.end(), kStartCode, kStartCode + 3);
+		stream.push_back(idr ? 0x65 : 0x41);
+		int zeros = 0;
+		for (size_t i = 0; i < size; i++)
+		{
+			uint8_t b = (uint8_t)NextRandom(random);
+			if (zeros >= 2 && b <= 3)
+			{
+				stream.push_back(3);
+				zeros = 0;
+			}
+			stream.push_back(b);
+			zeros = b == 0 ? zeros + 1 : 0;
+		}
+		// rbsp_trailing_bits, so the slice never ends in a zero byte.
+		stream.push_back(0x80);
+	}
+
+	size_t CountStartCodesBytewise(const uint8_t* p, const uint8_t* end)
+	{
+		size_t count = 0;
+		for (; end - p >= 3; p++)
+			if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+				count++;
+		return count;
+	}
+
+	size_t CountStartCodes(const uint8_t* p, const uint8_t* end)
+	{
+		size_t count = 0;
+		while ((p = H264Parser::FindStartCode(p, end)) != end)
+		{
+			count++;
+			p += 3;
+		}
+		return count;
+	}
+
+	double SecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Bench::Args args(argc, argv);
+	int frames = (int)args.GetDouble("--frames", 300);
+	int gop = (int)args.GetDouble("--gop", 30);
+	size_t idrBytes = (size_t)(args.GetDouble("--idr-kb", 200) * 1024);
+	size_t pBytes = (size_t)(args.GetDouble("--p-kb", 25) * 1024);
+	int reps = (int)args.GetDouble("--reps", 20);
+	uint32_t random = (uint32_t)args.GetDouble("--seed", 1);
+	if (random == 0)
+		random = 1;
+
+	std::vector<uint8_t> stream;
+	std::vector<Frame> frameList;
+	size_t expectedStartCodes = 0;
+	for (int i = 0; i < frames; i++)
+	{
+		Frame frame;
+		frame.offset = stream.size();
+		frame.idr = i % gop == 0;
+		if (frame.idr)
+		{
+			AppendNal(stream, kSps, sizeof(kSps), true);
+			AppendNal(stream, kPps, sizeof(kPps), true);
+			expectedStartCodes += 2;
+		}
+		AppendSlice(stream, frame.idr, frame.idr ? idrBytes : pBytes, random);
+		expectedStartCodes++;
+		frame.size = stream.size() - frame.offset;
+		frameList.push_back(frame);
+	}
+	const uint8_t* begin = &stream[0];
+	const uint8_t* end = begin + stream.size();
+	double megabytes = stream.size() / (1024.0 * 1024.0);
+	printf("stream: %d frames, %.1f MB, %zu start codes\n", frames, megabytes, expectedStartCodes);
+
+	size_t bytewiseCount = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; r++)
+		bytewiseCount += CountStartCodesBytewise(begin, end);
+	double bytewiseSeconds = SecondsSince(start);
+
+	size_t swarCount = 0;
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; r++)
+		swarCount += CountStartCodes(begin, end);
+	double swarSeconds = SecondsSince(start);
+
+	if (bytewiseCount != expectedStartCodes * reps || swarCount != expectedStartCodes * reps)
+	{
+		fprintf(stderr, "start code counts disagree: expected %zu, bytewise %zu, FindStartCode %zu\n", expectedStartCodes * reps, bytewiseCount, swarCount);
+		return 1;
+	}
+	printf("start code scan, bytewise:      %8.0f MB/s\n", megabytes * reps / bytewiseSeconds);
+	printf("start code scan, FindStartCode: %8.0f MB/s (%.1fx)\n", megabytes * reps / swarSeconds, bytewiseSeconds / swarSeconds);
+
+	int idrFound = 0;
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; r++)
+	{
+		for (size_t i = 0; i < frameList.size(); i++)
+		{
+			H264FrameInfo info;
+			H264Parser::ParseFrame(begin + frameList[i].offset, frameList[i].size, info);
+			if (info.idr() != frameList[i].idr || (info.idr() && (!info.hasSps || info.sps.width != 1920 || info.sps.height != 1080)))
+			{
+				fprintf(stderr, "frame %zu misclassified\n", i);
+				return 1;
+			}
+			idrFound += info.idr();
+		}
+	}
+	double parseSeconds = SecondsSince(start);
+	printf("ParseFrame:                     %8.0f ns/frame (%d IDR frames found)\n", parseSeconds * 1e9 / (frameList.size() * reps), idrFound / reps);
+	return 0;
+}
\ No newline at end of file
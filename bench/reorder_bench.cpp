@@ -0,0 +1,140 @@
+// Microbenchmark for RenderScheduler's frame queue: FrameReorderBuffer against the vector + std::sort + erase(begin()) it replaced.
+//
+// At each queue depth the queue is filled, then every operation inserts one frame and dequeues the oldest, so the depth stays
+// constant.  About one frame in ten arrives swapped with its neighbour to exercise the out-of-order path.  Frames come from a
+// DecodedFramePool as they do in the player.  Heap allocations made during the timed loop are counted to show that the ring
+// and the pool never allocate in steady state.
+//
+// Usage:
+//   reorder_bench [--ops 2000000]
+
+#include "BenchUtil.h"
+#include "DecodedFramePool.h"
+#include "FrameReorderBuffer.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <new>
+
+using namespace PnaclPlayer;
+
+namespace
+{
+	int64_t g_allocations = 0;
+}
+
+void* operator new(size_t size)
+{
+	g_allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace
+{
+	/// <summary>
+	/// The queue RenderScheduler used before FrameReorderBuffer.
+	/// </summary>
+	class SortedVectorQueue
+	{
+	public:
+		SortedVectorQueue(size_t capacity) {}
+		size_t size() const { return frames_.size(); }
+		void Insert(DecodedFramePtr frame)
+		{
+			frames_.push_back(std::move(frame));
+			std::sort(frames_.begin(), frames_.end(), Compare);
+		}
+		DecodedFramePtr PopFront()
+		{
+			DecodedFramePtr oldest = std::move(frames_.front());
+			frames_.erase(frames_.begin());
+			return oldest;
+		}
+
+	private:
+		static bool Compare(const DecodedFramePtr& a, const DecodedFramePtr& b) { return a->timestamp < b->timestamp; }
+		std::vector<DecodedFramePtr> frames_;
+	};
+
+	struct Result
+	{
+		double nsPerOp;
+		int64_t allocations;
+		int64_t checksum;
+	};
+
+	/// <summary>
+	/// Timestamp of the n-th frame: 33 ms apart, with every 10th pair swapped.
+	/// </summary>
+	int64_t TimestampOf(int64_t n)
+	{
+		if (n % 10 == 0)
+			n++;
+		else if (n % 10 == 1)
+			n--;
+		return n * 33;
+	}
+
+	template <class Queue>
+	Result Run(size_t depth, int64_t ops)
+	{
+		DecodedFramePool pool(NULL, 128);
+		VideoPicture picture = VideoPicture();
+		Queue queue(64);
+		int64_t sequence = 0;
+		for (size_t i = 0; i < depth; i++)
+			queue.Insert(pool.Acquire(picture, 0, TimestampOf(sequence++)));
+		int64_t checksum = 0;
+		int64_t allocationsBefore = g_allocations;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int64_t i = 0; i < ops; i++)
+		{
+			queue.Insert(pool.Acquire(picture, 0, TimestampOf(sequence++)));
+			checksum += queue.PopFront()->timestamp;
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		Result result;
+		result.allocations = g_allocations - allocationsBefore;
+		result.nsPerOp = std::chrono::duration<double, std::nano>(end - start).count() / ops;
+		result.checksum = checksum;
+		while (queue.size())
+			queue.PopFront();
+		return result;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Bench::Args args(argc, argv);
+	int64_t ops = (int64_t)args.GetDouble("--ops", 2000000);
+
+	printf("%6s  %16s  %16s  %8s  %12s\n", "depth", "sort+erase ns/op", "reorder ns/op", "speedup", "allocs");
+	const size_t depths[] = { 2, 4, 8, 16, 32, 64 };
+	for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+	{
+		size_t depth = depths[d];
+		// The ring must have room for one more frame than the depth, because each operation inserts before it dequeues.
+		size_t ringDepth = depth < 64 ? depth : 63;
+		Result before = Run<SortedVectorQueue>(depth, ops);
+		Result after = Run<FrameReorderBuffer>(ringDepth, ops);
+		printf("%6zu  %16.1f  %16.1f  %7.1fx  %12lld\n", depth, before.nsPerOp, after.nsPerOp, before.nsPerOp / after.nsPerOp, (long long)after.allocations);
+		if (depth == ringDepth && before.checksum != after.checksum)
+		{
+			fprintf(stderr, "queues disagree at depth %zu\n", depth);
+			return 1;
+		}
+	}
+	return 0;
+}
\ No newline at end of file
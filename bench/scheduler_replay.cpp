@@ -0,0 +1,305 @@
+// Deterministic replay benchmark for RenderScheduler.
+//
+// Feeds decoded frames into a RenderScheduler on HostPlatform's virtual clock, either from a recorded arrival trace or from a
+// synthetic camera stream with network jitter and stalls, and models the paint stage the way pnacl_player does.  Because time
+// is virtual, two runs with the same input produce identical output, so scheduler changes can be compared exactly.
+//
+// Trace files have one frame per line: "<arrival_ms> <timestamp_ms>", where arrival is local time (for example performance.now()
+// when the frame reached the page) and timestamp is the camera's presentation timestamp.  Lines starting with '#' are ignored.
+//
+// Usage:
+//   scheduler_replay [--trace file] [--frames 3000] [--fps 30] [--jitter 8] [--stall-every 10] [--stall-ms 400]
+//                    [--reorder] [--seed 1] [--decode-ms 4] [--render-ms 3] [--jitter-buffer fixed|lowlatency|smooth]
+//                    [--pts-noise 0] [--missing-pts] [--fps-change-at 0 --fps2 15] [--refresh-hz 0] [--no-vsync] [--drift-ppm 0]
+//                    [--clock-jump-ms 100]
+//
+// --pts-noise adds normally distributed noise (standard deviation in ms) to the synthetic timestamps, as a camera that stamps frames
+// when they leave its encoder rather than when they were captured.  --missing-pts sends every frame with timestamp 0.  --fps-change-at
+// switches the synthetic camera to --fps2 after that many frames.  Presentation jitter is measured against the capture times, so
+// it shows how well the scheduler keeps the camera's cadence when the timestamps do not.  --drift-ppm makes the camera's clock run
+// that many parts per million fast against local time.  --clock-jump-ms sets RenderScheduler's clock jump threshold; 0 jumps the
+// clock for every overfull queue and late frame instead of slewing it.
+//
+// --refresh-hz models a display: a paint is shown, and completes, at the first refresh after --render-ms, and the scheduler aligns
+// presentation to the refreshes it measures from those completions (unless --no-vsync).  Presentation jitter is then judder.
+
+#include "BenchUtil.h"
+#include "HostPlatform.h"
+#include "RenderScheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <deque>
+#include <random>
+
+using namespace PnaclPlayer;
+
+namespace
+{
+	struct TraceFrame
+	{
+		double arrivalMs;
+		int64_t timestamp;
+		/// <summary>When the camera captured the frame, on the timestamp clock.  The timestamp itself for a recorded trace.</summary>
+		double capture;
+	};
+
+	bool LoadTrace(const char* path, std::vector<TraceFrame>& trace)
+	{
+		FILE* file = fopen(path, "r");
+		if (!file)
+			return false;
+		char line[256];
+		while (fgets(line, sizeof(line), file))
+		{
+			if (line[0] == '#')
+				continue;
+			TraceFrame frame;
+			long long timestamp;
+			if (sscanf(line, "%lf %lld", &frame.arrivalMs, &timestamp) == 2)
+			{
+				frame.timestamp = timestamp;
+				frame.capture = (double)timestamp;
+				trace.push_back(frame);
+			}
+		}
+		fclose(file);
+		return true;
+	}
+
+	/// <summary>
+	/// A camera producing frames at a fixed rate, delivered with normally distributed network delay and periodic stalls during which nothing arrives.
+	/// </summary>
+	void GenerateTrace(const Bench::Args& args, std::vector<TraceFrame>& trace)
+	{
+		int64_t frames = (int64_t)args.GetDouble("--frames", 3000);
+		double fps = args.GetDouble("--fps", 30);
+		double jitter = args.GetDouble("--jitter", 8);
+		double stallEvery = args.GetDouble("--stall-every", 10) * 1000;
+		double stallMs = args.GetDouble("--stall-ms", 400);
+		bool reorder = args.Has("--reorder");
+		double ptsNoise = args.GetDouble("--pts-noise", 0);
+		bool missingPts = args.Has("--missing-pts");
+		int64_t fpsChangeAt = (int64_t)args.GetDouble("--fps-change-at", 0);
+		double fps2 = args.GetDouble("--fps2", 15);
+		double drift = 1 + args.GetDouble("--drift-ppm", 0) / 1e6;
+		std::mt19937 rng((uint32_t)args.GetDouble("--seed", 1));
+		std::normal_distribution<double> delay(20, jitter);
+		std::normal_distribution<double> noise(0, ptsNoise > 0 ? ptsNoise : 1);
+
+		double interval = 1000 / fps;
+		double lastArrival = 0;
+		double capture = 0;
+		for (int64_t i = 0; i < frames; i++)
+		{
+			if (i > 0)
+				capture += fpsChangeAt > 0 && i > fpsChangeAt ? 1000 / fps2 : interval;
+			double arrival = capture + std::max(0.0, delay(rng));
+			if (stallEvery > 0 && stallMs > 0)
+			{
+				double phase = fmod(arrival, stallEvery);
+				if (arrival >= stallEvery && phase < stallMs)
+					arrival += stallMs - phase; // Held back until the stall ends, then delivered in a burst.
+			}
+			if (!reorder)
+				arrival = std::max(arrival, lastArrival); // A TCP connection delivers in order.
+			lastArrival = arrival;
+			TraceFrame frame;
+			frame.arrivalMs = arrival;
+			frame.capture = capture;
+			if (missingPts)
+				frame.timestamp = 0;
+			else
+				frame.timestamp = (int64_t)floor(capture * drift + (ptsNoise > 0 ? noise(rng) : 0) + 0.5);
+			trace.push_back(frame);
+		}
+	}
+
+	/// <summary>
+	/// Owns the RenderScheduler and plays the part of pnacl_player: paints one frame at a time, keeping up to 8 more queued and dropping the oldest beyond that.
+	/// </summary>
+	class ReplayClient : public RenderSchedulerClient
+	{
+	public:
+		ReplayClient(HostPlatform* platform, double renderMs, double refreshHz) : scheduler(this), paintQueueDrops(0), platform_(platform), renderMs_(renderMs), refreshHz_(refreshHz) {}
+
+		virtual int64_t perfNow() { return (int64_t)(platform_->GetTimeTicks() * 1000); }
+		virtual void frameRenderFunc(DecodedFramePtr frame)
+		{
+			const size_t N = 8;
+			if (pending_.size() >= N)
+			{
+				paintQueueDrops++;
+				pending_.pop_front();
+			}
+			pending_.push_back(std::move(frame));
+			if (!painting_)
+				PaintNext();
+		}
+		virtual void frameDropFunc(DecodedFramePtr frame, bool reportToClient) {}
+		virtual void CallDelayedPaintAfterDelay(int32_t delay_in_milliseconds, int32_t result)
+		{
+			platform_->CallOnMainThread(delay_in_milliseconds, std::bind(&RenderScheduler::DelayedPaint, &scheduler, std::placeholders::_1), result);
+		}
+		virtual void PostString(std::string message) {}
+
+		RenderScheduler scheduler;
+		/// <summary>Presentation time (ms) of each trace frame, indexed like the trace, or -1 if never presented.</summary>
+		std::vector<double> presentedAt;
+		/// <summary>Trace indices in the order they were presented.</summary>
+		std::vector<uint32_t> presentationOrder;
+		int64_t paintQueueDrops;
+		VsyncEstimator vsync;
+
+	private:
+		void PaintNext()
+		{
+			if (pending_.empty())
+				return;
+			painting_ = std::move(pending_.front());
+			pending_.pop_front();
+			scheduler.lastRenderStarted = perfNow();
+			double delay = renderMs_;
+			if (refreshHz_ > 0)
+			{
+				double period = 1000 / refreshHz_;
+				double now = platform_->NowMs();
+				delay = ceil((now + delay) / period) * period - now;
+			}
+			platform_->PostTask(delay, std::bind(&ReplayClient::PaintFinished, this, std::placeholders::_1), PLATFORM_OK);
+		}
+		void PaintFinished(int32_t result)
+		{
+			scheduler.lastRenderDuration = (int32_t)(perfNow() - scheduler.lastRenderStarted);
+			vsync.AddSwapComplete(platform_->NowMs());
+			uint32_t index = painting_->picture.decode_id;
+			presentedAt[index] = platform_->NowMs();
+			presentationOrder.push_back(index);
+			painting_.reset();
+			scheduler.RenderComplete();
+			if (!painting_)
+				PaintNext();
+		}
+
+		HostPlatform* platform_;
+		double renderMs_;
+		double refreshHz_;
+		DecodedFramePtr painting_;
+		std::deque<DecodedFramePtr> pending_;
+	};
+
+	void PrintPercentiles(const char* name, std::vector<double> values)
+	{
+		double mean = Bench::Mean(values);
+		printf("%-26s mean %8.2f  p50 %8.2f  p90 %8.2f  p99 %8.2f  max %8.2f\n", name, mean,
+			Bench::Percentile(values, 50), Bench::Percentile(values, 90), Bench::Percentile(values, 99), Bench::Percentile(values, 100));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Bench::Args args(argc, argv);
+	std::vector<TraceFrame> trace;
+	const char* tracePath = args.Get("--trace", NULL);
+	if (tracePath)
+	{
+		if (!LoadTrace(tracePath, trace))
+		{
+			fprintf(stderr, "could not read %s\n", tracePath);
+			return 1;
+		}
+	}
+	else
+		GenerateTrace(args, trace);
+	if (trace.empty())
+	{
+		fprintf(stderr, "empty trace\n");
+		return 1;
+	}
+	double decodeMs = args.GetDouble("--decode-ms", 4);
+	double renderMs = args.GetDouble("--render-ms", 3);
+
+	// Frames reach the scheduler in arrival order, one decode latency later.
+	std::vector<uint32_t> order(trace.size());
+	for (uint32_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return trace[a].arrivalMs < trace[b].arrivalMs; });
+
+	HostPlatform platform;
+	double refreshHz = args.GetDouble("--refresh-hz", 0);
+	ReplayClient client(&platform, renderMs, refreshHz);
+	if (refreshHz > 0 && !args.Has("--no-vsync"))
+		client.scheduler.SetVsync(&client.vsync);
+	client.scheduler.SetClockJumpThreshold((int32_t)args.GetDouble("--clock-jump-ms", RenderScheduler::kDefaultClockJumpThresholdMs));
+	std::string mode = args.Get("--jitter-buffer", "fixed");
+	if (mode == "lowlatency")
+		client.scheduler.SetJitterBufferMode(JITTER_BUFFER_LOW_LATENCY);
+	else if (mode == "smooth")
+		client.scheduler.SetJitterBufferMode(JITTER_BUFFER_SMOOTH);
+	else if (mode != "fixed")
+	{
+		fprintf(stderr, "unknown --jitter-buffer %s\n", mode.c_str());
+		return 1;
+	}
+	client.presentedAt.assign(trace.size(), -1);
+	double base = trace[order[0]].arrivalMs;
+	std::vector<double> queueDepths;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		uint32_t index = order[i];
+		platform.RunUntil(trace[index].arrivalMs - base + decodeMs);
+		VideoPicture picture = VideoPicture();
+		picture.decode_id = index;
+		client.scheduler.AddFrame(DecodedFramePtr(new DecodedFrame(NULL, picture, 0, trace[index].timestamp)));
+		queueDepths.push_back(client.scheduler.stats.queueDepth);
+	}
+	platform.RunUntilIdle();
+
+	// Glass-to-glass latency needs the capture time in local time, which a trace does not have.  Align the camera clock so the
+	// fastest frame had zero network delay; the result is latency above the best case the network ever delivered.
+	double minTransit = 1e300;
+	for (size_t i = 0; i < trace.size(); i++)
+		minTransit = std::min(minTransit, trace[i].arrivalMs - base - trace[i].capture);
+
+	std::vector<double> arrivalToPresent;
+	std::vector<double> glassToGlass;
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		if (client.presentedAt[i] < 0)
+			continue;
+		arrivalToPresent.push_back(client.presentedAt[i] - (trace[i].arrivalMs - base));
+		glassToGlass.push_back(client.presentedAt[i] - (trace[i].capture + minTransit));
+	}
+	// Presentation jitter: how far each on-screen interval deviates from the interval between the two frames' capture times.
+	std::vector<double> jitter;
+	int64_t outOfOrder = 0;
+	for (size_t i = 1; i < client.presentationOrder.size(); i++)
+	{
+		uint32_t a = client.presentationOrder[i - 1];
+		uint32_t b = client.presentationOrder[i];
+		if (trace[b].capture < trace[a].capture)
+			outOfOrder++;
+		double shown = client.presentedAt[b] - client.presentedAt[a];
+		double expected = trace[b].capture - trace[a].capture;
+		jitter.push_back(fabs(shown - expected));
+	}
+
+	const RenderSchedulerStats& stats = client.scheduler.stats;
+	printf("frames in trace            %lld\n", (long long)trace.size());
+	printf("frames presented           %lld\n", (long long)client.presentationOrder.size());
+	printf("dropped by scheduler       %lld\n", (long long)stats.framesDropped);
+	printf("dropped by paint queue     %lld\n", (long long)client.paintQueueDrops);
+	printf("presented out of order     %lld\n", (long long)outOfOrder);
+	printf("clock jumps ahead          %lld (%lld ms total)\n", (long long)stats.clockJumps, (long long)stats.clockJumpTotal);
+	printf("clock rollbacks            %lld (%lld ms total)\n", (long long)stats.clockRollbacks, (long long)stats.clockRollbackTotal);
+	printf("clock rate                 %.4f (drift %.0f ppm)\n", stats.clockRate, stats.clockDriftPpm);
+	printf("frame interval             %.2f ms (%lld cadence changes)\n", stats.frameIntervalMs, (long long)stats.cadenceChanges);
+	if (refreshHz > 0)
+		printf("refresh                    %.2f ms measured, %lld frames superseded\n", client.vsync.locked() ? client.vsync.periodMs() : 0, (long long)stats.framesSuperseded);
+	PrintPercentiles("glass-to-glass ms", glassToGlass);
+	PrintPercentiles("arrival-to-present ms", arrivalToPresent);
+	PrintPercentiles("presentation jitter ms", jitter);
+	PrintPercentiles("jitter buffer depth", queueDepths);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+// Replays a message trace recorded by the player ("record start" / "record stop", or pnacl_player_host --trace)
+// through the real player on HostPlatform's virtual clock.  Every string and ArrayBuffer is handed to the player at its
+// recorded arrival time, divided by --speed, so bursts, reorders, resets and resolution changes seen in the field can be
+// reproduced and compared between builds.  The trace file is memory-mapped and frames are decoded straight out of the mapping.
+//
+// Reports frames rendered and dropped, the player's per-stage latency stats, and the wall-clock time the replay took.
+//
+// Usage:
+//   trace_replay --trace file [--speed 1] [--decode-ms 4] [--swap-ms 16] [--width 1280] [--height 720]
+//                [--attrs name=value,name=value] (embed attributes, e.g. paintqueue=2,ingestthread=1)
+
+#include "BenchUtil.h"
+#include "HostPlatform.h"
+#include "MessageTrace.h"
+#include "pnacl_player.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace PnaclPlayer;
+
+namespace
+{
+	/// <summary>
+	/// A message payload inside the mapped trace.  The mapping is private, so the player could even write to it without changing the file.
+	/// </summary>
+	class MappedByteBuffer : public ByteBuffer
+	{
+	public:
+		MappedByteBuffer(const uint8_t* data, uint32_t size) : data_(const_cast<uint8_t*>(data)), size_(size) {}
+		virtual ~MappedByteBuffer() {}
+		virtual uint32_t ByteLength() { return size_; }
+		virtual void* Map() { return data_; }
+
+	private:
+		uint8_t* data_;
+		uint32_t size_;
+	};
+
+	/// <summary>
+	/// Splits "name=value,name=value" into embed attribute names and values.
+	/// </summary>
+	void ParseAttributes(const std::string& attrs, std::vector<std::string>& names, std::vector<std::string>& values)
+	{
+		size_t position = 0;
+		while (position < attrs.size())
+		{
+			size_t end = attrs.find(',', position);
+			if (end == std::string::npos)
+				end = attrs.size();
+			std::string pair = attrs.substr(position, end - position);
+			size_t equals = pair.find('=');
+			if (equals != std::string::npos)
+			{
+				names.push_back(pair.substr(0, equals));
+				values.push_back(pair.substr(equals + 1));
+			}
+			position = end + 1;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Bench::Args args(argc, argv);
+	const char* path = args.Get("--trace", NULL);
+	if (!path)
+	{
+		fprintf(stderr, "usage: trace_replay --trace file [--speed 1] [--decode-ms 4] [--swap-ms 16] [--width 1280] [--height 720] [--attrs name=value,...]\n");
+		return 1;
+	}
+	double speed = args.GetDouble("--speed", 1);
+	if (speed <= 0)
+	{
+		fprintf(stderr, "--speed must be positive\n");
+		return 1;
+	}
+
+	int fd = open(path, O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		fprintf(stderr, "cannot read %s\n", path);
+		return 1;
+	}
+	size_t size = (size_t)info.st_size;
+	void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		fprintf(stderr, "cannot map %s\n", path);
+		return 1;
+	}
+	MessageTraceReader reader(mapping, size);
+	int64_t messages = reader.Validate();
+	if (messages < 0)
+	{
+		fprintf(stderr, "%s is not a valid message trace\n", path);
+		return 1;
+	}
+
+	HostConfig config;
+	config.decodeLatencyMs = args.GetDouble("--decode-ms", config.decodeLatencyMs);
+	config.swapLatencyMs = args.GetDouble("--swap-ms", config.swapLatencyMs);
+	HostPlatform platform(config);
+	int64_t rendered = 0;
+	int64_t dropped = 0;
+	std::string latencyReport;
+	platform.messageHandler = [&](const std::string& message)
+	{
+		if (message.compare(0, 3, "rf ") == 0)
+			rendered++;
+		else if (message.compare(0, 3, "df ") == 0)
+			dropped++;
+		else if (message.compare(0, 3, "st ") == 0)
+			latencyReport = message;
+	};
+
+	std::vector<std::string> names(1, "hwaccel");
+	std::vector<std::string> values(1, "1");
+	ParseAttributes(args.Get("--attrs", ""), names, values);
+	std::vector<const char*> argn;
+	std::vector<const char*> argv2;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		argn.push_back(names[i].c_str());
+		argv2.push_back(values[i].c_str());
+	}
+	pnacl_player* player = new pnacl_player(&platform);
+	player->Init((uint32_t)argn.size(), &argn[0], &argv2[0]);
+	player->DidChangeView((int32_t)args.GetDouble("--width", 1280), (int32_t)args.GetDouble("--height", 720));
+	platform.RunUntilIdle();
+	bool ingestThreaded = player->ingestThreaded();
+
+	std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+	double start = platform.NowMs();
+	int64_t bytes = 0;
+	MessageTraceRecord record;
+	const uint8_t* payload;
+	while (reader.Next(record, payload))
+	{
+		platform.RunUntil(start + record.arrival / 1000.0 / speed);
+		if (record.type == TRACE_STRING)
+		{
+			std::string message((const char*)payload, record.length);
+			if (ingestThreaded)
+				player->HandleMessageOnIngestThread(message);
+			else
+				player->HandleMessage(message);
+		}
+		else
+		{
+			ByteBufferPtr buffer(new MappedByteBuffer(payload, record.length));
+			if (ingestThreaded)
+				player->HandleMessageOnIngestThread(buffer);
+			else
+				player->HandleMessage(buffer);
+			bytes += record.length;
+		}
+	}
+	platform.RunUntilIdle();
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+	player->HandleMessage(std::string("telemetry flush"));
+	player->HandleMessage(std::string("stats"));
+
+	printf("trace:           %s, %lld messages, %.1f MB of ArrayBuffers\n", path, (long long)messages, bytes / 1048576.0);
+	printf("speed:           %gx, %.1f ms of virtual time\n", speed, platform.NowMs() - start);
+	printf("frames rendered: %lld\n", (long long)rendered);
+	printf("frames dropped:  %lld\n", (long long)dropped);
+	printf("decodes:         %lld (stalls %lld)\n", (long long)platform.decoderStats.decodes, (long long)platform.decoderStats.stalls);
+	printf("latency (us):    %s\n", latencyReport.c_str());
+	printf("wall time:       %.1f ms (%.0f messages/s)\n", wallSeconds * 1000, wallSeconds > 0 ? messages / wallSeconds : 0);
+
+	delete player;
+	munmap(mapping, size);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "HostPlatform.h"
+#include "H264Parser.h"
+
+#include <math.h>
+
+#include <deque>
+#include <iostream>
+
+#include "pnacl_player_assert.h"
+
+namespace PnaclPlayer
+{
+	namespace
+	{
+		/// <summary>
+		/// Wraps a callback so it is silently dropped if the object owning |alive| has been deleted, like a CompletionCallbackFactory does.
+		/// </summary>
+		PlatformCallback Guard(const std::shared_ptr<bool>& alive, const PlatformCallback& callback)
+		{
+			std::weak_ptr<bool> weak(alive);
+			return [weak, callback](int32_t result)
+			{
+				if (!weak.expired())
+					callback(result);
+			};
+		}
+
+		/// <summary>
+		/// GraphicsContext that accepts and counts every call.  SwapBuffers completes after HostConfig::swapLatencyMs, or at the first refresh after that if HostConfig::refreshHz is set.
+		/// </summary>
+		class FakeGraphicsContext : public GraphicsContext
+		{
+		public:
+			FakeGraphicsContext(HostPlatform* platform) : platform_(platform), alive_(new bool(true)), nextName_(1) {}
+			virtual ~FakeGraphicsContext() {}
+
+			virtual int32_t ResizeBuffers(int32_t width, int32_t height)
+			{
+				platform_->glStats.resizes++;
+				return PLATFORM_OK;
+			}
+			virtual int32_t SwapBuffers(const PlatformCallback& callback)
+			{
+				platform_->glStats.swaps++;
+				double delay = platform_->config.swapLatencyMs;
+				if (platform_->config.refreshHz > 0)
+				{
+					double period = 1000 / platform_->config.refreshHz;
+					double now = platform_->NowMs();
+					delay = ceil((now + delay) / period) * period - now;
+				}
+				platform_->PostTask(delay, Guard(alive_, callback), PLATFORM_OK);
+				return PLATFORM_OK_COMPLETIONPENDING;
+			}
+
+			virtual GLenum GetError() { Count(); return GL_NO_ERROR; }
+			virtual void ClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha) { Count(); }
+			virtual void Clear(GLbitfield mask) { Count(); }
+			virtual void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) { Count(); }
+			virtual void GenBuffers(GLsizei n, GLuint* buffers)
+			{
+				Count();
+				for (GLsizei i = 0; i < n; i++)
+					buffers[i] = nextName_++;
+			}
+			virtual void BindBuffer(GLenum target, GLuint buffer) { Count(); }
+			virtual void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) { Count(); }
+			virtual GLuint CreateProgram() { Count(); return nextName_++; }
+			virtual void DeleteProgram(GLuint program) { Count(); }
+			virtual void LinkProgram(GLuint program) { Count(); }
+			virtual void UseProgram(GLuint program) { Count(); }
+			virtual GLuint CreateShader(GLenum type) { Count(); return nextName_++; }
+			virtual void ShaderSource(GLuint shader, GLsizei count, const char** str, const GLint* length) { Count(); }
+			virtual void CompileShader(GLuint shader) { Count(); }
+			virtual void AttachShader(GLuint program, GLuint shader) { Count(); }
+			virtual void DeleteShader(GLuint shader) { Count(); }
+			virtual GLint GetUniformLocation(GLuint program, const char* name) { Count(); return 0; }
+			virtual GLint GetAttribLocation(GLuint program, const char* name) { Count(); return 0; }
+			virtual void Uniform1i(GLint location, GLint x) { Count(); }
+			virtual void Uniform2f(GLint location, GLfloat x, GLfloat y) { Count(); }
+			virtual void EnableVertexAttribArray(GLuint index) { Count(); }
+			virtual void VertexAttribPointer(GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* ptr) { Count(); }
+			virtual void ActiveTexture(GLenum texture) { Count(); }
+			virtual void BindTexture(GLenum target, GLuint texture) { Count(); }
+			virtual void DrawArrays(GLenum mode, GLint first, GLsizei count) { Count(); platform_->glStats.drawCalls++; }
+
+		private:
+			void Count() { platform_->glStats.glCalls++; }
+
+			HostPlatform* platform_;
+			std::shared_ptr<bool> alive_;
+			GLuint nextName_;
+		};
+
+		/// <summary>
+		/// VideoDecoderBackend that "decodes" each buffer into one picture after HostConfig::decodeLatencyMs, in decode order.
+		/// Follows the pp::VideoDecoder contract for Reset and Flush, and stalls decoding while every picture buffer is held by the player.
+		/// Like a real decoder, it produces no pictures after Initialize or Reset until it sees an IDR, if the buffers are Annex-B H.264,
+		/// nor after a rejected buffer, nor for a buffer that holds only parameter sets.  Parameter sets are kept across Reset.
+		/// </summary>
+		class FakeVideoDecoder : public VideoDecoderBackend
+		{
+		public:
+			FakeVideoDecoder(HostPlatform* platform) : platform_(platform), alive_(new bool(true)), decodePending_(false), decodeComplete_(false), pendingDecodeId_(0), pendingHasPicture_(false), waitingForIdr_(true), decodeSerial_(0), stalled_(false), flushing_(false), failed_(false), haveSps_(false), havePps_(false)
+			{
+				for (int32_t i = 0; i < platform_->config.pictureCount; i++)
+					freeTextures_.push_back(1000 + i);
+			}
+			virtual ~FakeVideoDecoder() {}
+
+			virtual void Initialize(HardwareAcceleration hwaccel, const PlatformCallback& callback)
+			{
+				platform_->PostTask(platform_->config.initializeLatencyMs, Guard(alive_, callback), PLATFORM_OK);
+			}
+			virtual void Decode(uint32_t decode_id, uint32_t size, const void* buffer, const PlatformCallback& callback)
+			{
+				assert(!decodePending_);
+				platform_->decoderStats.decodes++;
+				if (failed_)
+				{
+					platform_->PostTask(0, Guard(alive_, callback), PLATFORM_ERROR_FAILED);
+					return;
+				}
+				int32_t errorEvery = platform_->config.decodeErrorEvery;
+				if (errorEvery > 0 && platform_->decoderStats.decodes % errorEvery == 0)
+				{
+					platform_->decoderStats.errors++;
+					int32_t result = platform_->config.decodeErrorResult;
+					if (result == PLATFORM_ERROR_BADARGUMENT)
+						waitingForIdr_ = true; // Later frames refer to the picture it would have made.
+					else
+						failed_ = true;
+					platform_->PostTask(platform_->config.decodeLatencyMs, Guard(alive_, callback), result);
+					return;
+				}
+				decodePending_ = true;
+				decodeComplete_ = false;
+				pendingDecodeId_ = decode_id;
+				H264FrameInfo info;
+				bool parsed = H264Parser::ParseFrame((const uint8_t*)buffer, size, info);
+				haveSps_ = haveSps_ || info.has(NAL_SPS);
+				havePps_ = havePps_ || info.has(NAL_PPS);
+				if (parsed && info.idr() && platform_->config.requireParameterSets && (!haveSps_ || !havePps_))
+				{
+					platform_->decoderStats.errors++;
+					decodePending_ = false;
+					failed_ = true;
+					platform_->PostTask(platform_->config.decodeLatencyMs, Guard(alive_, callback), PLATFORM_ERROR_FAILED);
+					return;
+				}
+				if (parsed && info.firstSliceType != 0)
+				{
+					if (info.idr())
+						waitingForIdr_ = false;
+					pendingHasPicture_ = !waitingForIdr_;
+				}
+				else
+					pendingHasPicture_ = !parsed;
+				decodeCallback_ = callback;
+				uint32_t serial = ++decodeSerial_;
+				platform_->PostTask(platform_->config.decodeLatencyMs, Guard(alive_, [this, serial](int32_t result)
+				{
+					if (serial != decodeSerial_)
+						return; // Aborted by Reset.
+					decodeComplete_ = true;
+					TryFinishDecode();
+				}), PLATFORM_OK);
+			}
+			virtual void GetPicture(const PictureCallback& callback)
+			{
+				assert(!pictureCallback_);
+				if (failed_)
+				{
+					VideoPicture empty = VideoPicture();
+					platform_->PostTask(0, Guard(alive_, [callback, empty](int32_t result) { callback(result, empty); }), PLATFORM_ERROR_FAILED);
+					return;
+				}
+				pictureCallback_ = callback;
+				TryDeliverPicture();
+			}
+			virtual void RecyclePicture(const VideoPicture& picture)
+			{
+				platform_->decoderStats.recycles++;
+				freeTextures_.push_back(picture.texture_id);
+				TryFinishDecode();
+			}
+			virtual void Flush(const PlatformCallback& callback)
+			{
+				platform_->decoderStats.flushes++;
+				if (failed_)
+				{
+					platform_->PostTask(0, Guard(alive_, callback), PLATFORM_ERROR_FAILED);
+					return;
+				}
+				flushing_ = true;
+				flushCallback_ = callback;
+				TryDeliverPicture();
+				TryFinishFlush();
+			}
+			virtual void Reset(const PlatformCallback& callback)
+			{
+				platform_->decoderStats.resets++;
+				if (failed_)
+				{
+					platform_->PostTask(0, Guard(alive_, callback), PLATFORM_ERROR_FAILED);
+					return;
+				}
+				decodeSerial_++;
+				waitingForIdr_ = true;
+				if (flushing_)
+				{
+					flushing_ = false;
+					RunLater(flushCallback_, PLATFORM_ERROR_ABORTED);
+				}
+				if (decodePending_)
+				{
+					decodePending_ = false;
+					RunLater(decodeCallback_, PLATFORM_ERROR_ABORTED);
+				}
+				AbortGetPicture();
+				while (!readyPictures_.empty())
+				{
+					freeTextures_.push_back(readyPictures_.front().texture_id);
+					readyPictures_.pop_front();
+				}
+				platform_->PostTask(platform_->config.resetLatencyMs, Guard(alive_, callback), PLATFORM_OK);
+			}
+
+		private:
+			void RunLater(PlatformCallback& slot, int32_t result)
+			{
+				PlatformCallback callback;
+				callback.swap(slot);
+				platform_->PostTask(0, Guard(alive_, callback), result);
+			}
+			void AbortGetPicture()
+			{
+				if (!pictureCallback_)
+					return;
+				PictureCallback callback;
+				callback.swap(pictureCallback_);
+				VideoPicture empty = VideoPicture();
+				platform_->PostTask(0, Guard(alive_, [callback, empty](int32_t result) { callback(result, empty); }), PLATFORM_ERROR_ABORTED);
+			}
+			void TryFinishDecode()
+			{
+				if (!decodePending_ || !decodeComplete_)
+					return;
+				if (!pendingHasPicture_)
+				{
+					platform_->decoderStats.discarded++;
+					decodePending_ = false;
+					RunLater(decodeCallback_, PLATFORM_OK);
+					TryFinishFlush();
+					return;
+				}
+				if (freeTextures_.empty())
+				{
+					if (!stalled_)
+						platform_->decoderStats.stalls++;
+					stalled_ = true;
+					return; // Resumed by RecyclePicture.
+				}
+				stalled_ = false;
+				VideoPicture picture = VideoPicture();
+				picture.decode_id = pendingDecodeId_;
+				picture.texture_id = freeTextures_.front();
+				picture.texture_target = GL_TEXTURE_2D;
+				picture.texture_size.width = platform_->config.pictureWidth;
+				picture.texture_size.height = platform_->config.pictureHeight;
+				picture.visible_rect.width = picture.texture_size.width;
+				picture.visible_rect.height = picture.texture_size.height;
+				freeTextures_.pop_front();
+				readyPictures_.push_back(picture);
+				platform_->decoderStats.pictures++;
+				decodePending_ = false;
+				RunLater(decodeCallback_, PLATFORM_OK);
+				TryDeliverPicture();
+				TryFinishFlush();
+			}
+			void TryDeliverPicture()
+			{
+				if (!pictureCallback_ || readyPictures_.empty())
+					return;
+				if (!flushing_ && readyPictures_.size() <= (size_t)platform_->config.reorderDepth)
+					return; // Held back until a later picture is decoded or the decoder is flushed.
+				PictureCallback callback;
+				callback.swap(pictureCallback_);
+				VideoPicture picture = readyPictures_.front();
+				readyPictures_.pop_front();
+				platform_->PostTask(0, Guard(alive_, [callback, picture](int32_t result) { callback(result, picture); }), PLATFORM_OK);
+				TryFinishFlush();
+			}
+			void TryFinishFlush()
+			{
+				if (!flushing_ || decodePending_ || !readyPictures_.empty())
+					return;
+				flushing_ = false;
+				AbortGetPicture();
+				RunLater(flushCallback_, PLATFORM_OK);
+			}
+
+			HostPlatform* platform_;
+			std::shared_ptr<bool> alive_;
+			std::deque<uint32_t> freeTextures_;
+			std::deque<VideoPicture> readyPictures_;
+			bool decodePending_;
+			bool decodeComplete_;
+			uint32_t pendingDecodeId_;
+			bool pendingHasPicture_;
+			bool waitingForIdr_;
+			uint32_t decodeSerial_;
+			bool stalled_;
+			bool flushing_;
+			bool failed_;
+			bool haveSps_;
+			bool havePps_;
+			PlatformCallback decodeCallback_;
+			PlatformCallback flushCallback_;
+			PictureCallback pictureCallback_;
+		};
+	}  // anonymous namespace
+
+	HostPlatform::HostPlatform(const HostConfig& config) : config(config), postedStrings(0), postedBinaries(0), postedBinaryBytes(0), now_(0)
+	{
+	}
+
+	HostPlatform::~HostPlatform()
+	{
+	}
+
+	void HostPlatform::CallOnMainThread(int32_t delay_in_milliseconds, const PlatformCallback& callback, int32_t result)
+	{
+		PostTask(delay_in_milliseconds, callback, result);
+	}
+
+	void HostPlatform::PostString(const std::string& message)
+	{
+		postedStrings++;
+		if (config.echoMessages)
+			std::cout << message << std::endl;
+		if (messageHandler)
+			messageHandler(message);
+	}
+
+	void HostPlatform::PostBinary(const void* data, uint32_t size)
+	{
+		postedBinaries++;
+		postedBinaryBytes += size;
+		if (binaryHandler)
+			binaryHandler(data, size);
+	}
+
+	void HostPlatform::LogToConsole(bool isError, const std::string& message)
+	{
+		(isError ? std::cerr : std::cout) << message << std::endl;
+	}
+
+	GraphicsContext* HostPlatform::CreateGraphicsContext(int32_t width, int32_t height)
+	{
+		return new FakeGraphicsContext(this);
+	}
+
+	VideoDecoderBackend* HostPlatform::CreateVideoDecoder(GraphicsContext* context)
+	{
+		return new FakeVideoDecoder(this);
+	}
+
+	void HostPlatform::PostTask(double delay_in_milliseconds, const PlatformCallback& callback, int32_t result)
+	{
+		Task task;
+		task.callback = callback;
+		task.result = result;
+		tasks_.insert(std::make_pair(now_ + delay_in_milliseconds / 1000, task));
+	}
+
+	bool HostPlatform::RunNextTask()
+	{
+		if (tasks_.empty())
+			return false;
+		std::multimap<double, Task>::iterator it = tasks_.begin();
+		if (it->first > now_)
+			now_ = it->first;
+		Task task = it->second;
+		tasks_.erase(it);
+		task.callback(task.result);
+		return true;
+	}
+
+	void HostPlatform::RunUntil(double time_in_milliseconds)
+	{
+		double until = time_in_milliseconds / 1000;
+		while (!tasks_.empty() && tasks_.begin()->first <= until)
+			RunNextTask();
+		if (until > now_)
+			now_ = until;
+	}
+
+	void HostPlatform::RunUntilIdle()
+	{
+		while (RunNextTask())
+		{
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+#include "Platform.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// In-process fakes for the headless host build.  Time is virtual: nothing happens until the owner runs the task queue,
+// so a run is fully deterministic and independent of the speed of the build machine.
+namespace PnaclPlayer
+{
+	/// <summary>
+	/// Tunables for the fake decoder and graphics context.  All latencies are in milliseconds of virtual time.
+	/// </summary>
+	struct HostConfig
+	{
+		HostConfig() : initializeLatencyMs(5), decodeLatencyMs(4), swapLatencyMs(16), resetLatencyMs(2), refreshHz(0), pictureCount(8), pictureWidth(1920), pictureHeight(1080), reorderDepth(0), decodeErrorEvery(0), decodeErrorResult(PLATFORM_ERROR_FAILED), requireParameterSets(false), echoMessages(false) {}
+		double initializeLatencyMs;
+		double decodeLatencyMs;
+		double swapLatencyMs;
+		double resetLatencyMs;
+		/// <summary>If non-zero, a swap is shown at the first refresh of a display with this rate after swapLatencyMs, and completes then, as in a browser.  Refreshes are at whole multiples of the period from time 0.</summary>
+		double refreshHz;
+		/// <summary>Number of picture buffers the fake decoder owns.  Decoding stalls while all of them are held by the player.</summary>
+		int32_t pictureCount;
+		int32_t pictureWidth;
+		int32_t pictureHeight;
+		/// <summary>Decoded pictures the fake decoder holds back until more are decoded or it is flushed, like a decoder waiting to reorder.</summary>
+		int32_t reorderDepth;
+		/// <summary>If non-zero, every decodeErrorEvery-th Decode (counted over all decoders) completes with decodeErrorResult.  Any result
+		/// but PLATFORM_ERROR_BADARGUMENT leaves the decoder failed, completing every later call with PLATFORM_ERROR_FAILED, as a PPB_VideoDecoder does.</summary>
+		int32_t decodeErrorEvery;
+		int32_t decodeErrorResult;
+		/// <summary>If true, decoding an IDR before the decoder has seen an SPS and a PPS fails and leaves it failed, as a real decoder does.</summary>
+		bool requireParameterSets;
+		/// <summary>If true, every string the player posts is also written to stdout.</summary>
+		bool echoMessages;
+	};
+
+	/// <summary>
+	/// ByteBuffer that owns a copy of its bytes.
+	/// </summary>
+	class HostByteBuffer : public ByteBuffer
+	{
+	public:
+		HostByteBuffer(const void* data, uint32_t size) : bytes_((const uint8_t*)data, (const uint8_t*)data + size) {}
+		explicit HostByteBuffer(uint32_t size) : bytes_(size) {}
+		virtual ~HostByteBuffer() {}
+		virtual uint32_t ByteLength() { return (uint32_t)bytes_.size(); }
+		virtual void* Map() { return bytes_.empty() ? NULL : &bytes_[0]; }
+
+	private:
+		std::vector<uint8_t> bytes_;
+	};
+
+	/// <summary>
+	/// Counts of the calls made against the fake graphics context.
+	/// </summary>
+	struct HostGLStats
+	{
+		HostGLStats() : glCalls(0), drawCalls(0), swaps(0), resizes(0) {}
+		int64_t glCalls;
+		int64_t drawCalls;
+		int64_t swaps;
+		int64_t resizes;
+	};
+
+	/// <summary>
+	/// Counts of the work done by the fake video decoders.
+	/// </summary>
+	struct HostDecoderStats
+	{
+		HostDecoderStats() : decodes(0), pictures(0), recycles(0), resets(0), flushes(0), stalls(0), discarded(0), errors(0) {}
+		int64_t decodes;
+		int64_t pictures;
+		int64_t recycles;
+		int64_t resets;
+		int64_t flushes;
+		int64_t stalls;
+		/// <summary>Buffers decoded without producing a picture: parameter sets alone, or slices before the first IDR since Initialize or Reset.</summary>
+		int64_t discarded;
+		/// <summary>Decodes failed on purpose, per HostConfig::decodeErrorEvery, or for want of parameter sets, per HostConfig::requireParameterSets.</summary>
+		int64_t errors;
+	};
+
+	/// <summary>
+	/// Platform implementation with a virtual clock and a single-threaded task queue standing in for the browser's main thread.
+	/// Nothing here is thread-safe: the host driver plays the part of the ingest thread on the main thread.
+	/// </summary>
+	class HostPlatform : public Platform
+	{
+	public:
+		HostPlatform(const HostConfig& config = HostConfig());
+		virtual ~HostPlatform();
+
+		// Platform implementation.
+		virtual double GetTimeTicks() { return now_; }
+		virtual void CallOnMainThread(int32_t delay_in_milliseconds, const PlatformCallback& callback, int32_t result);
+		virtual void PostString(const std::string& message);
+		virtual void PostBinary(const void* data, uint32_t size);
+		virtual void LogToConsole(bool isError, const std::string& message);
+		virtual GraphicsContext* CreateGraphicsContext(int32_t width, int32_t height);
+		virtual VideoDecoderBackend* CreateVideoDecoder(GraphicsContext* context);
+
+		/// <summary>
+		/// Queues a callback to run after the given delay in (fractional) milliseconds of virtual time.
+		/// </summary>
+		void PostTask(double delay_in_milliseconds, const PlatformCallback& callback, int32_t result);
+		/// <summary>
+		/// Runs the earliest queued task, advancing the virtual clock to its due time if necessary.  Returns false if the queue is empty.
+		/// </summary>
+		bool RunNextTask();
+		/// <summary>
+		/// Runs every task due at or before the given virtual time (in milliseconds), then advances the clock to that time.
+		/// </summary>
+		void RunUntil(double time_in_milliseconds);
+		/// <summary>
+		/// Runs tasks until the queue is empty.
+		/// </summary>
+		void RunUntilIdle();
+		/// <summary>
+		/// Returns the virtual time in milliseconds.
+		/// </summary>
+		double NowMs() const { return now_ * 1000; }
+		size_t PendingTasks() const { return tasks_.size(); }
+
+		/// <summary>
+		/// Called with every string the player posts, if set.
+		/// </summary>
+		std::function<void(const std::string&)> messageHandler;
+		/// <summary>
+		/// Called with every ArrayBuffer the player posts, if set.
+		/// </summary>
+		std::function<void(const void*, uint32_t)> binaryHandler;
+
+		HostConfig config;
+		HostGLStats glStats;
+		HostDecoderStats decoderStats;
+		int64_t postedStrings;
+		int64_t postedBinaries;
+		int64_t postedBinaryBytes;
+
+	private:
+		struct Task
+		{
+			PlatformCallback callback;
+			int32_t result;
+		};
+		double now_;
+		// Keyed by due time in seconds.  std::multimap keeps insertion order among equal keys, so tasks due at the same instant run FIFO.
+		std::multimap<double, Task> tasks_;
+	};
+}
\ No newline at end of file
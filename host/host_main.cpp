@@ -0,0 +1,419 @@
+// Headless driver for the host build.  Runs the real player logic (pnacl_player, Decoder, RenderScheduler) against HostPlatform
+// with a synthetic constant-rate stream and prints what happened.  Usage:
+//   pnacl_player_host [--seconds 10] [--fps 30] [--decode-ms 4] [--swap-ms 16] [--paint-queue 8] [--paint-policy dropoldest]
+//                     [--telemetry string] [--framed] [--catchup-ms 0] [--wall 1x1] [--switch none|reset|seamless] [--queue-budget 0]
+//                     [--ingest-thread] [--trace file] [--refresh-hz 0] [--view-delay-ms 0] [--reorder-depth 0] [--idle-flush-ms 0]
+//                     [--event-seconds 0] [--decode-error-every 0] [--decode-error-result -2] [--parameter-sets none|inline|separate]
+//                     [--switch-ms 2000] [--standby preload|on-demand] [--init-ms 5] [--eos]
+//
+// --paint-queue, --paint-policy, --telemetry, --catchup-ms, --wall, --queue-budget, --ingest-thread and --idle-flush-ms set the embed
+// attributes of the same names.  --framed sends framed messages instead of "f <timestamp>" strings followed by ArrayBuffers.
+// With --trace, every message sent to the player is recorded and the trace is written to the file, for bench/trace_replay.
+// With --refresh-hz, swaps complete on the refreshes of a display of that rate and the player aligns presentation to them.
+// With --view-delay-ms, the stream starts as soon as the player is created but the view (and so graphics and the decoders) comes that much later.
+// With --reorder-depth, the fake decoder holds that many pictures back until it decodes more or is flushed.  With --event-seconds, the
+// camera sends only during every other period of that length, like a motion-triggered camera.
+// With --decode-error-every, every Nth decode fails with --decode-error-result (a PLATFORM_ERROR_* value; -4 rejects just the frame).
+// --parameter-sets sends an SPS and PPS with every IDR, in the same frame (inline) or in a frame of their own just before it (separate),
+// and makes the fake decoder fail an IDR it gets before both.
+// --switch-ms sets how often --switch changes cameras.  With --standby on-demand, a seamless switch creates the standby decoder
+// when it starts instead of ahead of time, so a switch shorter than --init-ms (how long the fake takes to initialize) switches again
+// while the standby is still initializing.
+// --eos sends an "eos" message right after the last frame and reports how many streams answered it.
+
+#include "../bench/BenchUtil.h"
+#include "HostPlatform.h"
+#include "pnacl_player.h"
+#include "FrameTelemetry.h"
+#include "FramedMessage.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace PnaclPlayer;
+
+int main(int argc, char* argv[])
+{
+	Bench::Args args(argc, argv);
+	double seconds = args.GetDouble("--seconds", 10);
+	double fps = args.GetDouble("--fps", 30);
+	HostConfig config;
+	config.initializeLatencyMs = args.GetDouble("--init-ms", config.initializeLatencyMs);
+	config.decodeLatencyMs = args.GetDouble("--decode-ms", config.decodeLatencyMs);
+	config.swapLatencyMs = args.GetDouble("--swap-ms", config.swapLatencyMs);
+	config.refreshHz = args.GetDouble("--refresh-hz", config.refreshHz);
+	config.reorderDepth = (int32_t)args.GetDouble("--reorder-depth", config.reorderDepth);
+	config.decodeErrorEvery = (int32_t)args.GetDouble("--decode-error-every", config.decodeErrorEvery);
+	config.decodeErrorResult = (int32_t)args.GetDouble("--decode-error-result", config.decodeErrorResult);
+	std::string parameterSets = args.Get("--parameter-sets", "none");
+	if (parameterSets != "none" && parameterSets != "inline" && parameterSets != "separate")
+	{
+		fprintf(stderr, "unknown --parameter-sets %s\n", parameterSets.c_str());
+		return 1;
+	}
+	config.requireParameterSets = parameterSets != "none";
+
+	HostPlatform platform(config);
+	int64_t rendered = 0;
+	int64_t dropped = 0;
+	std::string framePoolReport;
+	std::string decoderReport;
+	std::string glReport;
+	std::string firstFrameReport;
+	std::string latencyReport;
+	std::string traceReport;
+	const char* traceFile = args.Get("--trace", NULL);
+	bool traceWritten = false;
+	int64_t sheds = 0;
+	int64_t skipped = 0;
+	int64_t switched = 0;
+	int64_t decoderErrors = 0;
+	int64_t endsOfStream = 0;
+	int64_t lastRecoveryMs = 0;
+	int64_t maxRecoveryMs = 0;
+	// Set once the streams exist.  Called with every pause/resume message.
+	std::function<void(int, bool)> flowControl = [](int, bool) {};
+	// Longest time between two rendered frames, which is how long a camera switch leaves the picture frozen or black.
+	double lastRendered = -1;
+	double longestGap = 0;
+	auto frameRendered = [&]()
+	{
+		rendered++;
+		double now = platform.NowMs();
+		if (lastRendered >= 0 && now - lastRendered > longestGap)
+			longestGap = now - lastRendered;
+		lastRendered = now;
+	};
+	platform.messageHandler = [&](const std::string& message)
+	{
+		if (message.compare(0, 3, "rf ") == 0)
+			frameRendered();
+		else if (message.compare(0, 3, "sw ") == 0)
+			switched++;
+		else if (message.compare(0, 3, "fc ") == 0)
+		{
+			int stream = 0;
+			char state[16] = "";
+			sscanf(message.c_str(), "fc {\"s\":%d,\"state\":\"%15[a-z]", &stream, state);
+			flowControl(stream, strcmp(state, "pause") == 0);
+		}
+		else if (message.compare(0, 3, "df ") == 0)
+			dropped++;
+		else if (message.compare(0, 3, "de ") == 0)
+			decoderErrors++;
+		else if (message.compare(0, 4, "eos ") == 0)
+			endsOfStream++;
+		else if (message.compare(0, 3, "dr ") == 0)
+		{
+			int stream = 0;
+			long long ms = 0;
+			sscanf(message.c_str(), "dr {\"s\":%d,\"ms\":%lld", &stream, &ms);
+			lastRecoveryMs = ms;
+			if (ms > maxRecoveryMs)
+				maxRecoveryMs = ms;
+		}
+		else if (message.compare(0, 3, "fp ") == 0)
+			framePoolReport = message;
+		else if (message.compare(0, 3, "ds ") == 0)
+			decoderReport = message;
+		else if (message.compare(0, 3, "gl ") == 0)
+			glReport = message;
+		else if (message.compare(0, 3, "ff ") == 0)
+			firstFrameReport = message;
+		else if (message.compare(0, 3, "st ") == 0)
+			latencyReport = message;
+		else if (message.compare(0, 3, "rc ") == 0)
+			traceReport = message;
+		else if (message.compare(0, 3, "sk ") == 0)
+		{
+			long long frames = 0;
+			sscanf(message.c_str(), "sk {\"frames\":%lld", &frames);
+			sheds++;
+			skipped += frames;
+		}
+	};
+	platform.binaryHandler = [&](const void* data, uint32_t size)
+	{
+		if (size >= 4 && memcmp(data, "pnt1", 4) == 0)
+		{
+			FILE* file = fopen(traceFile, "wb");
+			traceWritten = file && fwrite(data, 1, size, file) == size;
+			if (file)
+				fclose(file);
+			return;
+		}
+		const FrameTelemetryHeader* header = (const FrameTelemetryHeader*)data;
+		const FrameTelemetryRecord* records = (const FrameTelemetryRecord*)(header + 1);
+		for (uint16_t i = 0; i < header->recordCount; i++)
+		{
+			if (records[i].event == TELEMETRY_RENDERED)
+				frameRendered();
+			else
+				dropped++;
+		}
+	};
+
+	pnacl_player* player = new pnacl_player(&platform);
+	const char* wall = args.Get("--wall", "1x1");
+	int wallColumns = 1;
+	int wallRows = 1;
+	if (sscanf(wall, "%dx%d", &wallColumns, &wallRows) != 2 || wallColumns <= 0 || wallRows <= 0)
+	{
+		fprintf(stderr, "invalid wall layout %s\n", wall);
+		return 1;
+	}
+	// Every cell gets its own stream, and every stream gets the same synthetic frames.
+	int streams = wallColumns * wallRows;
+	const char* argn[] = { "hwaccel", "paintqueue", "paintpolicy", "telemetry", "catchupms", "wall", "queuebudget", "ingestthread", "vsync", "idleflushms" };
+	const char* argv2[] = { "1", args.Get("--paint-queue", "8"), args.Get("--paint-policy", "dropoldest"), args.Get("--telemetry", "string"), args.Get("--catchup-ms", "0"), wall, args.Get("--queue-budget", "0"), args.Has("--ingest-thread") ? "1" : "0", config.refreshHz > 0 ? "1" : "0", args.Get("--idle-flush-ms", "0") };
+	player->Init(10, argn, argv2);
+	// With threaded ingest, the stream and the messages that must stay in order with it go through the ingest entry points.
+	// HostPlatform is single-threaded, so this runs them on the main thread; the frames still reach the decoders in later tasks.
+	bool ingestThreaded = player->ingestThreaded();
+	auto ingestString = [&](const std::string& message)
+	{
+		if (ingestThreaded)
+			player->HandleMessageOnIngestThread(message);
+		else
+			player->HandleMessage(message);
+	};
+	auto ingestBuffer = [&](const ByteBufferPtr& buffer)
+	{
+		if (ingestThreaded)
+			player->HandleMessageOnIngestThread(buffer);
+		else
+			player->HandleMessage(buffer);
+	};
+	double viewDelayMs = args.GetDouble("--view-delay-ms", 0);
+	double eventMs = args.GetDouble("--event-seconds", 0) * 1000;
+	bool viewed = viewDelayMs <= 0;
+	if (viewed)
+	{
+		player->DidChangeView(1280, 720);
+		platform.RunUntilIdle();
+	}
+	if (traceFile)
+		ingestString(std::string("record start"));
+
+	// Every --switch-ms the page switches to another camera, which starts mid-GOP with its timestamps starting over.  "reset"
+	// switches the way pages did before standby decoders: reset, then feed the new camera.  "seamless" feeds the new camera as
+	// the next generation while the old camera keeps coming, until the player reports the switch.
+	const char* switchMode = args.Get("--switch", "none");
+	bool seamless = strcmp(switchMode, "seamless") == 0;
+	int64_t switchFrames = strcmp(switchMode, "none") == 0 ? 0 : std::max((int64_t)1, (int64_t)(fps * args.GetDouble("--switch-ms", 2000) / 1000));
+	if (seamless && strcmp(args.Get("--standby", "preload"), "on-demand") != 0)
+	{
+		player->HandleMessage(std::string("standby"));
+		platform.RunUntilIdle();
+	}
+
+	// The payload is a start code and NAL header (an IDR slice once per second, otherwise a non-IDR slice) padded with zeros,
+	// after the parameter sets if they are sent inline.  The fake decoder only looks at the NAL types.
+	const uint32_t kFrameBytes = 4096;
+	// A 1280x720 baseline SPS and a PPS, each with its start code.
+	const uint8_t kParameterSets[] = { 0, 0, 1, 0x67, 0x42, 0xC0, 0x1F, 0xDA, 0x01, 0x40, 0x16, 0xE4, 0, 0, 1, 0x68, 0xCE, 0x38, 0x80 };
+	// "split" sends each frame as an "f <timestamp>" string followed by the ArrayBuffer; "framed" sends one framed message per frame.
+	bool framed = args.Has("--framed");
+	int64_t sent = 0;
+	auto deliverBuffer = [&](int stream, int64_t timestamp, bool keyframe, uint8_t generation, const uint8_t* payload, uint32_t size)
+	{
+		if (framed)
+		{
+			HostByteBuffer* message = new HostByteBuffer(FramedMessageReader::kMagicSize + FramedMessageReader::kHeaderSize + size);
+			uint8_t* data = (uint8_t*)message->Map();
+			FramedMessageHeader header;
+			header.timestamp = timestamp;
+			header.length = size;
+			header.flags = (uint16_t)((keyframe ? ENCODED_FRAME_KEYFRAME : 0) | generation << ENCODED_FRAME_GENERATION_SHIFT);
+			header.stream = (uint16_t)stream;
+			memcpy(data, "pnf1", FramedMessageReader::kMagicSize);
+			memcpy(data + FramedMessageReader::kMagicSize, &header, FramedMessageReader::kHeaderSize);
+			memcpy(data + FramedMessageReader::kMagicSize + FramedMessageReader::kHeaderSize, payload, size);
+			ingestBuffer(ByteBufferPtr(message));
+		}
+		else
+		{
+			char header[48];
+			snprintf(header, sizeof(header), "f %lld %d %d", (long long)timestamp, stream, generation);
+			ingestString(std::string(header));
+			ingestBuffer(ByteBufferPtr(new HostByteBuffer(payload, size)));
+		}
+	};
+	auto deliverFrame = [&](int stream, int64_t timestamp, bool keyframe, uint8_t generation)
+	{
+		uint8_t payload[kFrameBytes] = {};
+		uint32_t offset = 0;
+		if (keyframe && parameterSets == "separate")
+			deliverBuffer(stream, timestamp, false, generation, kParameterSets, sizeof(kParameterSets));
+		else if (keyframe && parameterSets == "inline")
+		{
+			memcpy(payload, kParameterSets, sizeof(kParameterSets));
+			offset = sizeof(kParameterSets);
+		}
+		const uint8_t slice[] = { 0, 0, 1, (uint8_t)(keyframe ? 0x65 : 0x41) };
+		memcpy(payload + offset, slice, sizeof(slice));
+		deliverBuffer(stream, timestamp, keyframe, generation, payload, kFrameBytes);
+	};
+
+	// While the player has a stream paused, its frames wait here the way they would wait in the socket, and are delivered when it resumes.
+	std::vector<bool> paused(streams, false);
+	std::vector<std::deque<std::function<void()>>> held(streams);
+	int64_t pauses = 0;
+	size_t peakHeld = 0;
+	flowControl = [&](int stream, bool pause)
+	{
+		paused[stream] = pause;
+		if (pause)
+		{
+			pauses++;
+			return;
+		}
+		// The player is in the middle of decoding; deliver once it is done.
+		platform.PostTask(0, [&, stream](int32_t)
+		{
+			while (!paused[stream] && !held[stream].empty())
+			{
+				std::function<void()> deliver = held[stream].front();
+				held[stream].pop_front();
+				deliver();
+			}
+		}, 0);
+	};
+	auto sendFrame = [&](int stream, int64_t timestamp, bool keyframe, uint8_t generation)
+	{
+		sent++;
+		if (!paused[stream] && held[stream].empty())
+		{
+			deliverFrame(stream, timestamp, keyframe, generation);
+			return;
+		}
+		held[stream].push_back([=, &deliverFrame]() { deliverFrame(stream, timestamp, keyframe, generation); });
+		if (held[stream].size() > peakHeld)
+			peakHeld = held[stream].size();
+	};
+
+	// A camera's frames: timestamps relative to when it started, and its IDRs once per second from its own starting point.
+	struct Camera
+	{
+		double start;
+		int64_t keyframePhase;
+	};
+	double interval = 1000 / fps;
+	int64_t frames = (int64_t)(seconds * fps);
+	double start = platform.NowMs();
+	Camera camera = { start, 0 };
+	Camera oldCamera = camera;
+	uint8_t generation = 0;
+	// Frames of the old camera are sent until every stream has switched.
+	int64_t switchedBefore = 0;
+	bool overlapping = false;
+	std::string warmFramePoolReport;
+	for (int64_t i = 0; i < frames; i++)
+	{
+		if (i == (int64_t)fps)
+		{
+			// One second in, the frame pool has reached its working size.  Any allocations after this point would show up as a difference in the final report.
+			player->HandleMessage(std::string("framepool"));
+			warmFramePoolReport = framePoolReport;
+		}
+		double arrival = start + i * interval;
+		if (!viewed && arrival >= start + viewDelayMs)
+		{
+			platform.RunUntil(start + viewDelayMs);
+			player->DidChangeView(1280, 720);
+			viewed = true;
+		}
+		platform.RunUntil(arrival);
+		if (switchFrames > 0 && i > 0 && i % switchFrames == 0)
+		{
+			oldCamera = camera;
+			camera.start = arrival;
+			camera.keyframePhase = (int64_t)fps / 2;
+			if (seamless)
+			{
+				generation++;
+				switchedBefore = switched;
+				overlapping = true;
+			}
+			else
+				ingestString(std::string("reset"));
+		}
+		if (overlapping && switched - switchedBefore >= streams)
+			overlapping = false;
+		int64_t index = (int64_t)((arrival - camera.start) / interval + 0.5);
+		int64_t oldIndex = (int64_t)((arrival - oldCamera.start) / interval + 0.5);
+		if (eventMs > 0 && (int64_t)((arrival - start) / eventMs) % 2 == 1)
+			continue; // Nothing is moving.
+		for (int stream = 0; stream < streams; stream++)
+		{
+			if (overlapping)
+				sendFrame(stream, (int64_t)(arrival - oldCamera.start), (oldIndex + oldCamera.keyframePhase) % (int64_t)fps == 0, (uint8_t)(generation - 1));
+			sendFrame(stream, (int64_t)(arrival - camera.start), (index + camera.keyframePhase) % (int64_t)fps == 0, generation);
+		}
+	}
+	bool endOfStream = args.Has("--eos");
+	if (endOfStream)
+		ingestString(std::string("eos"));
+	platform.RunUntilIdle();
+	for (int stream = 0; stream < streams; stream++)
+	{
+		// Deliver anything still held, as if the page resumed reading.
+		paused[stream] = false;
+		while (!held[stream].empty())
+		{
+			std::function<void()> deliver = held[stream].front();
+			held[stream].pop_front();
+			deliver();
+			platform.RunUntilIdle();
+		}
+	}
+	platform.RunUntilIdle();
+	if (traceFile)
+	{
+		ingestString(std::string("record stop"));
+		platform.RunUntilIdle();
+		if (!traceWritten)
+		{
+			fprintf(stderr, "could not write trace to %s\n", traceFile);
+			return 1;
+		}
+	}
+	player->HandleMessage(std::string("telemetry flush"));
+	player->HandleMessage(std::string("framepool"));
+	player->HandleMessage(std::string("decoderstats"));
+	player->HandleMessage(std::string("stats"));
+	player->HandleMessage(std::string("glstats"));
+
+	printf("frames sent:     %lld\n", (long long)sent);
+	printf("frames rendered: %lld\n", (long long)rendered);
+	printf("frames dropped:  %lld\n", (long long)dropped);
+	printf("frames skipped:  %lld (%lld catch-ups)\n", (long long)skipped, (long long)sheds);
+	printf("decodes:         %lld (stalls %lld, no picture %lld)\n", (long long)platform.decoderStats.decodes, (long long)platform.decoderStats.stalls, (long long)platform.decoderStats.discarded);
+	if (platform.decoderStats.errors > 0)
+		printf("decode errors:   %lld in the fake, %lld reported, recovery last %lld ms, max %lld ms\n", (long long)platform.decoderStats.errors, (long long)decoderErrors, (long long)lastRecoveryMs, (long long)maxRecoveryMs);
+	printf("pictures:        %lld (recycled %lld)\n", (long long)platform.decoderStats.pictures, (long long)platform.decoderStats.recycles);
+	if (endOfStream)
+		printf("end of stream:   %lld of %d streams answered\n", (long long)endsOfStream, streams);
+	printf("switches:        %lld seamless, longest gap %.1f ms\n", (long long)switched, longestGap);
+	printf("GL calls:        %lld (draws %lld, swaps %lld, resizes %lld)\n", (long long)platform.glStats.glCalls, (long long)platform.glStats.drawCalls, (long long)platform.glStats.swaps, (long long)platform.glStats.resizes);
+	printf("first frame:     %s\n", firstFrameReport.c_str());
+	printf("GL state cache:  %s\n", glReport.c_str());
+	printf("messages posted: %lld strings, %lld binary (%lld bytes)\n", (long long)platform.postedStrings, (long long)platform.postedBinaries, (long long)platform.postedBinaryBytes);
+	printf("frame pool @1s:  %s\n", warmFramePoolReport.c_str());
+	printf("frame pool @end: %s\n", framePoolReport.c_str());
+	printf("flow control:    %lld pauses, up to %lld frames held back\n", (long long)pauses, (long long)peakHeld);
+	printf("decoder:         %s\n", decoderReport.c_str());
+	printf("latency (us):    %s\n", latencyReport.c_str());
+	if (traceFile)
+		printf("trace:           %s %s\n", traceFile, traceReport.c_str());
+	printf("virtual time:    %.1f ms\n", platform.NowMs());
+
+	delete player;
+	return 0;
+}
\ No newline at end of file
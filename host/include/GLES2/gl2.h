@@ -0,0 +1,31 @@
+#pragma once
+// Minimal stand-in for the Khronos <GLES2/gl2.h> used by the headless host build.
+// Only the types and enums referenced by the player are declared; the values are the standard ones.
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int GLenum;
+typedef unsigned char GLboolean;
+typedef unsigned int GLbitfield;
+typedef int GLint;
+typedef int GLsizei;
+typedef unsigned int GLuint;
+typedef float GLfloat;
+typedef float GLclampf;
+typedef ptrdiff_t GLsizeiptr;
+
+#define GL_NO_ERROR                       0
+#define GL_FALSE                          0
+#define GL_TRUE                           1
+#define GL_TRIANGLE_STRIP                 0x0005
+#define GL_TEXTURE_2D                     0x0DE1
+#define GL_FLOAT                          0x1406
+#define GL_INVALID_ENUM                   0x0500
+#define GL_INVALID_VALUE                  0x0501
+#define GL_INVALID_OPERATION              0x0502
+#define GL_COLOR_BUFFER_BIT               0x00004000
+#define GL_TEXTURE0                       0x84C0
+#define GL_ARRAY_BUFFER                   0x8892
+#define GL_STATIC_DRAW                    0x88E4
+#define GL_FRAGMENT_SHADER                0x8B30
+#define GL_VERTEX_SHADER                  0x8B31
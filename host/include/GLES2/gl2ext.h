@@ -0,0 +1,6 @@
+#pragma once
+// Minimal stand-in for the Khronos <GLES2/gl2ext.h> used by the headless host build.
+#include <GLES2/gl2.h>
+
+#define GL_TEXTURE_RECTANGLE_ARB          0x84F5
+#define GL_TEXTURE_EXTERNAL_OES           0x8D65
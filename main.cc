@@ -5,7 +5,7 @@
 // Refactored and extended since 2017 by bp2008
 // https://github.com/bp2008
 
-#include "pnacl_player.h"
+#include "PpapiPlatform.h"
 
 #pragma region PPAPI Boilerplate
 
@@ -22,7 +22,7 @@ namespace
 
 		virtual pp::Instance* CreateInstance(PP_Instance instance)
 		{
-			return new PnaclPlayer::pnacl_player(instance, this);
+			return new PnaclPlayer::PpapiPlatform(instance, this);
 		}
 	};
 }  // anonymous namespace
@@ -2,44 +2,42 @@
 
 // Assert |context_| isn't holding any GL Errors.  Done as a macro instead of a
 // function to preserve line number information in the failure message.
-#define assertNoGLError() assert(!gles2_if_->GetError(context_->pp_resource()));
+#define assertNoGLError() assert(!context_->GetError());
 
 namespace PnaclPlayer
 {
 
-	pnacl_player::pnacl_player(PP_Instance instance, pp::Module* module) : pp::Instance(instance), pp::Graphics3DClient(this), callback_factory_(this), is_painting_(false), hwaccel_(0), is_resetting_(false), context_(NULL), nextFrameTimestamp(0)
+	pnacl_player::pnacl_player(Platform* platform) : platform_(platform), is_painting_(false), paint_posted_(false), hwaccel_(0), is_resetting_(false), paintQueueCapacity_(8), paintQueuePolicy_(PAINT_DROP_OLDEST), jitterBufferMode_(JITTER_BUFFER_FIXED), clockJumpMs_(RenderScheduler::kDefaultClockJumpThresholdMs), telemetry_(platform), ingest_(platform, std::bind(&pnacl_player::ConsumeIngestItem, this, std::placeholders::_1)), context_(NULL), wallCells_(1, 0), wallColumns_(1), wallRows_(1), backlogLimitMs_(0), backlogLimitBytes_(0), queueHighBytes_(0), queueLowBytes_(-1), idleFlushMs_(0), standbyDecoders_(false), vsyncAligned_(false), startupFrames_(StartupFrameBuffer::kDefaultMaxBytes), createdUs_(FrameLatencyStats::Now(platform)), firstArrivalUs_(0), firstFrameShown_(false)
 	{
-		console_if_ = static_cast<const PPB_Console*>(pp::Module::Get()->GetBrowserInterface(PPB_CONSOLE_INTERFACE));
-		core_if_ = static_cast<const PPB_Core*>(pp::Module::Get()->GetBrowserInterface(PPB_CORE_INTERFACE));
-		gles2_if_ = static_cast<const PPB_OpenGLES2*>(pp::Module::Get()->GetBrowserInterface(PPB_OPENGLES2_INTERFACE));
-
-		renderScheduler = new RenderScheduler(this);
+		plugin_size_.width = plugin_size_.height = 0;
+		view_size_.width = view_size_.height = 0;
 	}
 
 	pnacl_player::~pnacl_player()
 	{
+		// Each stream releases its frames before deleting its decoder.
+		for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+			delete it->second;
+		streams_.clear();
+
 		if (!context_)
 			return;
 
-		PP_Resource graphics_3d = context_->pp_resource();
 		if (shader_2d_.program)
-			gles2_if_->DeleteProgram(graphics_3d, shader_2d_.program);
+			context_->DeleteProgram(shader_2d_.program);
 		if (shader_rectangle_arb_.program)
-			gles2_if_->DeleteProgram(graphics_3d, shader_rectangle_arb_.program);
+			context_->DeleteProgram(shader_rectangle_arb_.program);
 		if (shader_external_oes_.program)
-			gles2_if_->DeleteProgram(graphics_3d, shader_external_oes_.program);
-
-		if (video_decoder_)
-			delete video_decoder_;
-
-		if (renderScheduler)
-			delete renderScheduler;
+			context_->DeleteProgram(shader_external_oes_.program);
 
 		delete context_;
 	}
 
 	bool pnacl_player::Init(uint32_t argc, const char * argn[], const char * argv[])
 	{
+		bool binaryTelemetry = false;
+		int telemetryFrames = FrameTelemetry::kDefaultMaxRecords;
+		int telemetryMs = FrameTelemetry::kDefaultMaxDelayMs;
 		for (uint32_t i = 0; i < argc; i++)
 		{
 			if (strncmp(argn[i], "hwaccel", 256) == 0)
@@ -51,22 +49,87 @@ namespace PnaclPlayer
 				else
 					hwaccel_ = 0;
 			}
+			else if (strncmp(argn[i], "paintqueue", 256) == 0)
+			{
+				int capacity = atoi(argv[i]);
+				if (capacity > 0)
+					ConfigurePaintQueue(capacity, paintQueuePolicy_);
+			}
+			else if (strncmp(argn[i], "paintpolicy", 256) == 0)
+			{
+				PaintQueuePolicy policy;
+				if (ParsePaintQueuePolicy(argv[i], policy))
+					paintQueuePolicy_ = policy;
+			}
+			else if (strncmp(argn[i], "telemetry", 256) == 0)
+				binaryTelemetry = strncmp(argv[i], "binary", 256) == 0;
+			else if (strncmp(argn[i], "telemetryframes", 256) == 0)
+				telemetryFrames = atoi(argv[i]);
+			else if (strncmp(argn[i], "telemetryms", 256) == 0)
+				telemetryMs = atoi(argv[i]);
+			else if (strncmp(argn[i], "jitterbuffer", 256) == 0)
+			{
+				JitterBufferMode mode;
+				if (ParseJitterBufferMode(argv[i], mode))
+					jitterBufferMode_ = mode;
+			}
+			else if (strncmp(argn[i], "clockjumpms", 256) == 0)
+				clockJumpMs_ = atoi(argv[i]);
+			else if (strncmp(argn[i], "idleflushms", 256) == 0)
+				idleFlushMs_ = atoi(argv[i]);
+			else if (strncmp(argn[i], "wall", 256) == 0)
+			{
+				// "<columns>x<rows>", showing streams 0 to columns * rows - 1.
+				int columns = 0;
+				int rows = 0;
+				if (sscanf(argv[i], "%dx%d", &columns, &rows) == 2 && columns > 0 && rows > 0)
+				{
+					std::vector<int32_t> ids;
+					for (int32_t id = 0; id < columns * rows; id++)
+						ids.push_back(id);
+					SetWallLayout(columns, rows, ids);
+				}
+			}
+			else if (strncmp(argn[i], "standby", 256) == 0)
+				standbyDecoders_ = strncmp(argv[i], "1", 256) == 0;
+			else if (strncmp(argn[i], "vsync", 256) == 0)
+				vsyncAligned_ = strncmp(argv[i], "1", 256) == 0;
+			else if (strncmp(argn[i], "queuebudget", 256) == 0)
+				queueHighBytes_ = strtoll(argv[i], NULL, 10);
+			else if (strncmp(argn[i], "queuelow", 256) == 0)
+				queueLowBytes_ = strtoll(argv[i], NULL, 10);
+			else if (strncmp(argn[i], "ingestthread", 256) == 0)
+			{
+				if (strncmp(argv[i], "1", 256) == 0)
+					ingest_.SetThreaded(true);
+			}
+			else if (strncmp(argn[i], "catchupms", 256) == 0)
+				backlogLimitMs_ = strtoll(argv[i], NULL, 10);
+			else if (strncmp(argn[i], "catchupbytes", 256) == 0)
+				backlogLimitBytes_ = strtoll(argv[i], NULL, 10);
 		}
+		if (queueLowBytes_ < 0)
+			queueLowBytes_ = queueHighBytes_ / 2;
+		if (binaryTelemetry && telemetryFrames > 0 && telemetryFrames <= 0xFFFF && telemetryMs > 0)
+			telemetry_.EnableBinary(telemetryFrames, telemetryMs);
 		return true;
 	}
 
-	void pnacl_player::DidChangeView(const pp::Rect& position, const pp::Rect& clip_ignored)
+	void pnacl_player::DidChangeView(int32_t width, int32_t height)
 	{
-		if (position.width() == 0 || position.height() == 0)
+		if (width == 0 || height == 0)
 			return;
-		if (plugin_size_.width() > 0)
+		view_size_.width = width;
+		view_size_.height = height;
+		if (plugin_size_.width > 0)
 		{
-			//plugin_size_ = position.size();
+			// The back buffer follows the view at its next refresh.
 		}
 		else
 		{
 			PostString("initializing");
-			plugin_size_ = position.size();
+			plugin_size_.width = width;
+			plugin_size_.height = height;
 
 			// Initialize graphics.
 			InitGL();
@@ -76,70 +139,178 @@ namespace PnaclPlayer
 
 	void pnacl_player::InitializeDecoders()
 	{
-		assert(!video_decoder_);
-		video_decoder_ = new Decoder(this, 0, *context_, hwaccel_);
+		assert(streams_.empty());
+		CreateStreams();
 	}
 
-	void pnacl_player::ReceiveDecodedPicture(DecodedFrame* frame)
+	void pnacl_player::CreateStreams()
 	{
-		// The frame is now the responsibility of the renderScheduler until it is handed back to us.
-#ifdef DebugLogging
+		if (!context_)
+			return; // Streams are created once graphics are initialized.
+		for (size_t i = 0; i < wallCells_.size(); i++)
 		{
-			std::stringstream sstm;
-			sstm << "decoded frame " << frame->timestamp;
-			DebugLog(sstm.str());
+			int32_t id = wallCells_[i];
+			if (id < 0 || FindStream(id))
+				continue;
+			VideoStream* stream = new VideoStream(this, id, context_->context(), hwaccel_, paintQueueCapacity_);
+			stream->SetBacklogLimits(backlogLimitMs_, backlogLimitBytes_);
+			stream->SetQueueBudget(queueHighBytes_, queueLowBytes_);
+			stream->SetIdleFlush(idleFlushMs_);
+			stream->scheduler->SetJitterBufferMode(jitterBufferMode_);
+			stream->scheduler->SetClockJumpThreshold(clockJumpMs_);
+			stream->scheduler->SetVsync(vsyncAligned_ ? &vsync_ : NULL);
+			if (standbyDecoders_)
+				stream->CreateStandby();
+			streams_[id] = stream;
+		}
+		if (!startupFrames_.empty())
+		{
+			// The decoders are still initializing, and queue these until they are ready.
+			std::deque<StartupFrameBuffer::Entry> frames;
+			startupFrames_.TakeAll(frames);
+			for (size_t i = 0; i < frames.size(); i++)
+			{
+				VideoStream* stream = FindStream(frames[i].stream);
+				if (stream)
+					stream->ReceiveFrame(frames[i].frame);
+			}
 		}
-#endif
-		renderScheduler->AddFrame(frame);
 	}
-	void pnacl_player::frameRenderFunc(DecodedFrame* frame)
+
+	VideoStream* pnacl_player::FindStream(int32_t id)
 	{
+		StreamMap::iterator it = streams_.find(id);
+		return it == streams_.end() ? NULL : it->second;
+	}
 
+	bool pnacl_player::SetWallLayout(int32_t columns, int32_t rows, const std::vector<int32_t>& streamIds)
+	{
+		if (columns <= 0 || rows <= 0 || columns * rows > 256 || streamIds.size() > (size_t)(columns * rows))
+			return false;
+		for (size_t i = 0; i < streamIds.size(); i++)
+		{
+			if (streamIds[i] < 0 || streamIds[i] > 0xFFFF || std::count(streamIds.begin(), streamIds.begin() + i, streamIds[i]))
+				return false;
+		}
+		wallColumns_ = columns;
+		wallRows_ = rows;
+		wallCells_ = streamIds;
+		wallCells_.resize(columns * rows, -1); // -1 marks an empty cell.
+
+		for (StreamMap::iterator it = streams_.begin(); it != streams_.end();)
+		{
+			if (std::find(wallCells_.begin(), wallCells_.end(), it->first) == wallCells_.end())
+			{
+				delete it->second;
+				streams_.erase(it++);
+			}
+			else
+				++it;
+		}
+		CreateStreams();
+		return true;
+	}
+
+	PictureRect pnacl_player::CellRect(size_t cell) const
+	{
+		// GL's origin is the bottom left, while cells are numbered from the top left.
+		int32_t column = (int32_t)cell % wallColumns_;
+		int32_t row = (int32_t)cell / wallColumns_;
+		PictureRect rect;
+		rect.x = column * plugin_size_.width / wallColumns_;
+		rect.width = (column + 1) * plugin_size_.width / wallColumns_ - rect.x;
+		int32_t top = row * plugin_size_.height / wallRows_;
+		int32_t bottom = (row + 1) * plugin_size_.height / wallRows_;
+		rect.y = plugin_size_.height - bottom;
+		rect.height = bottom - top;
+		return rect;
+	}
+
+	PictureRect pnacl_player::LetterboxRect(const VideoPicture& picture, const PictureRect& area)
+	{
+		PictureSize size = picture.texture_size;
+		if (picture.visible_rect.width > 0 && picture.visible_rect.height > 0)
+		{
+			size.width = picture.visible_rect.width;
+			size.height = picture.visible_rect.height;
+		}
+		if (size.width <= 0 || size.height <= 0)
+			return area;
+		PictureRect rect = area;
+		// Compare the aspect ratios without dividing: area.width / area.height > size.width / size.height.
+		if ((int64_t)area.width * size.height > (int64_t)area.height * size.width)
+		{
+			rect.width = (int32_t)((int64_t)area.height * size.width / size.height);
+			rect.x += (area.width - rect.width) / 2;
+		}
+		else
+		{
+			rect.height = (int32_t)((int64_t)area.width * size.height / size.width);
+			rect.y += (area.height - rect.height) / 2;
+		}
+		return rect;
+	}
+
+	void pnacl_player::ReceiveDecodedPicture(DecodedFramePtr frame)
+	{
+		// The frame is now the responsibility of its stream's RenderScheduler until it is handed back to us.
 #ifdef DebugLogging
 		{
 			std::stringstream sstm;
-			sstm << "frameRenderFunc() " << frame->timestamp;
+			sstm << "decoded frame " << frame->timestamp;
 			DebugLog(sstm.str());
 		}
 #endif
-		// The frame is now our responsibility.
-		PaintPicture(frame);
+		VideoStream* stream = FindStream(frame->decoder->id());
+		assert(stream);
+		if (!stream->AcceptPicture(frame.get()))
+		{
+			frameDropFunc(std::move(frame), false);
+			return;
+		}
+		stream->scheduler->AddFrame(std::move(frame));
 	}
-	void pnacl_player::frameDropFunc(DecodedFrame* frame, bool reportToClient)
+	void pnacl_player::frameDropFunc(DecodedFramePtr frame, bool reportToClient)
 	{
 		// The frame is now our responsibility.
 		if (!is_resetting_ && reportToClient)
-		{
-			std::stringstream sstm;
-			sstm << "df {" // dropped frame
-				<< "\"w\":" << frame->picture.texture_size.width
-				<< ",\"h\":" << frame->picture.texture_size.height
-				<< ",\"t\":" << frame->timestamp
-				<< ",\"i\":" << frame->expectedInterframe
-				<< " }";
-			PostString(sstm.str());
-		}
-		frame->RecyclePicture();
-		delete frame;
+			ReportFrame(TELEMETRY_DROPPED, frame.get(), frame->picture.texture_size.width, frame->picture.texture_size.height);
+		// Releasing the handle recycles the picture.
 	}
 
-	void pnacl_player::PaintPicture(DecodedFrame* frame)
+	void pnacl_player::PaintPicture(VideoStream* stream, DecodedFramePtr frame)
 	{
+#ifdef DebugLogging
+		{
+			std::stringstream sstm;
+			sstm << "frameRenderFunc() " << frame->timestamp;
+			DebugLog(sstm.str());
+		}
+#endif
+		frame->stages.scheduled = FrameLatencyStats::Now(platform_);
 		if (frame->streamNum != frame->decoder->currentStreamNum)
 		{
-			frameDropFunc(frame, false);
+			frameDropFunc(std::move(frame), false);
 			return;
 		}
 
-		// Enqueue up to N pictures for painting.  Drop the oldest picture if necessary.
-		int N = 8;
-		if (pendingPictures.size() >= N)
+		// Enqueue the picture for painting, making room according to the overflow policy.
+		FrameRing& pendingPictures = stream->pendingPictures;
+		if (paintQueuePolicy_ == PAINT_LATEST_ONLY)
+		{
+			while (!pendingPictures.empty())
+				frameDropFunc(pendingPictures.PopFront(), true);
+		}
+		else if (pendingPictures.full())
 		{
-			DecodedFrame* tmp = pendingPictures.front();
-			frameDropFunc(tmp, true);
-			pendingPictures.erase(pendingPictures.begin());
+			if (paintQueuePolicy_ == PAINT_DROP_NEWEST)
+			{
+				frameDropFunc(std::move(frame), true);
+				return;
+			}
+			frameDropFunc(pendingPictures.PopFront(), true);
 		}
-		pendingPictures.push_back(frame);
+		pendingPictures.PushBack(std::move(frame));
 
 #ifdef DebugLogging
 		{
@@ -149,37 +320,134 @@ namespace PnaclPlayer
 		}
 #endif
 
-		if (!is_painting_)
+		if (is_painting_ || paint_posted_)
+			return;
+		if (IsWall())
+		{
+			// Other cells' schedulers may hand over frames due at the same refresh in the tasks that follow.  Let them, so all are
+			// drawn in one paint rather than the later ones waiting a refresh for the next.
+			paint_posted_ = true;
+			platform_->CallOnMainThread(0, [this](int32_t result)
+			{
+				paint_posted_ = false;
+				if (!is_painting_)
+					PaintNextPicture();
+			}, 0);
+		}
+		else
 			PaintNextPicture();
 	}
 
-	void pnacl_player::PaintNextPicture()
+	void pnacl_player::ConfigurePaintQueue(size_t capacity, PaintQueuePolicy policy)
 	{
-		assert(!is_painting_);
+		for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+		{
+			FrameRing& pendingPictures = it->second->pendingPictures;
+			while (pendingPictures.size() > capacity)
+				frameDropFunc(pendingPictures.PopFront(), true);
+			if (pendingPictures.capacity() != capacity)
+				pendingPictures.SetCapacity(capacity);
+		}
+		paintQueueCapacity_ = capacity;
+		paintQueuePolicy_ = policy;
+	}
 
-		if (pendingPictures.empty())
-			return;
-		DecodedFrame* next = currentlyRenderingFrame = pendingPictures.front();
-		pendingPictures.erase(pendingPictures.begin());
+	bool pnacl_player::ParsePaintQueuePolicy(const std::string& name, PaintQueuePolicy& policy)
+	{
+		if (name == "dropoldest")
+			policy = PAINT_DROP_OLDEST;
+		else if (name == "dropnewest")
+			policy = PAINT_DROP_NEWEST;
+		else if (name == "latest")
+			policy = PAINT_LATEST_ONLY;
+		else
+			return false;
+		return true;
+	}
+
+	bool pnacl_player::ParseJitterBufferMode(const std::string& name, JitterBufferMode& mode)
+	{
+		if (name == "fixed")
+			mode = JITTER_BUFFER_FIXED;
+		else if (name == "lowlatency")
+			mode = JITTER_BUFFER_LOW_LATENCY;
+		else if (name == "smooth")
+			mode = JITTER_BUFFER_SMOOTH;
+		else
+			return false;
+		return true;
+	}
 
-		// A frame may have already been recycled or may belong to an older stream, so we should check that here.
-		if (next->recycled || next->streamNum != video_decoder_->currentStreamNum)
+	void pnacl_player::ReportFrame(FrameTelemetryEvent event, const DecodedFrame* frame, int32_t width, int32_t height)
+	{
+		if (telemetry_.binary())
 		{
-			frameDropFunc(next, false);
-			next = currentlyRenderingFrame = NULL;
-			PaintNextPicture();
+			telemetry_.Add(event, frame->decoder->id(), frame->timestamp, frame->expectedInterframe, width, height, perfNow());
 			return;
 		}
+		std::stringstream sstm;
+		sstm << (event == TELEMETRY_RENDERED ? "rf {" : "df {") // Rendered frame / dropped frame
+			<< "\"w\":" << width
+			<< ",\"h\":" << height
+			<< ",\"t\":" << frame->timestamp
+			<< ",\"i\":" << frame->expectedInterframe;
+			//<< ",\"rt\":" << renderScheduler->lastRenderDuration
+		if (IsWall())
+			sstm << ",\"s\":" << frame->decoder->id();
+		sstm << " }";
+		PostString(sstm.str());
+	}
+
+	void pnacl_player::ReportFirstFrame(int64_t nowUs)
+	{
+		firstFrameShown_ = true;
+		int64_t skipped = startupFrames_.skippedFrames();
+		for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+			skipped += it->second->decoder->backlogStats().startupSkippedFrames;
+		std::stringstream sstm;
+		sstm << "ff {" // First frame
+			<< "\"ms\":" << (nowUs - createdUs_) / 1000
+			<< ",\"sinceArrivalMs\":" << (nowUs - firstArrivalUs_) / 1000
+			<< ",\"skipped\":" << skipped
+			<< " }";
+		PostString(sstm.str());
+	}
+
+	void pnacl_player::PaintNextPicture()
+	{
+		assert(!is_painting_);
+
+		// Take the next picture of every stream that has one.  They are all drawn in one refresh, with one SwapBuffers.
+		DecodedFrame* next = NULL;
+		for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+		{
+			VideoStream* stream = it->second;
+			while (!stream->pendingPictures.empty())
+			{
+				DecodedFramePtr frame = stream->pendingPictures.PopFront();
+				// A frame may have already been recycled or may belong to an older stream, so we should check that here.
+				if (frame->recycled || frame->streamNum != frame->decoder->currentStreamNum)
+				{
+					frameDropFunc(std::move(frame), false);
+					continue;
+				}
+				stream->currentlyRenderingFrame = std::move(frame);
+				next = stream->currentlyRenderingFrame.get();
+				break;
+			}
+		}
+		if (!next)
+			return;
 
 		is_painting_ = true;
-		next->rendering = true;
 
-		int32_t w = next->picture.texture_size.width;
-		int32_t h = next->picture.texture_size.height;
-		if (plugin_size_.width() != w || plugin_size_.height() != h)
+		// Draw at the view's size, and let the GPU scale each picture into its viewport.  The back buffer is only reallocated when the view is resized, not when a stream changes resolution.
+		int32_t w = view_size_.width;
+		int32_t h = view_size_.height;
+		if (plugin_size_.width != w || plugin_size_.height != h)
 		{
-			// This frame size is different from the last one.
-			plugin_size_.SetSize(w, h);
+			plugin_size_.width = w;
+			plugin_size_.height = h;
 			context_->ResizeBuffers(w, h);
 			std::stringstream sstm;
 			sstm << "vr {" // Viewport resized
@@ -189,57 +457,91 @@ namespace PnaclPlayer
 			PostString(sstm.str());
 		}
 
+		// Letterbox bars, empty cells, and cells whose stream has not produced a picture yet, are black.
+		context_->ClearColor(0, 0, 0, 1);
+		context_->Clear(GL_COLOR_BUFFER_BIT);
+
+		int64_t now = perfNow();
+		int64_t nowUs = FrameLatencyStats::Now(platform_);
+		for (size_t cell = 0; cell < wallCells_.size(); cell++)
+		{
+			VideoStream* stream = FindStream(wallCells_[cell]);
+			if (!stream)
+				continue;
+			DecodedFrame* frame = stream->currentlyRenderingFrame.get();
+			if (frame)
+			{
+#ifdef DebugLogging
+				std::stringstream sstm;
+				sstm << "Painting " << frame->timestamp;
+				DebugLog(sstm.str());
+#endif
+				frame->rendering = true;
+				frame->stages.drawn = nowUs;
+				stream->renderCompletePending = true;
+				stream->scheduler->lastRenderStarted = now;
+			}
+			else
+			{
+				// Nothing new for this cell, so draw what it showed last time; the back buffer does not keep it.
+				frame = stream->displayedFrame.get();
+				if (!frame)
+					continue;
+				if (frame->recycled || frame->streamNum != frame->decoder->currentStreamNum)
+				{
+					stream->displayedFrame.reset();
+					continue;
+				}
+			}
+			DrawPicture(frame->picture, LetterboxRect(frame->picture, CellRect(cell)));
+		}
+
 #ifdef DebugLogging
 		{
 			std::stringstream sstm;
-			sstm << "Painting " << next->timestamp;
+			sstm << "SwapBuffers() " << next->timestamp;
 			DebugLog(sstm.str());
 		}
 #endif
+		context_->SwapBuffers(std::bind(&pnacl_player::PaintFinished, this, std::placeholders::_1));
+	}
 
-		renderScheduler->lastRenderStarted = perfNow();
-
-		const PP_VideoPicture& picture = next->picture;
-
-		int x = 0;
-		int y = 0;
-
-		PP_Resource graphics_3d = context_->pp_resource();
+	void pnacl_player::DrawPicture(const VideoPicture& picture, const PictureRect& viewport)
+	{
+		// Sample only the visible part of the texture, which the decoder may have padded to whole macroblocks.  It starts at the texture's origin.
+		GLfloat visibleWidth = 1.0;
+		GLfloat visibleHeight = 1.0;
+		if (picture.visible_rect.width > 0 && picture.visible_rect.height > 0 && picture.texture_size.width > 0 && picture.texture_size.height > 0)
+		{
+			visibleWidth = (GLfloat)picture.visible_rect.width / picture.texture_size.width;
+			visibleHeight = (GLfloat)picture.visible_rect.height / picture.texture_size.height;
+		}
 		if (picture.texture_target == GL_TEXTURE_2D)
 		{
 			Create2DProgramOnce();
-			gles2_if_->UseProgram(graphics_3d, shader_2d_.program);
-			gles2_if_->Uniform2f(graphics_3d, shader_2d_.texcoord_scale_location, 1.0, 1.0);
+			context_->UseProgram(shader_2d_.program);
+			context_->Uniform2f(shader_2d_.texcoord_scale_location, visibleWidth, visibleHeight);
 		}
 		else if (picture.texture_target == GL_TEXTURE_RECTANGLE_ARB)
 		{
+			// Rectangle textures are addressed in texels.
 			CreateRectangleARBProgramOnce();
-			gles2_if_->UseProgram(graphics_3d, shader_rectangle_arb_.program);
-			gles2_if_->Uniform2f(graphics_3d, shader_rectangle_arb_.texcoord_scale_location, picture.texture_size.width, picture.texture_size.height);
+			context_->UseProgram(shader_rectangle_arb_.program);
+			context_->Uniform2f(shader_rectangle_arb_.texcoord_scale_location, visibleWidth * picture.texture_size.width, visibleHeight * picture.texture_size.height);
 		}
 		else
 		{
 			assert(picture.texture_target == GL_TEXTURE_EXTERNAL_OES);
 			CreateExternalOESProgramOnce();
-			gles2_if_->UseProgram(graphics_3d, shader_external_oes_.program);
-			gles2_if_->Uniform2f(graphics_3d, shader_external_oes_.texcoord_scale_location, 1.0, 1.0);
+			context_->UseProgram(shader_external_oes_.program);
+			context_->Uniform2f(shader_external_oes_.texcoord_scale_location, visibleWidth, visibleHeight);
 		}
 
-		gles2_if_->Viewport(graphics_3d, x, y, w, h);
-		gles2_if_->ActiveTexture(graphics_3d, GL_TEXTURE0);
-		gles2_if_->BindTexture(graphics_3d, picture.texture_target, picture.texture_id);
-		gles2_if_->DrawArrays(graphics_3d, GL_TRIANGLE_STRIP, 0, 4);
-
-		gles2_if_->UseProgram(graphics_3d, 0);
-
-#ifdef DebugLogging
-		{
-			std::stringstream sstm;
-			sstm << "SwapBuffers() " << next->timestamp;
-			DebugLog(sstm.str());
-		}
-#endif
-		context_->SwapBuffers(callback_factory_.NewCallback(&pnacl_player::PaintFinished));
+		context_->Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+		context_->ActiveTexture(GL_TEXTURE0);
+		context_->BindTexture(picture.texture_target, picture.texture_id);
+		context_->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		// The program stays bound for the next picture, which most likely uses it too.
 	}
 
 	void pnacl_player::PaintFinished(int32_t result)
@@ -251,119 +553,541 @@ namespace PnaclPlayer
 			DebugLog(sstm.str());
 #endif
 		}
-		assert(result == PP_OK);
-		renderScheduler->lastRenderDuration = perfNow() - renderScheduler->lastRenderStarted;
-		is_painting_ = false;
-
-		DecodedFrame* last = currentlyRenderingFrame;
-		last->rendering = false;
+		assert(result == PLATFORM_OK);
+		int64_t now = perfNow();
+		int64_t nowUs = FrameLatencyStats::Now(platform_);
+		vsync_.AddSwapComplete(nowUs / 1000.0);
 
-		if (!is_resetting_)
+		// Finish with every frame drawn in this refresh before telling any scheduler, because a scheduler can hand over a new frame and start the next refresh right away.
+		for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
 		{
-			std::stringstream sstm;
-			sstm << "rf {" // Rendered frame
-				<< "\"w\":" << plugin_size_.width()
-				<< ",\"h\":" << plugin_size_.height()
-				<< ",\"t\":" << last->timestamp
-				<< ",\"i\":" << last->expectedInterframe
-				//<< ",\"rt\":" << renderScheduler->lastRenderDuration
-				<< " }";
-			PostString(sstm.str());
+			VideoStream* stream = it->second;
+			DecodedFrame* last = stream->currentlyRenderingFrame.get();
+			if (!last)
+				continue;
+			stream->scheduler->lastRenderDuration = (int32_t)(now - stream->scheduler->lastRenderStarted);
+			last->rendering = false;
+
+			if (!is_resetting_)
+			{
+				ReportFrame(TELEMETRY_RENDERED, last, last->picture.texture_size.width, last->picture.texture_size.height);
+				if (!firstFrameShown_)
+					ReportFirstFrame(nowUs);
+				latency_.Record(last->stages, nowUs);
+				// Judder: how far the time this frame followed the previous one on screen differs from the time between them in the stream.
+				int64_t expectedMs = last->presentationTime - stream->lastShownPresentationTime;
+				if (stream->lastShownUs > 0 && expectedMs > 0 && expectedMs <= kMaxJudderIntervalMs)
+					latency_.RecordJudder(llabs(nowUs - stream->lastShownUs - expectedMs * 1000));
+				stream->lastShownUs = nowUs;
+				stream->lastShownPresentationTime = last->presentationTime;
+			}
+
+			if (IsWall())
+				stream->displayedFrame = std::move(stream->currentlyRenderingFrame); // Recycles the picture shown before.
+			else
+				stream->currentlyRenderingFrame.reset(); // Recycles the picture.
 		}
+		is_painting_ = false;
 
-		last->RecyclePicture();
-		delete last;
-		last = currentlyRenderingFrame = NULL;
-		renderScheduler->RenderComplete();
+		for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+		{
+			VideoStream* stream = it->second;
+			if (!stream->renderCompletePending)
+				continue;
+			stream->renderCompletePending = false;
+			stream->scheduler->RenderComplete();
+		}
 
 		if (!is_painting_)
 			PaintNextPicture();
 	}
 
-	/// Handler for messages coming in from the browser via postMessage().  The
-	/// @a var_message can contain be any pp:Var type; for example int, string
-	/// Array or Dictinary. Please see the pp:Var documentation for more details.
-	/// @param[in] var_message The message posted by the browser.
-	void pnacl_player::HandleMessage(const pp::Var& var_message)
+	/// Handler for string messages coming in from the browser via postMessage().
+	/// @param[in] message The message posted by the browser.
+	void pnacl_player::HandleMessage(const std::string& message)
 	{
-		if (var_message.is_string())
+		if (!TraceMessage(message))
+			HandleStringMessage(message);
+	}
+
+	void pnacl_player::HandleStringMessage(const std::string& message)
+	{
+		if (message == "reset" || message.find("reset ") == 0)
 		{
-			std::string message = var_message.AsString();
-			if (message == "reset")
+			// "reset [streamId]"; without an id every stream is reset.
+			VideoStream* only = NULL;
+			if (streams_.empty())
+				PostString("not yet ready!");
+			else if (message.size() > 5 && !ParseStreamArgument(message.substr(5), only))
+				PostString("unknown stream: " + message);
+			else
 			{
-				if (video_decoder_)
+				is_resetting_ = true;
+				for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
 				{
-					is_resetting_ = true;
+					VideoStream* stream = it->second;
+					if (only && stream != only)
+						continue;
 					//DebugLog("Reset starting");
-					video_decoder_->Reset();
+					stream->CancelSwitch();
+					stream->decoder->Reset();
 					//DebugLog("Reset mid");
-					renderScheduler->Reset();
-					is_resetting_ = false;
+					stream->scheduler->Reset();
 					//DebugLog("Reset complete");
 				}
-				else
-					PostString("not yet ready!");
+				is_resetting_ = false;
 			}
-			else if (message.find("f ") == 0)
-				nextFrameTimestamp = (int64_t)strtoll(message.substr(2).c_str(), NULL, 10);
 		}
-		else if (var_message.is_array_buffer())
+		else if (message == "switch" || message.find("switch ") == 0)
 		{
-			if (video_decoder_)
+			// "switch [streamId]"; without an id every stream switches.  Frames after this message belong to the new stream.
+			VideoStream* only = NULL;
+			if (streams_.empty())
+				PostString("not yet ready!");
+			else if (message.size() > 6 && !ParseStreamArgument(message.substr(6), only))
+				PostString("unknown stream: " + message);
+			else
 			{
-				pp::VarArrayBuffer buffer(var_message);
-#ifdef DebugLogging
-				std::stringstream sstr;
-				sstr << "Received frame " << nextFrameTimestamp;
-				DebugLog(sstr.str());
-#endif
-				video_decoder_->ReceiveFrame(EncodedFrame(buffer, nextFrameTimestamp));
+				for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+				{
+					if (!only || it->second == only)
+						it->second->BeginSwitch();
+				}
 			}
+		}
+		else if (message == "eos" || message.find("eos ") == 0)
+		{
+			// "eos [streamId]"; without an id every stream has ended.  Shows the pictures the decoder is holding back.
+			VideoStream* only = NULL;
+			if (streams_.empty())
+				PostString("not yet ready!");
+			else if (message.size() > 3 && !ParseStreamArgument(message.substr(3), only))
+				PostString("unknown stream: " + message);
 			else
+			{
+				for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+				{
+					if (!only || it->second == only)
+						it->second->decoder->EndOfStream();
+				}
+			}
+		}
+		else if (message.find("idleflush ") == 0)
+		{
+			// "idleflush <ms>", 0 to disable.
+			std::istringstream args(message.substr(10));
+			int ms = -1;
+			args >> ms;
+			if (!args.fail() && ms >= 0)
+			{
+				idleFlushMs_ = ms;
+				for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+					it->second->SetIdleFlush(ms);
+			}
+			else
+				PostString("invalid idleflush message: " + message);
+		}
+		else if (message == "standby")
+		{
+			// Pre-warm a standby decoder for every stream, now and for streams created later.
+			standbyDecoders_ = true;
+			for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+				it->second->CreateStandby();
+		}
+		else if (message.find("f ") == 0)
+		{
+			// "f <timestamp> [streamId] [generation]" announces the next ArrayBuffer.
+			ingest_.HandleMessage(message);
+		}
+		else if (message == "framepool" || message.find("framepool ") == 0)
+		{
+			// "framepool [streamId]"
+			VideoStream* stream = NULL;
+			if (!ParseStreamArgument(message.substr(9), stream))
+				PostString("unknown stream: " + message);
+			else if (stream)
+			{
+				const DecodedFramePoolStats& stats = stream->decoder->framePool.stats();
+				std::stringstream sstm;
+				sstm << "fp {" // Frame pool
+					<< "\"capacity\":" << stats.capacity
+					<< ",\"inUse\":" << stats.inUse
+					<< ",\"peak\":" << stats.peakInUse
+					<< ",\"acquired\":" << stats.acquired
+					<< ",\"allocations\":" << stats.heapAllocations
+					<< " }";
+				PostString(sstm.str());
+			}
+			else
+				PostString("not yet ready!");
+		}
+		else if (message == "stats")
+		{
+			// Latency of each stage, in microseconds, over every frame painted so far.
+			PostString("st " + latency_.ToJson());
+		}
+		else if (message == "stats reset")
+			latency_.Clear();
+		else if (message == "glstats")
+		{
+			if (context_)
+			{
+				const GLCallStats& stats = context_->stats();
+				std::stringstream sstm;
+				sstm << "gl {" // GL calls
+					<< "\"issued\":" << stats.issued
+					<< ",\"elided\":" << stats.elided
+					<< ",\"draws\":" << stats.draws
+					<< ",\"swaps\":" << stats.swaps
+					<< " }";
+				PostString(sstm.str());
+			}
+			else
+				PostString("not yet ready!");
+		}
+		else if (message == "decoderstats" || message.find("decoderstats ") == 0)
+		{
+			// "decoderstats [streamId]"
+			VideoStream* stream = NULL;
+			if (!ParseStreamArgument(message.substr(12), stream))
+				PostString("unknown stream: " + message);
+			else if (stream)
+			{
+				Decoder* decoder = stream->decoder;
+				const BacklogStats& backlog = decoder->backlogStats();
+				const DecodeTimestampStats& timestamps = decoder->decodeTimestampStats();
+				const DecodeErrorStats& errors = decoder->errorStats();
+				std::stringstream sstm;
+				sstm << "ds {" // Decoder stats
+					<< "\"queued\":" << decoder->encodedFrameQueue.size()
+					<< ",\"queuedBytes\":" << decoder->queuedBytes()
+					<< ",\"peakBytes\":" << stream->queueStats().peakBytes
+					<< ",\"pauses\":" << stream->queueStats().pauses
+					<< ",\"sheds\":" << backlog.sheds
+					<< ",\"skippedFrames\":" << backlog.skippedFrames
+					<< ",\"skippedBytes\":" << backlog.skippedBytes
+					<< ",\"startupSkipped\":" << backlog.startupSkippedFrames
+					<< ",\"idleFlushes\":" << decoder->flushStats().idleFlushes
+					<< ",\"eosFlushes\":" << decoder->flushStats().endOfStreamFlushes
+					<< ",\"errors\":" << errors.initializeErrors + errors.decodeErrors + errors.pictureErrors + errors.resetErrors + errors.flushErrors
+					<< ",\"rejected\":" << errors.rejectedFrames
+					<< ",\"reinits\":" << errors.reinitializations
+					<< ",\"errorSkipped\":" << errors.skippedFrames
+					<< ",\"recoveries\":" << errors.recoveries
+					<< ",\"recoveryMs\":" << errors.lastRecoveryMs
+					<< ",\"maxRecoveryMs\":" << errors.maxRecoveryMs
+					<< ",\"staleIds\":" << timestamps.stale
+					<< ",\"missingIds\":" << timestamps.missing
+					<< ",\"overwrittenIds\":" << timestamps.overwritten
+					<< " }";
+				PostString(sstm.str());
+			}
+			else
+				PostString("not yet ready!");
+		}
+		else if (message.find("paintqueue ") == 0)
+		{
+			// "paintqueue <capacity> [dropoldest|dropnewest|latest]"
+			std::istringstream args(message.substr(11));
+			int capacity = 0;
+			std::string policyName;
+			args >> capacity >> policyName;
+			PaintQueuePolicy policy = paintQueuePolicy_;
+			if (capacity > 0 && (policyName.empty() || ParsePaintQueuePolicy(policyName, policy)))
+				ConfigurePaintQueue(capacity, policy);
+			else
+				PostString("invalid paintqueue message: " + message);
+		}
+		else if (message == "telemetry string")
+			telemetry_.Disable();
+		else if (message.find("telemetry binary") == 0)
+		{
+			// "telemetry binary [maxFrames] [maxMs]"
+			std::istringstream args(message.substr(16));
+			int frames = FrameTelemetry::kDefaultMaxRecords;
+			int ms = FrameTelemetry::kDefaultMaxDelayMs;
+			args >> frames >> ms;
+			if (frames > 0 && frames <= 0xFFFF && ms > 0)
+				telemetry_.EnableBinary(frames, ms);
+			else
+				PostString("invalid telemetry message: " + message);
+		}
+		else if (message == "telemetry flush")
+			telemetry_.Flush();
+		else if (message.find("jitterbuffer ") == 0)
+		{
+			// "jitterbuffer fixed|lowlatency|smooth"
+			JitterBufferMode mode;
+			if (ParseJitterBufferMode(message.substr(13), mode))
+			{
+				jitterBufferMode_ = mode;
+				for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+					it->second->scheduler->SetJitterBufferMode(mode);
+			}
+			else
+				PostString("invalid jitterbuffer message: " + message);
+		}
+		else if (message.find("clockjump ") == 0)
+		{
+			// "clockjump <ms>", 0 to jump rather than slew.
+			std::istringstream args(message.substr(10));
+			int ms = -1;
+			args >> ms;
+			if (!args.fail() && ms >= 0)
+			{
+				clockJumpMs_ = ms;
+				for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+					it->second->scheduler->SetClockJumpThreshold(ms);
+			}
+			else
+				PostString("invalid clockjump message: " + message);
+		}
+		else if (message == "vsync on" || message == "vsync off")
+		{
+			vsyncAligned_ = message == "vsync on";
+			for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+				it->second->scheduler->SetVsync(vsyncAligned_ ? &vsync_ : NULL);
+		}
+		else if (message == "schedulerstats" || message.find("schedulerstats ") == 0)
+		{
+			// "schedulerstats [streamId]"
+			VideoStream* stream = NULL;
+			if (!ParseStreamArgument(message.substr(14), stream))
+			{
+				PostString("unknown stream: " + message);
+				return;
+			}
+			if (!stream)
+			{
 				PostString("not yet ready!");
+				return;
+			}
+			const RenderSchedulerStats& stats = stream->scheduler->stats;
+			std::stringstream sstm;
+			sstm << "ss {" // Scheduler stats
+				<< "\"added\":" << stats.framesAdded
+				<< ",\"rendered\":" << stats.framesRendered
+				<< ",\"dropped\":" << stats.framesDropped
+				<< ",\"jumps\":" << stats.clockJumps
+				<< ",\"jumpMs\":" << stats.clockJumpTotal
+				<< ",\"rollbacks\":" << stats.clockRollbacks
+				<< ",\"rollbackMs\":" << stats.clockRollbackTotal
+				<< ",\"depth\":" << stats.queueDepth
+				<< ",\"jitter\":" << stats.jitterMs
+				<< ",\"interval\":" << stats.frameIntervalMs
+				<< ",\"cadenceChanges\":" << stats.cadenceChanges
+				<< ",\"superseded\":" << stats.framesSuperseded
+				<< ",\"refresh\":" << (vsync_.locked() ? vsync_.periodMs() : 0)
+				<< ",\"rate\":" << stats.clockRate
+				<< ",\"driftPpm\":" << stats.clockDriftPpm
+				<< " }";
+			PostString(sstm.str());
+		}
+		else if (message.find("catchup ") == 0)
+		{
+			// "catchup <maxMs> [maxBytes]", 0 to disable a limit.
+			std::istringstream args(message.substr(8));
+			long long ms = -1;
+			long long bytes = 0;
+			args >> ms >> bytes;
+			if (ms >= 0 && bytes >= 0)
+			{
+				backlogLimitMs_ = ms;
+				backlogLimitBytes_ = bytes;
+				for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+					it->second->SetBacklogLimits(backlogLimitMs_, backlogLimitBytes_);
+			}
+			else
+				PostString("invalid catchup message: " + message);
+		}
+		else if (message.find("queuebudget ") == 0)
+		{
+			// "queuebudget <highBytes> [lowBytes]", 0 to disable.  The low watermark defaults to half the high one.
+			std::istringstream args(message.substr(12));
+			long long high = -1;
+			long long low = -1;
+			if (!(args >> high))
+				high = -1;
+			else if (!(args >> low))
+				low = high / 2;
+			if (high >= 0 && low >= 0 && low <= high)
+			{
+				queueHighBytes_ = high;
+				queueLowBytes_ = low;
+				for (StreamMap::iterator it = streams_.begin(); it != streams_.end(); ++it)
+					it->second->SetQueueBudget(queueHighBytes_, queueLowBytes_);
+			}
+			else
+				PostString("invalid queuebudget message: " + message);
 		}
+		else if (message.find("wall ") == 0)
+		{
+			// "wall <columns> <rows> [streamId ...]", the ids filling the cells row by row.  Without ids, streams 0 to columns * rows - 1.
+			std::istringstream args(message.substr(5));
+			int columns = 0;
+			int rows = 0;
+			args >> columns >> rows;
+			std::vector<int32_t> ids;
+			int id;
+			while (args >> id)
+				ids.push_back(id);
+			if (ids.empty())
+			{
+				for (id = 0; id < columns * rows; id++)
+					ids.push_back(id);
+			}
+			if (!args.eof() || !SetWallLayout(columns, rows, ids))
+				PostString("invalid wall message: " + message);
+		}
+	}
+
+	bool pnacl_player::ParseStreamArgument(const std::string& args, VideoStream*& stream)
+	{
+		std::istringstream in(args);
+		int id;
+		if (!(in >> id))
+		{
+			// No id: the first stream.
+			stream = streams_.empty() ? NULL : streams_.begin()->second;
+			return in.eof();
+		}
+		stream = FindStream(id);
+		return stream != NULL;
+	}
+
+	/// Handler for ArrayBuffer messages coming in from the browser via postMessage().
+	/// @param[in] buffer The message posted by the browser.
+	void pnacl_player::HandleMessage(const ByteBufferPtr& buffer)
+	{
+		trace_.Record(FrameLatencyStats::Now(platform_), *buffer);
+		ingest_.HandleMessage(buffer);
+	}
+
+	void pnacl_player::HandleMessageOnIngestThread(const std::string& message)
+	{
+		if (!TraceMessage(message))
+			ingest_.HandleMessage(message);
+	}
+
+	void pnacl_player::HandleMessageOnIngestThread(const ByteBufferPtr& buffer)
+	{
+		trace_.Record(FrameLatencyStats::Now(platform_), *buffer);
+		ingest_.HandleMessage(buffer);
+	}
+
+	bool pnacl_player::TraceMessage(const std::string& message)
+	{
+		if (message.find("record ") != 0)
+		{
+			trace_.Record(FrameLatencyStats::Now(platform_), message);
+			return false;
+		}
+		if (message == "record start" || message.find("record start ") == 0)
+		{
+			// "record start [maxMegabytes]"
+			int64_t maxMegabytes = kDefaultTraceMegabytes;
+			std::istringstream args(message.substr(12));
+			if (!(args >> maxMegabytes) && !args.eof())
+				maxMegabytes = -1;
+			if (maxMegabytes <= 0)
+			{
+				PostStringFromAnyThread("invalid record message: " + message);
+				return true;
+			}
+			trace_.Start(FrameLatencyStats::Now(platform_), (size_t)maxMegabytes << 20);
+		}
+		else if (message == "record stop")
+		{
+			MessageTraceStats stats = trace_.stats();
+			std::shared_ptr<std::vector<uint8_t>> trace = trace_.Stop();
+			if (!trace)
+			{
+				PostStringFromAnyThread("not recording");
+				return true;
+			}
+			std::stringstream sstm;
+			sstm << "rc {" // Recording complete
+				<< "\"messages\":" << stats.messages
+				<< ",\"bytes\":" << stats.bytes
+				<< ",\"dropped\":" << stats.dropped
+				<< " }";
+			std::string summary = sstm.str();
+			platform_->CallOnMainThread(0, [this, trace, summary](int32_t result)
+			{
+				platform_->PostBinary(&(*trace)[0], (uint32_t)trace->size());
+				PostString(summary);
+			}, 0);
+		}
+		else
+			PostStringFromAnyThread("invalid record message: " + message);
+		return true;
+	}
+
+	void pnacl_player::PostStringFromAnyThread(const std::string& message)
+	{
+		platform_->CallOnMainThread(0, [this, message](int32_t result)
+		{
+			PostString(message);
+		}, 0);
+	}
+
+	void pnacl_player::ConsumeIngestItem(IngestItem& item)
+	{
+		if (item.type == INGEST_MESSAGE)
+		{
+			HandleStringMessage(item.text);
+			return;
+		}
+		if (item.type == INGEST_ERROR)
+		{
+			PostString(item.text);
+			return;
+		}
+		if (firstArrivalUs_ == 0)
+			firstArrivalUs_ = FrameLatencyStats::Now(platform_);
+		if (streams_.empty())
+		{
+			// Graphics and the decoders are not initialized yet.  Hold the frame so playback can start from it.
+			startupFrames_.Add(item.stream, item.frame);
+			return;
+		}
+#ifdef DebugLogging
+		std::stringstream sstr;
+		sstr << "Received frame " << item.frame.timestamp;
+		DebugLog(sstr.str());
+#endif
+		VideoStream* stream = FindStream(item.stream);
+		if (stream)
+			stream->ReceiveFrame(item.frame);
+		else
+			PostString("frame for unknown stream");
 	}
 
 	void pnacl_player::PostString(std::string message)
 	{
-		pp::Var var_message = pp::Var(message);
-		PostMessage(var_message);
+		platform_->PostString(message);
 	}
 	void pnacl_player::DebugLog(std::string message)
 	{
 #ifdef DebugLogging
-		pp::Var var_message = pp::Var(message);
-		PostMessage(var_message);
+		platform_->PostString(message);
 #endif
 	}
 
 #pragma region Low-Level Rendering
 	void pnacl_player::InitGL()
 	{
-		assert(plugin_size_.width() && plugin_size_.height());
+		assert(plugin_size_.width && plugin_size_.height);
 		is_painting_ = false;
 
 		assert(!context_);
-		int32_t context_attributes[] = {
-			PP_GRAPHICS3DATTRIB_ALPHA_SIZE,     8,
-			PP_GRAPHICS3DATTRIB_BLUE_SIZE,      8,
-			PP_GRAPHICS3DATTRIB_GREEN_SIZE,     8,
-			PP_GRAPHICS3DATTRIB_RED_SIZE,       8,
-			PP_GRAPHICS3DATTRIB_DEPTH_SIZE,     0,
-			PP_GRAPHICS3DATTRIB_STENCIL_SIZE,   0,
-			PP_GRAPHICS3DATTRIB_SAMPLES,        0,
-			PP_GRAPHICS3DATTRIB_SAMPLE_BUFFERS, 0,
-			PP_GRAPHICS3DATTRIB_WIDTH,          plugin_size_.width(),
-			PP_GRAPHICS3DATTRIB_HEIGHT,         plugin_size_.height(),
-			PP_GRAPHICS3DATTRIB_NONE,
-		};
-		context_ = new pp::Graphics3D(this, context_attributes);
-		assert(!context_->is_null());
-		assert(BindGraphics(*context_));
+		GraphicsContext* context = platform_->CreateGraphicsContext(plugin_size_.width, plugin_size_.height);
+		assert(context);
+		context_ = new GLStateCache(context);
 
 		// Clear color bit.
-		gles2_if_->ClearColor(context_->pp_resource(), 1, 0, 0, 1);
-		gles2_if_->Clear(context_->pp_resource(), GL_COLOR_BUFFER_BIT);
+		context_->ClearColor(1, 0, 0, 1);
+		context_->Clear(GL_COLOR_BUFFER_BIT);
 
 		assertNoGLError();
 
@@ -380,11 +1104,10 @@ namespace PnaclPlayer
 		};
 
 		GLuint buffer;
-		gles2_if_->GenBuffers(context_->pp_resource(), 1, &buffer);
-		gles2_if_->BindBuffer(context_->pp_resource(), GL_ARRAY_BUFFER, buffer);
+		context_->GenBuffers(1, &buffer);
+		context_->BindBuffer(GL_ARRAY_BUFFER, buffer);
 
-		gles2_if_->BufferData(context_->pp_resource(),
-			GL_ARRAY_BUFFER,
+		context_->BufferData(GL_ARRAY_BUFFER,
 			sizeof(kVertices),
 			kVertices,
 			GL_STATIC_DRAW);
@@ -457,37 +1180,37 @@ namespace PnaclPlayer
 		Shader shader;
 
 		// Create shader program.
-		shader.program = gles2_if_->CreateProgram(context_->pp_resource());
+		shader.program = context_->CreateProgram();
 		CreateShader(shader.program, GL_VERTEX_SHADER, vertex_shader, strlen(vertex_shader));
 		CreateShader(shader.program, GL_FRAGMENT_SHADER, fragment_shader, strlen(fragment_shader));
-		gles2_if_->LinkProgram(context_->pp_resource(), shader.program);
-		gles2_if_->UseProgram(context_->pp_resource(), shader.program);
-		gles2_if_->Uniform1i(context_->pp_resource(), gles2_if_->GetUniformLocation(context_->pp_resource(), shader.program, "s_texture"), 0);
+		context_->LinkProgram(shader.program);
+		context_->UseProgram(shader.program);
+		context_->Uniform1i(context_->GetUniformLocation(shader.program, "s_texture"), 0);
 		assertNoGLError();
 
-		shader.texcoord_scale_location = gles2_if_->GetUniformLocation(context_->pp_resource(), shader.program, "v_scale");
+		shader.texcoord_scale_location = context_->GetUniformLocation(shader.program, "v_scale");
 
-		GLint pos_location = gles2_if_->GetAttribLocation(context_->pp_resource(), shader.program, "a_position");
-		GLint tc_location = gles2_if_->GetAttribLocation(context_->pp_resource(), shader.program, "a_texCoord");
+		GLint pos_location = context_->GetAttribLocation(shader.program, "a_position");
+		GLint tc_location = context_->GetAttribLocation(shader.program, "a_texCoord");
 		assertNoGLError();
 
-		gles2_if_->EnableVertexAttribArray(context_->pp_resource(), pos_location);
-		gles2_if_->VertexAttribPointer(context_->pp_resource(), pos_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		gles2_if_->EnableVertexAttribArray(context_->pp_resource(), tc_location);
-		gles2_if_->VertexAttribPointer(context_->pp_resource(), tc_location, 2, GL_FLOAT, GL_FALSE, 0, static_cast<float*>(0) + 8);  // Skip position coordinates.
+		context_->EnableVertexAttribArray(pos_location);
+		context_->VertexAttribPointer(pos_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		context_->EnableVertexAttribArray(tc_location);
+		context_->VertexAttribPointer(tc_location, 2, GL_FLOAT, GL_FALSE, 0, static_cast<float*>(0) + 8);  // Skip position coordinates.
 
-		gles2_if_->UseProgram(context_->pp_resource(), 0);
+		context_->UseProgram(0);
 		assertNoGLError();
 		return shader;
 	}
 
 	void pnacl_player::CreateShader(GLuint program, GLenum type, const char* source, int size)
 	{
-		GLuint shader = gles2_if_->CreateShader(context_->pp_resource(), type);
-		gles2_if_->ShaderSource(context_->pp_resource(), shader, 1, &source, &size);
-		gles2_if_->CompileShader(context_->pp_resource(), shader);
-		gles2_if_->AttachShader(context_->pp_resource(), program, shader);
-		gles2_if_->DeleteShader(context_->pp_resource(), shader);
+		GLuint shader = context_->CreateShader(type);
+		context_->ShaderSource(shader, 1, &source, &size);
+		context_->CompileShader(shader);
+		context_->AttachShader(program, shader);
+		context_->DeleteShader(shader);
 	}
 #pragma endregion
 
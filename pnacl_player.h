@@ -1,57 +1,102 @@
 #pragma once
+#include "Platform.h"
 #include "Shader.h"
 #include "Decoder.h"
 #include "DecodedFrame.h"
 #include "RenderScheduler.h"
+#include "StartupFrameBuffer.h"
+#include "FrameRing.h"
+#include "FrameTelemetry.h"
+#include "FrameLatencyStats.h"
+#include "FramedMessage.h"
+#include "GLStateCache.h"
+#include "IngestQueue.h"
+#include "MessageTrace.h"
+#include "VsyncEstimator.h"
+#include "VideoStream.h"
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <queue>
 #include <sstream>
 
-#include "ppapi/c/ppb_opengles2.h"
-#include "ppapi/cpp/graphics_3d.h"
-#include "ppapi/cpp/graphics_3d_client.h"
-#include "ppapi/cpp/instance.h"
-#include "ppapi/cpp/module.h"
-#include "ppapi/cpp/video_decoder.h"
-#include "ppapi/utility/completion_callback_factory.h"
-
 #include "pnacl_player_assert.h"
 
 namespace PnaclPlayer
 {
-	class pnacl_player : public pp::Instance, public pp::Graphics3DClient
+	/// <summary>
+	/// What PaintPicture does with a new frame when the queue of pictures waiting to be painted is full.
+	/// </summary>
+	enum PaintQueuePolicy
+	{
+		/// <summary>Drop the oldest waiting picture to make room.  Plays every frame it can, at the cost of latency while painting is slow.</summary>
+		PAINT_DROP_OLDEST,
+		/// <summary>Drop the new picture.  Keeps the queued pictures, at the cost of a visible skip when painting catches up.</summary>
+		PAINT_DROP_NEWEST,
+		/// <summary>Drop every waiting picture whenever a new one arrives, regardless of capacity.  Lowest latency, for live view.</summary>
+		PAINT_LATEST_ONLY
+	};
+
+	/// <summary>
+	/// The player itself.  Owns the video streams (each with a decoder and a render scheduler) and the GL paint path.  Streams
+	/// are drawn into the cells of a grid, the video wall; by default the grid is one cell showing stream 0.  All interaction
+	/// with the browser goes through the Platform it was created with.
+	/// </summary>
+	class pnacl_player
 	{
 	public:
-		pnacl_player(PP_Instance instance, pp::Module* module);
+		pnacl_player(Platform* platform);
 		virtual ~pnacl_player();
 
-		// pp::Instance implementation.
-		virtual void DidChangeView(const pp::Rect& position, const pp::Rect& clip_ignored);
+		/// <summary>
+		/// Called by the platform when the plugin's view changes size.
+		/// </summary>
+		void DidChangeView(int32_t width, int32_t height);
 
-		// pp::Init implementation lets us access startup arguments
-		virtual bool Init(uint32_t argc, const char * argn[], const char * argv[]);
+		/// <summary>
+		/// Called by the platform with the startup arguments (the attributes of the embed element).
+		/// </summary>
+		bool Init(uint32_t argc, const char * argn[], const char * argv[]);
 
-		// pp::Graphics3DClient implementation.
-		virtual void Graphics3DContextLost()
-		{
-			// TODO(vrk/fischman): Properly reset after a lost graphics context.  In particular need to delete context_ and re-create textures.
-			// Probably have to recreate the decoder from scratch, because old textures can still be outstanding in the decoder!
-			assert(false && "Unexpectedly lost graphics context");
-		}
-		void ReceiveDecodedPicture(DecodedFrame* frame);
+		void ReceiveDecodedPicture(DecodedFramePtr frame);
 
-		void PaintPicture(DecodedFrame* frame);
+		void PaintPicture(VideoStream* stream, DecodedFramePtr frame);
+		/// <summary>
+		/// Handler for string messages coming in from the browser via postMessage().
+		/// </summary>
+		/// <param name="message">The message posted by the browser.</param>
+		void HandleMessage(const std::string& message);
 		/// <summary>
-		/// Handler for messages coming in from the browser via postMessage().  The argument "var_message" can be any pp:Var type; for example int, string, Array, or Dictionary. Please see the pp:Var documentation for more details.
+		/// Handler for ArrayBuffer messages coming in from the browser via postMessage().  The buffer is either a framed message
+		/// (see FramedMessageReader) carrying one or more frames with their timestamps, or a single frame whose timestamp was
+		/// sent beforehand in an "f" string message.
 		/// </summary>
-		/// <param name="var_message">The message posted by the browser.</param>
-		virtual void HandleMessage(const pp::Var& var_message);
+		/// <param name="buffer">The message posted by the browser.</param>
+		void HandleMessage(const ByteBufferPtr& buffer);
+		/// <summary>
+		/// In threaded ingest mode (the "ingestthread" attribute), the platform calls these on its ingest thread instead of calling
+		/// HandleMessage on the main thread.  Frames are split out there and handed to the main thread through the IngestQueue,
+		/// along with every other message so that the order is kept.
+		/// </summary>
+		void HandleMessageOnIngestThread(const std::string& message);
+		void HandleMessageOnIngestThread(const ByteBufferPtr& buffer);
+		/// <summary>
+		/// True if the platform should deliver messages with HandleMessageOnIngestThread.  Set by Init.
+		/// </summary>
+		bool ingestThreaded() const { return ingest_.threaded(); }
+		/// <summary>
+		/// Called by the platform if it could not start its ingest thread, to go back to handling every message on the main thread.
+		/// </summary>
+		void IngestThreadFailed() { ingest_.SetThreaded(false); }
+
+		Platform* platform() const { return platform_; }
 
 #pragma region Info Logging
 		// Log a message to the developer console and stdout by creating a temporary
@@ -64,7 +109,7 @@ namespace PnaclPlayer
 			~LogInfo()
 			{
 				const std::string& msg = stream_.str();
-				instance_->console_if_->Log(instance_->pp_instance(), PP_LOGLEVEL_LOG, pp::Var(msg).pp_var());
+				instance_->platform_->LogToConsole(false, msg);
 				std::cout << msg << std::endl;
 			}
 			std::ostringstream& s() { return stream_; }
@@ -85,7 +130,7 @@ namespace PnaclPlayer
 			~LogError()
 			{
 				const std::string& msg = stream_.str();
-				instance_->console_if_->Log(instance_->pp_instance(), PP_LOGLEVEL_ERROR, pp::Var(msg).pp_var());
+				instance_->platform_->LogToConsole(true, msg);
 				std::cerr << msg << std::endl;
 			}
 			// Impl note: it would have been nicer to have LogError derive from
@@ -99,8 +144,10 @@ namespace PnaclPlayer
 		};
 #pragma endregion
 
-		void frameRenderFunc(DecodedFrame* frame);
-		void frameDropFunc(DecodedFrame* frame, bool reportToClient);
+		/// <summary>
+		/// Takes a frame that will not be painted, reporting it to the browser if requested.
+		/// </summary>
+		void frameDropFunc(DecodedFramePtr frame, bool reportToClient);
 
 		/// <summary>
 		/// Send a string to the browser
@@ -117,18 +164,10 @@ namespace PnaclPlayer
 		/// </summary>
 		int64_t perfNow()
 		{
-			return (int64_t)(core_if_->GetTimeTicks() * 1000);
-		}
-
-		void DelayedPaint(int32_t result)
-		{
-			renderScheduler->DelayedPaint(result);
-		}
-		void CallDelayedPaintAfterDelay(int32_t delay_in_milliseconds, int32_t result)
-		{
-			core_if_->CallOnMainThread(delay_in_milliseconds, callback_factory_.NewCallback(&pnacl_player::DelayedPaint).pp_completion_callback(), result);
+			return (int64_t)(platform_->GetTimeTicks() * 1000);
 		}
 	private:
+		typedef std::map<int32_t, VideoStream*> StreamMap;
 
 		void InitializeDecoders();
 #pragma region Declare GL-related functions
@@ -142,32 +181,129 @@ namespace PnaclPlayer
 		void CreateShader(GLuint program, GLenum type, const char* source, int size);
 		void PaintNextPicture();
 		void PaintFinished(int32_t result);
+		void DrawPicture(const VideoPicture& picture, const PictureRect& viewport);
 #pragma endregion
+		/// <summary>
+		/// Returns the stream with the given id, or NULL.
+		/// </summary>
+		VideoStream* FindStream(int32_t id);
+		/// <summary>
+		/// Lays the wall out as a grid of columns x rows cells showing the given streams, row by row.  Creates streams that do not
+		/// exist yet (once the graphics context exists) and removes streams that are no longer shown.  Returns false if the layout is invalid.
+		/// </summary>
+		bool SetWallLayout(int32_t columns, int32_t rows, const std::vector<int32_t>& streamIds);
+		/// <summary>
+		/// Creates the streams named by wallCells_ that do not exist yet, and hands them any frames that arrived before they did.
+		/// </summary>
+		void CreateStreams();
+		/// <summary>
+		/// True if more than one cell is shown.
+		/// </summary>
+		bool IsWall() const { return wallCells_.size() > 1; }
+		PictureRect CellRect(size_t cell) const;
+		/// <summary>
+		/// The largest part of |area| with the picture's aspect ratio, centered, so the GPU scales the picture into it with black bars at the sides or top and bottom.
+		/// </summary>
+		static PictureRect LetterboxRect(const VideoPicture& picture, const PictureRect& area);
+		/// <summary>
+		/// Sets the capacity and overflow policy of pendingPictures.  Pictures that no longer fit are dropped, oldest first.
+		/// </summary>
+		void ConfigurePaintQueue(size_t capacity, PaintQueuePolicy policy);
+		static bool ParsePaintQueuePolicy(const std::string& name, PaintQueuePolicy& policy);
+		static bool ParseJitterBufferMode(const std::string& name, JitterBufferMode& mode);
+		/// <summary>
+		/// Reports a rendered or dropped frame to the browser, as a string or as a record in the next telemetry batch.
+		/// </summary>
+		void ReportFrame(FrameTelemetryEvent event, const DecodedFrame* frame, int32_t width, int32_t height);
+		/// <summary>
+		/// Posts the time to first frame, once, when the first frame has been painted.
+		/// </summary>
+		void ReportFirstFrame(int64_t nowUs);
+		/// <summary>
+		/// Parses an optional stream id at the end of a message.  Returns false if there is something there that is not a known stream.
+		/// </summary>
+		bool ParseStreamArgument(const std::string& args, VideoStream*& stream);
+		/// <summary>
+		/// Receives the frames and messages coming out of ingest_, on the main thread.
+		/// </summary>
+		void ConsumeIngestItem(IngestItem& item);
+		/// <summary>
+		/// Handles a string message on the main thread, once it has been recorded and has come through the ingest path.
+		/// </summary>
+		void HandleStringMessage(const std::string& message);
+		/// <summary>
+		/// Called on the thread messages arrive on.  Starts or stops a recording if the message is "record ...", and returns true.
+		/// Otherwise adds the message to the recording, if there is one, and returns false.
+		/// </summary>
+		bool TraceMessage(const std::string& message);
+		/// <summary>
+		/// Posts a string from the main thread, for code that may be running on the ingest thread.
+		/// </summary>
+		void PostStringFromAnyThread(const std::string& message);
+		/// <summary>
+		/// Size limit of a recording when "record start" does not give one.
+		/// </summary>
+		static const int64_t kDefaultTraceMegabytes = 64;
+		/// <summary>
+		/// Consecutive frames further apart than this (a stall, a seek) are not counted in the judder histogram.
+		/// </summary>
+		static const int64_t kMaxJudderIntervalMs = 1000;
 
-		pp::CompletionCallbackFactory<pnacl_player> callback_factory_;
+		Platform* platform_;
 
-		pp::Size plugin_size_;
+		// The size of the back buffer.
+		PictureSize plugin_size_;
+		// The size of the plugin element, which the back buffer is resized to match at the next paint.  The video's size never changes it.
+		PictureSize view_size_;
 		bool is_painting_;
+		// A wall's paint has been posted to start once the current task, and any other cells' frames due with it, are done.
+		bool paint_posted_;
 		int hwaccel_;
 		bool is_resetting_;
-		// Pictures go into this queue when they are received from the scheduler.
-		std::vector<DecodedFrame*> pendingPictures;
-		// The currently rendering picture goes into this object.
-		DecodedFrame* currentlyRenderingFrame;
-
-		// Unowned pointers.
-		const PPB_Console* console_if_;
-		const PPB_Core* core_if_;
-		const PPB_OpenGLES2* gles2_if_;
+		// Capacity and overflow policy of each stream's pendingPictures.
+		size_t paintQueueCapacity_;
+		PaintQueuePolicy paintQueuePolicy_;
+		JitterBufferMode jitterBufferMode_;
+		// Each stream's RenderScheduler clock jump threshold, in milliseconds.  0 jumps instead of slewing.
+		int32_t clockJumpMs_;
+		// Batches rf/df reports into ArrayBuffers when binary telemetry is enabled.
+		FrameTelemetry telemetry_;
+		// Per-stage latency of every frame that reaches the screen, for the "stats" message.
+		FrameLatencyStats latency_;
+		// Splits incoming messages into frames, on the main thread or on the platform's ingest thread.
+		IngestQueue ingest_;
+		// Records incoming messages between "record start" and "record stop".  Only used on the thread messages arrive on.
+		MessageTraceWriter trace_;
 
 		// Owned data.
 		/// <summary>
-		/// The pp::Graphics3D context
+		/// The graphics context, which is also our interface to OpenGL ES 2.0, behind a cache that skips calls which would not change the GL state.
 		/// </summary>
-		pp::Graphics3D* context_;
-		Decoder* video_decoder_;
-		RenderScheduler* renderScheduler;
-		int64_t nextFrameTimestamp;
+		GLStateCache* context_;
+		StreamMap streams_;
+		// The stream shown in each cell of the wall, row by row from the top left.
+		std::vector<int32_t> wallCells_;
+		int32_t wallColumns_;
+		int32_t wallRows_;
+		// Live catch-up limits passed to the decoder.  0 disables a limit.
+		int64_t backlogLimitMs_;
+		int64_t backlogLimitBytes_;
+		// Flow control watermarks passed to the decoder.  A high watermark of 0 disables flow control.
+		int64_t queueHighBytes_;
+		int64_t queueLowBytes_;
+		// Idle flush interval passed to the decoder.  0 disables it.
+		int32_t idleFlushMs_;
+		// If true, every stream keeps a second decoder initialized for seamless switches.
+		bool standbyDecoders_;
+		// The display's refresh grid, estimated from PaintFinished times.  Schedulers align presentation to it only when vsyncAligned_ is set (the "vsync" attribute or message; off by default).
+		VsyncEstimator vsync_;
+		bool vsyncAligned_;
+		// Frames that arrive before the streams exist, handed to them when they are created.
+		StartupFrameBuffer startupFrames_;
+		// For the time to first frame: when the instance was created and when the first frame arrived, in microseconds.
+		int64_t createdUs_;
+		int64_t firstArrivalUs_;
+		bool firstFrameShown_;
 
 #pragma region Shader Stuff
 		// Shader program to draw GL_TEXTURE_2D target.